@@ -0,0 +1,909 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+/* Time the conversion of one vector for every pairing of a modifier and a
+   conversion the library registers, and a few with flags, width and
+   precision.  Run with "make bench"; the optional arguments are the number
+   of iterations and the largest number of threads for the contention
+   test, and "--json FILE" also writes the results of the suite to FILE,
+   so that they can be kept and compared from one release to the next.
+   "make bench BENCH_FLAGS='--json bench.json'" passes them on.
+
+   Every row of the suite reports the time per vector of sprintf, of
+   printf and of fprintf, both of those to /dev/null, the output sprintf
+   produces per second, and the time of a hand-written loop that sprintfs
+   the lanes one at a time with the matching scalar conversion, which is
+   what a program has to do without the library.  The 'r' rows compare
+   with "%.9g" and "%.17g", and the quadword rows have no scalar
+   equivalent.  The p50, p99 and p999 columns are percentiles of the
+   latency of single sprintf calls, each timed on its own, so they include
+   the cost of reading the clock.
+
+   The modifiers are listed in the order they are registered, so the rows
+   near the end of the list are the ones a linear search through the type
+   tables used to find last.
+
+   The scalar test times snprintf of a few conversions that print no
+   vectors: with the hooks registered, which look at every one of them and
+   hand it back to glibc, after vecpf_disable has taken them out again,
+   and in a copy of the benchmark run with VECPF_MANUAL_ENABLE set, which
+   never registers anything and so is what printf costs without the
+   library.
+
+   The contention test has 1, 2, 4, ... threads fprintf "%vd" and "%va"
+   to one shared stream, and reports the wall time per call across all of
+   them.  Every stdio call a conversion makes takes the stream's lock, so
+   this is where a conversion that writes its lanes one at a time falls
+   behind.  "%va" has no lane kernel, so it measures the libc fallback.
+
+   The array test formats one array of vectors with a fprintf loop and
+   with vecpf_fprint_array, and reports the time per vector of each.
+
+   The string test times asprintf and free, vecpf_asprintf and free, and
+   vecpf_arena_printf with a reset every 64 strings, for "%vd".
+
+   The length test times finding the length of one "%vld" and "%vd"
+   conversion with snprintf to a null buffer and with
+   vecpf_formatted_length.
+
+   The engine test times a few formats with snprintf, which goes through
+   the hooks, with vecpf_snprintf, which doesn't, and with vecpf_sprint
+   and a plan vecpf_compile made of the format beforehand.
+
+   The parse test reads the text vecpf_format_array prints for an array of
+   "%vld", "%vx" and "%vf" vectors, one per line, back with a strtol or
+   strtof loop and with vecpf_parse_array, and reports the text consumed
+   per second of each.
+
+   The parallel test formats a 4 MiB array of "vector float" into memory
+   with vecpf_format_array_mt on 1, 2, 4, ... threads, and reports the
+   input consumed per second and the speedup over one thread.  */
+
+/* config.h defines _GNU_SOURCE, which asprintf needs.  */
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vecpf.h"
+
+/* The modifiers in the order vecpf.c registers them, each with the
+   conversions its rows of int_types_table and fp_types_table take.  */
+static const struct
+{
+  const char *mod;
+  const char *convs;
+} bench_mods[] =
+{
+  { "vl", "diouxX" },
+  { "lv", "diouxX" },
+  { "vh", "diouxX" },
+  { "hv", "diouxX" },
+  { "v", "diouxXcfFeEgGaAr" },
+#ifdef VECPF_HAVE_VSX_TYPES
+  { "vv", "fFeEgGaAr" },
+  { "vll", "diouxX" },
+  { "llv", "diouxX" },
+#endif
+#ifdef HAVE_INT128_T
+  { "vz", "diouxX" },
+  { "zv", "diouxX" },
+#endif
+};
+
+/* Run after the suite's table rows.  */
+static const char *const bench_formats[] =
+{
+  "%-8vlx", "%#010vhx", "%+.3vld", "%.3vf", "%12.4vve",
+};
+
+/* Flags, width and precision, as they may come between the '%' and the
+   modifier.  */
+#define BENCH_FIELD  "-+# 0123456789."
+
+typedef struct
+{
+  char fmt[16];
+  double sprintf_ns;
+  double mb_s;			/* Output of sprintf per second.  */
+  double printf_ns;
+  double fprintf_ns;
+  double scalar_ns;		/* -1 for no scalar equivalent.  */
+  double p50_ns, p99_ns, p999_ns;
+} bench_row_t;
+
+typedef struct
+{
+  FILE *fp;
+  const char *fmt;
+  int iters;
+} bench_thread_arg_t;
+
+static void *
+bench_thread (void *p)
+{
+  const bench_thread_arg_t *arg = p;
+  vp_u_t u;
+  int i;
+
+  for (i = 0; i < LIBVECTOR_VECTOR_WIDTH_BYTES; i++)
+    u.uc[i] = i * 37 + 11;
+
+  for (i = 0; i < arg->iters; i++)
+    {
+      u.ui[0] = i;
+      fprintf (arg->fp, arg->fmt, u.v);
+    }
+
+  return NULL;
+}
+
+static double
+elapsed_ns (const struct timespec *t0, const struct timespec *t1)
+{
+  return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+/* Change the first lane from one call to the next, the way the lanes of a
+   program's output would.  */
+static void
+bench_vary (vp_u_t *u, int size, int is_fp, int i)
+{
+  if (is_fp && size == 8)
+    u->d[0] = i * 0.37;
+  else if (is_fp)
+    u->f[0] = i * 0.37f;
+  else
+    u->ui[0] = i;
+}
+
+/* The scalar conversion of a lane of FMT, with the same flags, width and
+   precision, in SCALAR.  Stores the lane size in *SIZE and returns 0, or
+   -1 if lanes of FMT have no scalar conversion.  */
+static int
+bench_scalar_format (const char *fmt, char *scalar, int *size)
+{
+  size_t field = strspn (fmt + 1, BENCH_FIELD);
+  const char *mod = fmt + 1 + field;
+  char conv = fmt[strlen (fmt) - 1];
+  int is_fp = strchr ("fFeEgGaAr", conv) != NULL;
+  const char *len;
+
+  if (strchr (mod, 'z') != NULL)
+    return -1;
+  else if (is_fp)
+    *size = strstr (mod, "vv") != NULL ? 8 : 4;
+  else if (strstr (mod, "ll") != NULL)
+    *size = 8;
+  else if (strchr (mod, 'l') != NULL)
+    *size = 4;
+  else if (strchr (mod, 'h') != NULL)
+    *size = 2;
+  else
+    *size = 1;
+
+  len = is_fp || conv == 'c' ? "" : *size == 8 ? "ll" : *size == 2 ? "h"
+	: *size == 1 ? "hh" : "";
+  if (conv == 'r')
+    sprintf (scalar, "%%%s", *size == 8 ? ".17g" : ".9g");
+  else
+    sprintf (scalar, "%%%.*s%s%c", (int) field, fmt + 1, len, conv);
+  return 0;
+}
+
+/* What a program without the library writes for one vector: every lane
+   with FMT, separated by spaces, except for characters.  */
+static int
+bench_scalar (char *buf, size_t size, const char *fmt, int lane_size,
+	      int is_fp, int is_char, const vp_u_t *u)
+{
+  int lanes = 16 / lane_size;
+  size_t n = 0;
+  int j;
+
+  for (j = 0; j < lanes && n < size; j++)
+    {
+      if (j > 0 && !is_char)
+	buf[n++] = ' ';
+      if (is_fp && lane_size == 8)
+	n += snprintf (buf + n, size - n, fmt, u->d[j]);
+      else if (is_fp)
+	n += snprintf (buf + n, size - n, fmt, u->f[j]);
+      else if (lane_size == 8)
+	n += snprintf (buf + n, size - n, fmt, u->ull[j]);
+      else if (lane_size == 4)
+	n += snprintf (buf + n, size - n, fmt, u->ui[j]);
+      else if (lane_size == 2)
+	n += snprintf (buf + n, size - n, fmt, u->sh[j]);
+      else
+	n += snprintf (buf + n, size - n, fmt, u->uc[j]);
+    }
+  return n;
+}
+
+static const char *const scalar_formats[] =
+{
+  "%d", "%x", "%s", "%f", "%g",
+};
+
+#define SCALAR_FORMATS_LEN \
+  (sizeof (scalar_formats) / sizeof (scalar_formats[0]))
+
+/* The time of one snprintf of each of scalar_formats.  */
+static void
+bench_scalar_printf (double *ns, int iters)
+{
+  struct timespec t0, t1;
+  char buf[64];
+  size_t k;
+  int i;
+
+  for (k = 0; k < SCALAR_FORMATS_LEN; k++)
+    {
+      const char *fmt = scalar_formats[k];
+      char conv = fmt[strlen (fmt) - 1];
+
+      clock_gettime (CLOCK_MONOTONIC, &t0);
+      for (i = 0; i < iters; i++)
+	if (conv == 's')
+	  snprintf (buf, sizeof (buf), fmt, "vector");
+	else if (conv == 'f' || conv == 'g')
+	  snprintf (buf, sizeof (buf), fmt, i * 0.37);
+	else
+	  snprintf (buf, sizeof (buf), fmt, i);
+      clock_gettime (CLOCK_MONOTONIC, &t1);
+      ns[k] = elapsed_ns (&t0, &t1) / iters;
+    }
+}
+
+static int
+bench_cmp_double (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+/* Time ROW->fmt every way the suite does.  printf goes to NULL_FD, which
+   stdout is pointed at for the length of the loop.  SAMPLES has room for
+   NSAMPLES latencies.  */
+static void
+bench_row (bench_row_t *row, int iters, FILE *null_fp, int null_fd,
+	   double *samples, int nsamples)
+{
+  const char *fmt = row->fmt;
+  char conv = fmt[strlen (fmt) - 1];
+  int is_fp = strchr ("fFeEgGaAr", conv) != NULL;
+  int size = strstr (fmt, "vv") != NULL ? 8 : 4;
+  struct timespec t0, t1;
+  char scalar[32];
+  char buf[4096];
+  double bytes = 0;
+  int lane_size;
+  vp_u_t u;
+  int stdout_fd;
+  int i;
+
+  for (i = 0; i < LIBVECTOR_VECTOR_WIDTH_BYTES; i++)
+    u.uc[i] = i * 37 + 11;
+
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < iters; i++)
+    {
+      bench_vary (&u, size, is_fp, i);
+      bytes += sprintf (buf, fmt, u.v);
+    }
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  row->sprintf_ns = elapsed_ns (&t0, &t1) / iters;
+  row->mb_s = bytes / elapsed_ns (&t0, &t1) * 1e3;
+
+  fflush (stdout);
+  stdout_fd = dup (STDOUT_FILENO);
+  dup2 (null_fd, STDOUT_FILENO);
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < iters; i++)
+    {
+      bench_vary (&u, size, is_fp, i);
+      printf (fmt, u.v);
+    }
+  fflush (stdout);
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  dup2 (stdout_fd, STDOUT_FILENO);
+  close (stdout_fd);
+  row->printf_ns = elapsed_ns (&t0, &t1) / iters;
+
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < iters; i++)
+    {
+      bench_vary (&u, size, is_fp, i);
+      fprintf (null_fp, fmt, u.v);
+    }
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  row->fprintf_ns = elapsed_ns (&t0, &t1) / iters;
+
+  row->scalar_ns = -1;
+  if (bench_scalar_format (fmt, scalar, &lane_size) == 0)
+    {
+      clock_gettime (CLOCK_MONOTONIC, &t0);
+      for (i = 0; i < iters; i++)
+	{
+	  bench_vary (&u, size, is_fp, i);
+	  bench_scalar (buf, sizeof (buf), scalar, lane_size, is_fp,
+			conv == 'c', &u);
+	}
+      clock_gettime (CLOCK_MONOTONIC, &t1);
+      row->scalar_ns = elapsed_ns (&t0, &t1) / iters;
+    }
+
+  for (i = 0; i < nsamples; i++)
+    {
+      bench_vary (&u, size, is_fp, i);
+      clock_gettime (CLOCK_MONOTONIC, &t0);
+      sprintf (buf, fmt, u.v);
+      clock_gettime (CLOCK_MONOTONIC, &t1);
+      samples[i] = elapsed_ns (&t0, &t1);
+    }
+  qsort (samples, nsamples, sizeof (*samples), bench_cmp_double);
+  row->p50_ns = samples[nsamples / 2];
+  row->p99_ns = samples[(int) (nsamples * 0.99)];
+  row->p999_ns = samples[(int) (nsamples * 0.999)];
+}
+
+static void
+bench_print_row (const bench_row_t *row)
+{
+  printf ("%-10s %8.1f %8.1f %8.1f %8.1f ", row->fmt, row->sprintf_ns,
+	  row->mb_s, row->printf_ns, row->fprintf_ns);
+  if (row->scalar_ns >= 0)
+    printf ("%8.1f", row->scalar_ns);
+  else
+    printf ("%8s", "-");
+  printf (" %7.0f %7.0f %7.0f\n", row->p50_ns, row->p99_ns, row->p999_ns);
+}
+
+static int
+bench_write_json (const char *path, const bench_row_t *rows, int nrows,
+		  int iters)
+{
+  FILE *fp = fopen (path, "w");
+  int i;
+
+  if (fp == NULL)
+    return -1;
+
+  fprintf (fp, "{\n  \"iterations\": %d,\n  \"suite\": [\n", iters);
+  for (i = 0; i < nrows; i++)
+    {
+      const bench_row_t *row = &rows[i];
+
+      fprintf (fp, "    { \"format\": \"%s\", \"sprintf_ns\": %.1f, "
+	       "\"sprintf_mb_s\": %.1f, \"printf_ns\": %.1f, "
+	       "\"fprintf_ns\": %.1f, ", row->fmt, row->sprintf_ns, row->mb_s,
+	       row->printf_ns, row->fprintf_ns);
+      if (row->scalar_ns >= 0)
+	fprintf (fp, "\"scalar_ns\": %.1f, ", row->scalar_ns);
+      else
+	fprintf (fp, "\"scalar_ns\": null, ");
+      fprintf (fp, "\"p50_ns\": %.0f, \"p99_ns\": %.0f, "
+	       "\"p999_ns\": %.0f }%s\n", row->p50_ns, row->p99_ns,
+	       row->p999_ns, i + 1 < nrows ? "," : "");
+    }
+  fprintf (fp, "  ]\n}\n");
+  return fclose (fp);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iters = 200000;
+  int max_threads = 8;
+  const char *json = NULL;
+  int nargs = 0;
+  vp_u_t u;
+  size_t k;
+  int i;
+
+  /* The unhooked side of the scalar test, in a process of its own.  */
+  if (argc == 3 && strcmp (argv[1], "--scalar") == 0)
+    {
+      double ns[SCALAR_FORMATS_LEN];
+
+      bench_scalar_printf (ns, atoi (argv[2]));
+      for (k = 0; k < SCALAR_FORMATS_LEN; k++)
+	printf ("%f\n", ns[k]);
+      return 0;
+    }
+
+  for (i = 1; i < argc; i++)
+    if (strcmp (argv[i], "--json") == 0 && i + 1 < argc)
+      json = argv[++i];
+    else if (nargs++ == 0)
+      iters = atoi (argv[i]);
+    else
+      max_threads = atoi (argv[i]);
+  if (iters <= 0)
+    iters = 200000;
+
+  for (i = 0; i < LIBVECTOR_VECTOR_WIDTH_BYTES; i++)
+    u.uc[i] = i * 37 + 11;
+
+  {
+    size_t nformats = sizeof (bench_formats) / sizeof (bench_formats[0]);
+    int nsamples = iters < 100000 ? iters : 100000;
+    double *samples = malloc (nsamples * sizeof (*samples));
+    bench_row_t *rows;
+    FILE *null_fp = fopen ("/dev/null", "w");
+    int null_fd = open ("/dev/null", O_WRONLY);
+    int nrows = 0;
+    const char *c;
+
+    for (k = 0; k < sizeof (bench_mods) / sizeof (bench_mods[0]); k++)
+      nformats += strlen (bench_mods[k].convs);
+    rows = calloc (nformats, sizeof (*rows));
+    if (samples == NULL || rows == NULL || null_fp == NULL || null_fd < 0)
+      {
+	perror ("suite");
+	return 1;
+      }
+
+    for (k = 0; k < sizeof (bench_mods) / sizeof (bench_mods[0]); k++)
+      for (c = bench_mods[k].convs; *c != '\0'; c++)
+	sprintf (rows[nrows++].fmt, "%%%s%c", bench_mods[k].mod, *c);
+    for (k = 0; k < sizeof (bench_formats) / sizeof (bench_formats[0]); k++)
+      strcpy (rows[nrows++].fmt, bench_formats[k]);
+
+    printf ("%-10s %8s %8s %8s %8s %8s %7s %7s %7s\n", "format", "sprintf",
+	    "MB/s", "printf", "fprintf", "scalar", "p50", "p99", "p999");
+    for (i = 0; i < nrows; i++)
+      {
+	bench_row (&rows[i], iters, null_fp, null_fd, samples, nsamples);
+	bench_print_row (&rows[i]);
+      }
+
+    if (json != NULL && bench_write_json (json, rows, nrows, iters) != 0)
+      perror (json);
+
+    close (null_fd);
+    fclose (null_fp);
+    free (rows);
+    free (samples);
+  }
+
+  {
+    double hooked[SCALAR_FORMATS_LEN], unhooked[SCALAR_FORMATS_LEN];
+    double disabled[SCALAR_FORMATS_LEN];
+    char self[1024];
+    char cmd[1200];
+    ssize_t n;
+    FILE *child = NULL;
+
+    bench_scalar_printf (hooked, iters);
+    vecpf_disable ();
+    bench_scalar_printf (disabled, iters);
+    vecpf_enable ();
+
+    n = readlink ("/proc/self/exe", self, sizeof (self) - 1);
+    if (n > 0)
+      {
+	self[n] = '\0';
+	snprintf (cmd, sizeof (cmd), "VECPF_MANUAL_ENABLE=1 '%s' --scalar %d",
+		  self, iters);
+	child = popen (cmd, "r");
+      }
+    for (k = 0; k < SCALAR_FORMATS_LEN; k++)
+      if (child == NULL || fscanf (child, "%lf", &unhooked[k]) != 1)
+	unhooked[k] = -1;
+    if (child != NULL)
+      pclose (child);
+
+    printf ("\n%-10s %10s %10s %10s\n", "scalar", "unhooked", "hooked",
+	    "disabled");
+    for (k = 0; k < SCALAR_FORMATS_LEN; k++)
+      printf ("%-10s %10.1f %10.1f %10.1f\n", scalar_formats[k], unhooked[k],
+	      hooked[k], disabled[k]);
+  }
+
+  {
+    static const char *const mt_formats[] = { "%vd\n", "%va\n" };
+    FILE *fp = fopen ("/dev/null", "w");
+    int nthreads;
+
+    if (fp == NULL)
+      {
+	perror ("/dev/null");
+	return 1;
+      }
+
+    printf ("\n%-10s %7s %10s\n", "format", "threads", "ns/call");
+
+    for (k = 0; k < sizeof (mt_formats) / sizeof (mt_formats[0]); k++)
+      for (nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+	{
+	  pthread_t tid[nthreads];
+	  bench_thread_arg_t arg;
+	  struct timespec t0, t1;
+
+	  arg.fp = fp;
+	  arg.fmt = mt_formats[k];
+	  arg.iters = iters / nthreads;
+
+	  clock_gettime (CLOCK_MONOTONIC, &t0);
+	  for (i = 0; i < nthreads; i++)
+	    pthread_create (&tid[i], NULL, bench_thread, &arg);
+	  for (i = 0; i < nthreads; i++)
+	    pthread_join (tid[i], NULL);
+	  clock_gettime (CLOCK_MONOTONIC, &t1);
+
+	  printf ("%-10.*s %7d %10.1f\n",
+		  (int) strlen (mt_formats[k]) - 1, mt_formats[k], nthreads,
+		  elapsed_ns (&t0, &t1) / (arg.iters * nthreads));
+	}
+
+    fclose (fp);
+  }
+
+  {
+    static const struct
+    {
+      const char *fmt;
+      int spec;
+      int lanes;
+    } array_formats[] =
+    {
+      { "%vd\n", VECPF_SPEC (VECPF_MOD_V, 'd'), 16 },
+      { "%vld\n", VECPF_SPEC (VECPF_MOD_VL, 'd'), 4 },
+      { "%vf\n", VECPF_SPEC (VECPF_MOD_V, 'f'), 4 },
+    };
+    size_t nvec = 4096;
+    vp_u_t *arr = malloc (nvec * sizeof (*arr));
+    FILE *fp = fopen ("/dev/null", "w");
+
+    if (arr == NULL || fp == NULL)
+      {
+	perror ("array");
+	return 1;
+      }
+    for (k = 0; k < nvec * LIBVECTOR_VECTOR_WIDTH_BYTES; k++)
+      ((unsigned char *) arr)[k] = k * 37 + 11;
+    for (k = 0; k < nvec; k++)
+      arr[k].f[0] = k * 0.37f;
+
+    printf ("\n%-10s %10s %10s\n", "array", "fprintf", "array");
+
+    for (k = 0; k < sizeof (array_formats) / sizeof (array_formats[0]); k++)
+      {
+	struct timespec t0, t1, t2;
+	int rounds = iters / nvec > 0 ? iters / nvec : 1;
+	size_t j;
+
+	clock_gettime (CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < rounds; i++)
+	  for (j = 0; j < nvec; j++)
+	    fprintf (fp, array_formats[k].fmt, arr[j].v);
+	clock_gettime (CLOCK_MONOTONIC, &t1);
+	for (i = 0; i < rounds; i++)
+	  vecpf_fprint_array (fp, arr, nvec * array_formats[k].lanes,
+			      array_formats[k].spec, 0, 0, -1, "\n");
+	clock_gettime (CLOCK_MONOTONIC, &t2);
+
+	printf ("%-10.*s %10.1f %10.1f\n",
+		(int) strlen (array_formats[k].fmt) - 1, array_formats[k].fmt,
+		elapsed_ns (&t0, &t1) / ((double) rounds * nvec),
+		elapsed_ns (&t1, &t2) / ((double) rounds * nvec));
+      }
+
+    fclose (fp);
+    free (arr);
+  }
+
+  {
+    struct timespec t0, t1, t2, t3;
+    const char *fmt = "%vd";
+    char *str;
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < iters; i++)
+      {
+	u.ui[0] = i;
+	if (asprintf (&str, fmt, u.v) >= 0)
+	  free (str);
+      }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    for (i = 0; i < iters; i++)
+      {
+	u.ui[0] = i;
+	if (vecpf_asprintf (&str, fmt, u.v) >= 0)
+	  free (str);
+      }
+    clock_gettime (CLOCK_MONOTONIC, &t2);
+    for (i = 0; i < iters; i++)
+      {
+	u.ui[0] = i;
+	vecpf_arena_printf (fmt, u.v);
+	if (i % 64 == 63)
+	  vecpf_arena_reset ();
+      }
+    clock_gettime (CLOCK_MONOTONIC, &t3);
+    vecpf_arena_reset ();
+
+    printf ("\n%-18s %10s\n", "string", "ns/call");
+    printf ("%-18s %10.1f\n", "asprintf", elapsed_ns (&t0, &t1) / iters);
+    printf ("%-18s %10.1f\n", "vecpf_asprintf", elapsed_ns (&t1, &t2) / iters);
+    printf ("%-18s %10.1f\n", "vecpf_arena_printf",
+	    elapsed_ns (&t2, &t3) / iters);
+  }
+
+  {
+    static const struct
+    {
+      const char *fmt;
+      int spec;
+    } length_formats[] =
+    {
+      { "%vld", VECPF_SPEC (VECPF_MOD_VL, 'd') },
+      { "%vd", VECPF_SPEC (VECPF_MOD_V, 'd') },
+    };
+    int sum = 0;
+
+    printf ("\n%-10s %10s %10s\n", "length", "snprintf", "length");
+
+    for (k = 0; k < sizeof (length_formats) / sizeof (length_formats[0]); k++)
+      {
+	struct timespec t0, t1, t2;
+
+	clock_gettime (CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < iters; i++)
+	  {
+	    u.ui[0] = i;
+	    sum += snprintf (NULL, 0, length_formats[k].fmt, u.v);
+	  }
+	clock_gettime (CLOCK_MONOTONIC, &t1);
+	for (i = 0; i < iters; i++)
+	  {
+	    u.ui[0] = i;
+	    sum += vecpf_formatted_length (&u, length_formats[k].spec, 0, 0,
+					   -1);
+	  }
+	clock_gettime (CLOCK_MONOTONIC, &t2);
+
+	printf ("%-10s %10.1f %10.1f\n", length_formats[k].fmt,
+		elapsed_ns (&t0, &t1) / iters, elapsed_ns (&t1, &t2) / iters);
+      }
+    /* Keep the calls from being optimized out.  */
+    if (sum == 0)
+      puts ("");
+  }
+
+  {
+    static const char *const engine_formats[] =
+    {
+      "%vld", "%vd", "%vx", "%vf", "%d: %vld;", "%s=%#vlx;",
+    };
+    char buf[512];
+
+    printf ("\n%-10s %10s %10s %10s\n", "engine", "snprintf", "vecpf",
+	    "plan");
+
+    for (k = 0; k < sizeof (engine_formats) / sizeof (engine_formats[0]); k++)
+      {
+	const char *fmt = engine_formats[k];
+	vecpf_plan_t *plan = vecpf_compile (fmt);
+	struct timespec t0, t1, t2, t3;
+
+	if (plan == NULL)
+	  {
+	    perror ("vecpf_compile");
+	    return 1;
+	  }
+
+	/* The scalar argument leads where there is one; the vector one is
+	   ignored when it isn't used.  */
+	clock_gettime (CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < iters; i++)
+	  {
+	    u.ui[0] = i;
+	    if (fmt[1] == 'd')
+	      snprintf (buf, sizeof (buf), fmt, i, u.v);
+	    else if (fmt[1] == 's')
+	      snprintf (buf, sizeof (buf), fmt, "key", u.v);
+	    else
+	      snprintf (buf, sizeof (buf), fmt, u.v);
+	  }
+	clock_gettime (CLOCK_MONOTONIC, &t1);
+	for (i = 0; i < iters; i++)
+	  {
+	    u.ui[0] = i;
+	    if (fmt[1] == 'd')
+	      vecpf_snprintf (buf, sizeof (buf), fmt, i, u.v);
+	    else if (fmt[1] == 's')
+	      vecpf_snprintf (buf, sizeof (buf), fmt, "key", u.v);
+	    else
+	      vecpf_snprintf (buf, sizeof (buf), fmt, u.v);
+	  }
+	clock_gettime (CLOCK_MONOTONIC, &t2);
+	for (i = 0; i < iters; i++)
+	  {
+	    u.ui[0] = i;
+	    if (fmt[1] == 'd')
+	      vecpf_sprint (plan, buf, sizeof (buf), i, u.v);
+	    else if (fmt[1] == 's')
+	      vecpf_sprint (plan, buf, sizeof (buf), "key", u.v);
+	    else
+	      vecpf_sprint (plan, buf, sizeof (buf), u.v);
+	  }
+	clock_gettime (CLOCK_MONOTONIC, &t3);
+	vecpf_plan_free (plan);
+
+	printf ("%-10s %10.1f %10.1f %10.1f\n", fmt,
+		elapsed_ns (&t0, &t1) / iters, elapsed_ns (&t1, &t2) / iters,
+		elapsed_ns (&t2, &t3) / iters);
+      }
+  }
+
+  {
+    static const struct
+    {
+      const char *name;
+      int spec;
+      int base;
+    } parse_formats[] =
+    {
+      { "%vld", VECPF_SPEC (VECPF_MOD_VL, 'd'), 10 },
+      { "%vx", VECPF_SPEC (VECPF_MOD_V, 'x'), 16 },
+      { "%vf", VECPF_SPEC (VECPF_MOD_V, 'f'), 0 },
+    };
+    size_t nvec = 64 * 1024;
+    vp_u_t *arr = malloc (nvec * sizeof (*arr));
+    vp_u_t *back = malloc (nvec * sizeof (*back));
+    char *text = NULL;
+
+    if (arr == NULL || back == NULL)
+      {
+	perror ("parse");
+	return 1;
+      }
+    for (k = 0; k < nvec * LIBVECTOR_VECTOR_WIDTH_BYTES; k++)
+      ((unsigned char *) arr)[k] = k * 37 + 11;
+    for (k = 0; k < nvec * 4; k++)
+      if (k % 3 == 0)
+	((float *) arr)[k] = k * 0.37f - 1e4f;
+
+    printf ("\n%-10s %10s %10s\n", "parse MB/s", "strto*", "parse");
+
+    for (k = 0; k < sizeof (parse_formats) / sizeof (parse_formats[0]); k++)
+      {
+	int spec = parse_formats[k].spec;
+	int lanes = parse_formats[k].base == 16 ? 16 : 4;
+	int rounds = iters / 50000 > 0 ? iters / 50000 : 1;
+	struct timespec t0, t1, t2;
+	ssize_t len;
+	size_t j;
+
+	len = vecpf_format_array (NULL, 0, arr, nvec * lanes, spec, 0, 0, -1,
+				  "\n");
+	text = realloc (text, len + 1);
+	if (text == NULL)
+	  {
+	    perror ("parse");
+	    return 1;
+	  }
+	vecpf_format_array (text, len + 1, arr, nvec * lanes, spec, 0, 0, -1,
+			    "\n");
+
+	clock_gettime (CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < rounds; i++)
+	  {
+	    const char *p = text;
+	    char *end;
+	    for (j = 0; j < nvec * lanes; j++)
+	      {
+		if (parse_formats[k].base == 10)
+		  back->si[j % 4] = strtol (p, &end, 10);
+		else if (parse_formats[k].base == 16)
+		  back->uc[j % 16] = strtoul (p, &end, 16);
+		else
+		  back->f[j % 4] = strtof (p, &end);
+		p = end;
+	      }
+	  }
+	clock_gettime (CLOCK_MONOTONIC, &t1);
+	for (i = 0; i < rounds; i++)
+	  vecpf_parse_array (text, spec, back, nvec * lanes, NULL);
+	clock_gettime (CLOCK_MONOTONIC, &t2);
+
+	/* Floating point lanes print rounded, so only integers read back
+	   exactly.  */
+	if (parse_formats[k].base != 0
+	    && memcmp (arr, back, nvec * sizeof (*arr)) != 0)
+	  printf ("%s did not read back\n", parse_formats[k].name);
+	printf ("%-10s %10.1f %10.1f\n", parse_formats[k].name,
+		len * (double) rounds / elapsed_ns (&t0, &t1) * 1e3,
+		len * (double) rounds / elapsed_ns (&t1, &t2) * 1e3);
+      }
+
+    free (text);
+    free (back);
+    free (arr);
+  }
+
+  {
+    size_t nvec = 256 * 1024;
+    vp_u_t *arr = malloc (nvec * sizeof (*arr));
+    int spec = VECPF_SPEC (VECPF_MOD_V, 'f');
+    double base_ns = 0;
+    ssize_t len;
+    char *out;
+    int nthreads;
+
+    if (arr == NULL)
+      {
+	perror ("parallel");
+	return 1;
+      }
+    for (k = 0; k < nvec * 4; k++)
+      ((float *) arr)[k] = k * 0.37f - 1e5f;
+
+    len = vecpf_format_array (NULL, 0, arr, nvec * 4, spec, 0, 0, -1, "\n");
+    out = malloc (len + 1);
+    if (out == NULL)
+      {
+	perror ("parallel");
+	return 1;
+      }
+
+    printf ("\n%-10s %7s %10s %8s\n", "parallel", "threads", "MB/s",
+	    "speedup");
+
+    for (nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+      {
+	struct timespec t0, t1;
+	int rounds = iters / 50000 > 0 ? iters / 50000 : 1;
+	double ns;
+
+	/* Once untimed, so the pool's threads are already running.  */
+	vecpf_format_array_mt (out, len + 1, arr, nvec * 4, spec, 0, 0, -1,
+			       "\n", nthreads);
+
+	clock_gettime (CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < rounds; i++)
+	  vecpf_format_array_mt (out, len + 1, arr, nvec * 4, spec, 0, 0, -1,
+				 "\n", nthreads);
+	clock_gettime (CLOCK_MONOTONIC, &t1);
+
+	ns = elapsed_ns (&t0, &t1) / rounds;
+	if (nthreads == 1)
+	  base_ns = ns;
+	printf ("%-10s %7d %10.1f %8.2f\n", "%vf", nthreads,
+		nvec * sizeof (*arr) / ns * 1e3, base_ns / ns);
+      }
+
+    free (out);
+    free (arr);
+  }
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+/* Time the C++ interfaces in vecpf.hpp.  Run with "make bench"; the
+   optional argument is the number of times each array is written.
+
+   The chunk test writes a 4 MiB array of vectors, one per line, to
+   /dev/null two ways: by formatting all of it into one string with
+   vecpf_format_array and writing that, and by writing each chunk
+   vecpf::format_chunks yields as it comes.  It reports the input
+   consumed per second of each, and the memory each holds for the
+   text.  */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "vecpf.hpp"
+
+static double
+elapsed_ns (const struct timespec *t0, const struct timespec *t1)
+{
+  return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+#ifdef __cpp_impl_coroutine
+/* Writes all of [P, P + N) to FD.  */
+static int
+write_all (int fd, const char *p, size_t n)
+{
+  while (n > 0)
+    {
+      ssize_t w = write (fd, p, n);
+
+      if (w < 0)
+	return -1;
+      p += w;
+      n -= w;
+    }
+  return 0;
+}
+
+/* Both ways of writing VECS with CONV, ROUNDS times each.  */
+template<typename V>
+  static int
+  bench_chunks (const char *name, std::span<const V> vecs, char conv,
+		int fd, int rounds)
+  {
+    typedef vecpf::detail::lane_traits<V> T;
+    int spec = VECPF_SPEC (T::mod, conv);
+    size_t nelem = vecs.size () * (16 / T::size);
+    size_t chunk_size = 64 * 1024;
+    size_t held = 0;
+    struct timespec t0, t1, t2;
+    int i;
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < rounds; i++)
+      {
+	ssize_t len = vecpf_format_array (NULL, 0, vecs.data (), nelem, spec,
+					  0, 0, -1, "\n");
+	std::unique_ptr<char[]> text (new char[len + 1]);
+
+	vecpf_format_array (text.get (), len + 1, vecs.data (), nelem, spec,
+			    0, 0, -1, "\n");
+	if (write_all (fd, text.get (), len) < 0)
+	  return -1;
+	held = len + 1;
+      }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    for (i = 0; i < rounds; i++)
+      for (std::string_view chunk
+	   : vecpf::format_chunks (vecs, { conv }, chunk_size))
+	if (write_all (fd, chunk.data (), chunk.size ()) < 0)
+	  return -1;
+    clock_gettime (CLOCK_MONOTONIC, &t2);
+
+    printf ("%-10s %10.1f %10.1f %10zu %10zu\n", name,
+	    vecs.size_bytes () * (double) rounds / elapsed_ns (&t0, &t1) * 1e3,
+	    vecs.size_bytes () * (double) rounds / elapsed_ns (&t1, &t2) * 1e3,
+	    held / 1024, chunk_size / 1024);
+    return 0;
+  }
+#endif
+
+int
+main (int argc, char *argv[])
+{
+  int rounds = argc > 1 ? atoi (argv[1]) : 20;
+
+  if (rounds <= 0)
+    rounds = 1;
+
+#ifdef __cpp_impl_coroutine
+  {
+    size_t nvec = 256 * 1024;
+    std::unique_ptr<__vector signed int[]> ints (new __vector signed int[nvec]);
+    std::unique_ptr<__vector float[]> floats (new __vector float[nvec]);
+    int fd = open ("/dev/null", O_WRONLY);
+    size_t k;
+
+    if (fd < 0)
+      {
+	perror ("/dev/null");
+	return 1;
+      }
+    for (k = 0; k < nvec * 4; k++)
+      {
+	((int *) ints.get ())[k] = (int) (k * 2654435761U);
+	((float *) floats.get ())[k] = k * 0.37f - 1e5f;
+      }
+
+    printf ("\n%-10s %10s %10s %10s %10s\n", "chunks", "whole MB/s",
+	    "chunk MB/s", "whole KiB", "chunk KiB");
+    if (bench_chunks<__vector signed int> ("%vld",
+					   std::span (ints.get (), nvec), 'd',
+					   fd, rounds) < 0
+	|| bench_chunks<__vector float> ("%vf",
+					 std::span (floats.get (), nvec), 'f',
+					 fd, rounds) < 0)
+      {
+	perror ("write");
+	return 1;
+      }
+    close (fd);
+  }
+#else
+  puts ("No coroutines, no chunk test.");
+#endif
+
+  return 0;
+}
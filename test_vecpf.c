@@ -22,15 +22,30 @@
 
    Please see libvecpf/LICENSE for more information.  */
 
-#include <altivec.h>
+#include <errno.h>
+#include <fenv.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <locale.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "config.h"
+/* The tests are written with AltiVec's "vector unsigned int".  */
+#define VECPF_VECTOR_KEYWORD 1
 #include "vecpf.h"
 
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+#if defined HAVE_ISA_POWER8 || defined HAVE_ISA_POWER9 \
+    || defined HAVE_ISA_POWER10
+# include <sys/auxv.h>
+#endif
+
 /* What to test:
 
    The Altivec Programming Interface Manual extends printf in the following
@@ -112,19 +127,26 @@
 
 vector unsigned int UINT32_TEST_VECTOR = { 4294967295U, 0, 39, 2147483647 };
 vector signed int INT32_TEST_VECTOR = { (-INT_MAX - 1), 0, 39, 2147483647 };
+/* Values either side of the digit group boundaries in the decimal kernels. */
+vector unsigned int UINT32_GROUPS_TEST_VECTOR = { 9999, 10000, 99999999, 100000000 };
 vector unsigned short UINT16_TEST_VECTOR = {65535U, 0, 39, 42, 101, 16384, 32767, 32768 };
 vector signed short INT16_TEST_VECTOR = { (-SHRT_MAX -1), -127, -1, 0, 127, 256, 16384, SHRT_MAX };
 vector float FLOAT_TEST_VECTOR = { -(11.0f/9.0f), 0.123456789f, 42.0f, 9876543210.123456789f };
+vector float FLOAT_SPECIAL_TEST_VECTOR = { -0.0f, 2.5f, __builtin_inff (), -__builtin_nanf ("") };
+vector float SHORTEST_FLOAT_TEST_VECTOR = { 0.1f, -1.5e-10f, 123456789.0f, 3.4028235e38f };
 vector signed char SIGNED_CHAR_TEST_VECTOR = { -128, -120, -99, -61, -43, -38, -1, 0, 1, 19, 76, 85, 10l, 123, 126, 127 };
 vector unsigned char UNSIGNED_CHAR_TEST_VECTOR = { 't', 'h', 'i', 's', ' ', 's', 'p', 'a', 'c', 'e', ' ', 0, 15, 127, 128, 255  };
 vector char CHAR_TEST_VECTOR = { 't', 'h', 'i', 's', ' ', 's', 'p', 'a', 'c', 'e', ' ', 'i', 's', ' ', 'f', 'o'  };
 
-#ifdef __VSX__
+#ifdef VECPF_HAVE_VSX_TYPES
 vector double DOUBLE_TEST_VECTOR = { -(11.0f/9.0f), 9876543210.123456789f };
 vector unsigned long long UINT64_TEST_VECTOR = { -1, 0x1ABCDE0123456789 };
 vector long long INT64_TEST_VECTOR = { LONG_MIN, LONG_MAX };
 vector unsigned long UINT64_TEST_VECTOR_2 = { 0x1ABCDE0123456789, -1 };
 vector long INT64_TEST_VECTOR_2 = { LONG_MAX, LONG_MIN };
+vector unsigned long long UINT64_GROUPS_TEST_VECTOR = { 9999999999999999ULL, 10000000000000000ULL };
+vector double SHORTEST_DOUBLE_TEST_VECTOR = { 0.1 + 0.2, 5e-324 };
+vector double SHORTEST_DOUBLE_TEST_VECTOR_2 = { 1e16, -1e17 };
 #endif
 
 #ifdef HAVE_INT128_T
@@ -134,6 +156,34 @@ vector __int128_t INT128_TEST_VECTOR  = (vector __int128_t) { ((((__int128_t)-0x
 int test_count = 0, failed = 0, verbose = 0;
 char expected_output[1024], actual_output[1024];
 
+/* The 'r' conversion has no scalar counterpart to compare against, so its
+   tests give the expected output directly.  */
+typedef struct {
+  int src_line;                /* What line of code is the test on? */
+  const char *format;          /* Format string to use for the vector */
+  const char *expected;        /* What it should print */
+} expected_outputs;
+
+#define test_expected( tests, val ) \
+  for (eptr = tests; eptr->format; eptr++) \
+    { \
+      sprintf (actual_output, eptr->format, val); \
+      compare (eptr->src_line, eptr->expected, actual_output); \
+    }
+
+/* vecpf_format takes the pieces of a conversion as arguments rather than
+   a format string.  Each of these tests checks it against printf with the
+   equivalent format string.  */
+typedef struct {
+  int src_line;                /* What line of code is the test on? */
+  const void *vec;             /* Vector to format */
+  int spec;                    /* Arguments to vecpf_format */
+  int flags;
+  int width;
+  int prec;
+  const char *format;          /* Equivalent format string */
+} direct_format_tests;
+
 /* Tests are organized by data type.  Try to print a vector using a variety
    of different flags, precisions and conversions. */
 typedef struct {
@@ -1177,10 +1227,48 @@ format_specifiers float_tests[] =
   { __LINE__, "%'25.3A",  "%'25.3vA", NULL },
   { __LINE__, "%025.3A",  "%025.3vA", NULL },
 
+  /* F has no flags of its own; check it against the f forms. */
+  { __LINE__, "%F",  "%vF", NULL },
+  { __LINE__, "%-F", "%-vF", NULL },
+  { __LINE__, "%+F", "%+vF", NULL },
+  { __LINE__, "% F", "% vF", NULL },
+  { __LINE__, "%#F", "%#vF", NULL },
+  { __LINE__, "%0F", "%0vF", NULL },
+  { __LINE__, "%.9F",  "%.9vF", NULL },
+  { __LINE__, "%20F",  "%20vF", NULL },
+  { __LINE__, "%-25.3F",  "%-25.3vF", NULL },
+  { __LINE__, "%025.3F",  "%025.3vF", NULL },
+
+  /* Precisions that exercise rounding at both ends. */
+  { __LINE__, "%.0f",  "%.0vf", NULL },
+  { __LINE__, "%#.0f",  "%#.0vf", NULL },
+  { __LINE__, "%.40f",  "%.40vf", NULL },
+  { __LINE__, "%.0e",  "%.0ve", NULL },
+  { __LINE__, "%.30e",  "%.30ve", NULL },
+  { __LINE__, "%.1g",  "%.1vg", NULL },
+  { __LINE__, "%#.2g",  "%#.2vg", NULL },
+  { __LINE__, "%.12g",  "%.12vg", NULL },
+
   { 0, NULL, NULL }
 };
 
-#ifdef __VSX__
+/* Values that take the fast paths and the special cases in the floating
+   point kernels. */
+format_specifiers float_special_tests[] =
+{
+  { __LINE__, "%f",  "%vf", NULL },
+  { __LINE__, "%F",  "%vF", NULL },
+  { __LINE__, "%+e",  "%+ve", NULL },
+  { __LINE__, "%E",  "%vE", NULL },
+  { __LINE__, "%#g",  "%#vg", NULL },
+  { __LINE__, "%G",  "%vG", NULL },
+  { __LINE__, "%010f",  "%010vf", NULL },
+  { __LINE__, "%-10.1e",  "%-10.1ve", NULL },
+  { __LINE__, "%.0f",  "%.0vf", NULL },
+  { 0, NULL, NULL }
+};
+
+#ifdef VECPF_HAVE_VSX_TYPES
 format_specifiers double_tests[] =
 {
   { __LINE__, "%f",  "%vvf", NULL },
@@ -1244,6 +1332,16 @@ format_specifiers double_tests[] =
   { __LINE__, "%'25.3f",  "%'25.3vvf", NULL },
   { __LINE__, "%025.3f",  "%025.3vvf", NULL },
 
+  /* The other conversions, including the upper case variants. */
+  { __LINE__, "%F",  "%vvF", NULL },
+  { __LINE__, "%e",  "%vve", NULL },
+  { __LINE__, "%-+30.12E",  "%-+30.12vvE", NULL },
+  { __LINE__, "%g",  "%vvg", NULL },
+  { __LINE__, "%.17g",  "%.17vvg", NULL },
+  { __LINE__, "%#G",  "%#vvG", NULL },
+  { __LINE__, "%.60f",  "%.60vvf", NULL },
+  { __LINE__, "%.30e",  "%.30vve", NULL },
+
   { 0, NULL, NULL, NULL }
 };
 
@@ -1869,6 +1967,90 @@ format_specifiers int128_tests[] =
 };
 #endif
 
+expected_outputs shortest_float_tests[] =
+{
+  { __LINE__, "%vr", "0.1 -1.5e-10 123456790 3.4028235e+38" },
+  { __LINE__, "%+vr", "+0.1 -1.5e-10 +123456790 +3.4028235e+38" },
+  { __LINE__, "% vr", " 0.1 -1.5e-10  123456790  3.4028235e+38" },
+  { __LINE__, "%-9vr|", "0.1       -1.5e-10  123456790 3.4028235e+38|" },
+  { __LINE__, "%011vr", "000000000.1 -0001.5e-10 00123456790 3.4028235e+38" },
+  { __LINE__, "%.3vr", "0.1 -1.5e-10 123456790 3.4028235e+38" },
+  { 0, NULL, NULL }
+};
+
+expected_outputs shortest_float_special_tests[] =
+{
+  { __LINE__, "%vr", "-0 2.5 inf -nan" },
+  { __LINE__, "%05vr", "-0000 002.5   inf  -nan" },
+  { 0, NULL, NULL }
+};
+
+#ifdef VECPF_HAVE_VSX_TYPES
+expected_outputs shortest_double_tests[] =
+{
+  { __LINE__, "%vvr", "0.30000000000000004 5e-324" },
+  { __LINE__, "%+22vvr", "  +0.30000000000000004                +5e-324" },
+  { 0, NULL, NULL }
+};
+
+expected_outputs shortest_double_tests_2[] =
+{
+  { __LINE__, "%vvr", "10000000000000000 -1e+17" },
+  { 0, NULL, NULL }
+};
+#endif
+
+direct_format_tests direct_tests[] =
+{
+  { __LINE__, &UINT32_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VL, 'u'), 0, 0, -1, "%vlu" },
+  { __LINE__, &INT32_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VL, 'd'), VECPF_FLAG_PLUS, 12, -1, "%+12vld" },
+  { __LINE__, &UINT32_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VL, 'x'), VECPF_FLAG_ALT | VECPF_FLAG_ZERO, 12, -1, "%#012vlx" },
+  { __LINE__, &INT16_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VH, 'i'), VECPF_FLAG_LEFT, 7, 2, "%-7.2vhi" },
+  { __LINE__, &UINT16_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VH, 'o'), VECPF_FLAG_ALT, 0, -1, "%#vho" },
+  { __LINE__, &SIGNED_CHAR_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_V, 'd'), VECPF_FLAG_SPACE, 0, -1, "% vd" },
+  { __LINE__, &CHAR_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_V, 'c'), 0, 0, -1, "%vc" },
+  { __LINE__, &FLOAT_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_V, 'f'), 0, 0, 2, "%.2vf" },
+  { __LINE__, &FLOAT_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_V, 'E'), VECPF_FLAG_ZERO, 16, -1, "%016vE" },
+  { __LINE__, &FLOAT_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_V, 'g'), VECPF_FLAG_ALT, 0, -1, "%#vg" },
+  /* No lane kernel for 'a'; this goes through the libc fallback.  */
+  { __LINE__, &FLOAT_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_V, 'a'), 0, 0, -1, "%va" },
+  { __LINE__, &SHORTEST_FLOAT_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_V, 'r'), 0, 0, -1, "%vr" },
+#ifdef VECPF_HAVE_VSX_TYPES
+  { __LINE__, &DOUBLE_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VV, 'e'), 0, 0, 10, "%.10vve" },
+  { __LINE__, &UINT64_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VLL, 'X'), 0, 0, -1, "%vllX" },
+  { __LINE__, &INT64_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VLL, 'd'), 0, 24, -1, "%24vlld" },
+#endif
+#ifdef HAVE_INT128_T
+  { __LINE__, &INT128_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VZ, 'x'), 0, 0, -1, "%vzx" },
+#endif
+  { 0, NULL, 0, 0, 0, 0, NULL }
+};
+
+/* Arrays whose length isn't a whole number of vectors, to check that the
+   last record stops at the last element.  */
+float FLOAT_TEST_ARRAY[10] = { 1.5f, -2.25f, 3.0f, 4.125f, 5.0f, -6.5f, 7.0f,
+                               8.75f, 9.5f, -10.0f };
+unsigned int UINT32_TEST_ARRAY[6] = { 1, 22, 333, 4444, 55555, 4294967295u };
+unsigned char CHAR_TEST_ARRAY[19] = "Hello, vector world";
+
+/* 32 and 64 byte vectors, as AVX2 and AVX-512 registers hold them.  On
+   x86 they are passed to a variadic function on the stack whether or not
+   AVX is enabled, so GCC's warning that the ABI depends on it doesn't
+   apply to the calls below.  */
+#if defined (__GNUC__) && !defined (__clang__)
+# pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+typedef int v8si_t __attribute__ ((vector_size (32)));
+typedef long long v4di_t __attribute__ ((vector_size (32)));
+typedef double v8df_t __attribute__ ((vector_size (64)));
+
+/* Enough vectors for the parallel formatter to split into a few pieces,
+   with a short tail.  Filled in by main.  */
+#define MT_TEST_ARRAY_LEN (3 * 2048 * 4 + 3)
+float MT_TEST_ARRAY[MT_TEST_ARRAY_LEN];
+char mt_expected_output[MT_TEST_ARRAY_LEN * 16];
+char mt_actual_output[MT_TEST_ARRAY_LEN * 16];
+
 void
 gen_cmp_str (int data_type, void* data, const char *format, char *output)
 {
@@ -1905,7 +2087,7 @@ gen_cmp_str (int data_type, void* data, const char *format, char *output)
     case VDT_float:
       to_string (float, format, data, output);
       break;
-#ifdef __VSX__
+#ifdef VECPF_HAVE_VSX_TYPES
     case VDT_double:
       to_string (double, format, data, output);
       break;
@@ -1924,7 +2106,7 @@ gen_cmp_str (int data_type, void* data, const char *format, char *output)
 #endif
 #ifdef HAVE_INT128_T
     case VDT_int128:
-# ifdef __LITTLE_ENDIAN__
+# if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
       output += sprintf (output, format, ((unsigned long long*) data)[1]);
       sprintf (output, format, ((unsigned long long*) data)[0]);
 # else
@@ -1950,14 +2132,178 @@ compare (int src_line, const char* expected, const char* actual)
   test_count++;
 }
 
+/* Check vecpf_formatted_length against vecpf_format, and what vecpf_format
+   returns against VECPF_FORMAT_MAXLEN, for the vector at VEC with every
+   conversion and a few flags, widths and precisions.  One test per
+   modifier and conversion.  */
+static void
+test_lengths (int src_line, const void *vec)
+{
+  static const char convs[] = "diouxXcfFeEgGaAr";
+  static const int flag_sets[] =
+  {
+    0, VECPF_FLAG_ALT | VECPF_FLAG_PLUS, VECPF_FLAG_ZERO | VECPF_FLAG_SPACE,
+    VECPF_FLAG_LEFT | VECPF_FLAG_ALT
+  };
+  static const int widths[] = { 0, 30 };
+  static const int precs[] = { -1, 0, 25 };
+  char expected[128], actual[128];
+  int mod, c, f, w, p;
+
+  for (mod = 0; mod <= VECPF_MOD_VZ + 1; mod++)
+    for (c = 0; convs[c]; c++)
+      {
+        sprintf (expected, "%d %c", mod, convs[c]);
+        strcpy (actual, expected);
+        for (f = 0; f < 4; f++)
+          for (w = 0; w < 2; w++)
+            for (p = 0; p < 3; p++)
+              {
+                int spec = VECPF_SPEC (mod, convs[c]);
+                int len = vecpf_format (NULL, 0, vec, spec, flag_sets[f],
+                                        widths[w], precs[p]);
+                int bound = VECPF_FORMAT_MAXLEN (mod, convs[c], widths[w],
+                                                 precs[p]);
+                int n = vecpf_formatted_length (vec, spec, flag_sets[f],
+                                                widths[w], precs[p]);
+
+                if (n != len || len >= bound)
+                  sprintf (actual, "%d %c flags %#x width %d prec %d: "
+                           "length %d, formatted %d, bound %d", mod,
+                           convs[c], flag_sets[f], widths[w], precs[p], n,
+                           len, bound);
+              }
+        compare (src_line, expected, actual);
+      }
+}
+
+/* Check the 32 and 64 byte forms of every conversion of the 64 bytes at
+   VEC against the 16 byte form of each of their sixteen byte pieces, and
+   their lengths as test_lengths does.  One test per width, modifier and
+   conversion.  */
+static void
+test_wide (int src_line, const void *vec)
+{
+  static const char convs[] = "diouxXcfFeEgGaAr";
+  static const int flag_sets[] =
+  {
+    0, VECPF_FLAG_ALT | VECPF_FLAG_PLUS, VECPF_FLAG_ZERO | VECPF_FLAG_SPACE
+  };
+  static const int widths[] = { 0, 30 };
+  static const int precs[] = { -1, 3 };
+  static char expected[8192], actual[8192];
+  char label[32], result[256];
+  int wide, mod, c, f, w, p, k, used, n;
+
+  for (wide = VECPF_MOD_256; wide <= VECPF_MOD_512; wide += VECPF_MOD_256)
+    for (mod = 0; mod <= VECPF_MOD_VZ + 1; mod++)
+      for (c = 0; convs[c]; c++)
+        {
+          sprintf (label, "%d %d %c", VECPF_VECTOR_SIZE (wide), mod,
+                   convs[c]);
+          strcpy (result, label);
+          for (f = 0; f < 3; f++)
+            for (w = 0; w < 2; w++)
+              for (p = 0; p < 2; p++)
+                {
+                  int spec = VECPF_SPEC (mod | wide, convs[c]);
+                  int len = vecpf_format (actual, sizeof (actual), vec, spec,
+                                          flag_sets[f], widths[w], precs[p]);
+                  int bound = VECPF_FORMAT_MAXLEN (mod | wide, convs[c],
+                                                   widths[w], precs[p]);
+
+                  /* 'c' prints a zero lane as a null byte, so the pieces
+                     are put together by their lengths.  */
+                  for (k = used = 0; k < VECPF_VECTOR_SIZE (wide) / 16; k++)
+                    {
+                      if (k > 0 && convs[c] != 'c')
+                        expected[used++] = ' ';
+                      n = vecpf_format (expected + used,
+                                        sizeof (expected) - used,
+                                        (const char *) vec + 16 * k,
+                                        VECPF_SPEC (mod, convs[c]),
+                                        flag_sets[f], widths[w], precs[p]);
+                      if (n < 0)
+                        break;
+                      used += n;
+                    }
+                  n = vecpf_formatted_length (vec, spec, flag_sets[f],
+                                              widths[w], precs[p]);
+
+                  /* What isn't a conversion at 16 bytes isn't one wider
+                     either.  */
+                  if (k < VECPF_VECTOR_SIZE (wide) / 16)
+                    {
+                      if (len != -1 || n != -1)
+                        sprintf (result, "%s flags %#x: length %d, "
+                                 "formatted %d", label, flag_sets[f], n,
+                                 len);
+                    }
+                  else if (used != len || memcmp (expected, actual, len) != 0
+                           || n != len || len >= bound)
+                    sprintf (result, "%s flags %#x width %d prec %d: "
+                             "\"%.60s\" length %d, formatted %d, bound %d",
+                             label, flag_sets[f], widths[w], precs[p],
+                             actual, n, len, bound);
+                }
+          compare (src_line, label, result);
+        }
+}
+
+/* Whether the processor runs the lane kernels built for the level ISA, as
+   vecpf_isa names it, or -1 if they weren't built.  */
+static int
+isa_runs (const char *isa)
+{
+#ifdef HAVE_ISA_POWER8
+  if (strcmp (isa, "power8") == 0)
+    return (getauxval (AT_HWCAP2) & PPC_FEATURE2_ARCH_2_07) != 0;
+#endif
+#ifdef HAVE_ISA_POWER9
+  if (strcmp (isa, "power9") == 0)
+    return (getauxval (AT_HWCAP2) & PPC_FEATURE2_ARCH_3_00) != 0;
+#endif
+#ifdef HAVE_ISA_POWER10
+  if (strcmp (isa, "power10") == 0)
+    return (getauxval (AT_HWCAP2) & PPC_FEATURE2_ARCH_3_1) != 0;
+#endif
+#ifdef HAVE_ISA_X86_64_V3
+  if (strcmp (isa, "x86-64-v3") == 0)
+    return __builtin_cpu_supports ("x86-64-v3") != 0;
+#endif
+#ifdef HAVE_ISA_X86_64_V4
+  if (strcmp (isa, "x86-64-v4") == 0)
+    return __builtin_cpu_supports ("x86-64-v4") != 0;
+#endif
+  return strcmp (isa, "baseline") == 0 ? 1 : -1;
+}
+
 int
 main (int argc, char *argv[])
 {
   format_specifiers *ptr;
+  expected_outputs *eptr;
+  direct_format_tests *dptr;
+  vector unsigned int vec;
+  int len, i;
+  FILE *fp;
+  char *str, *str2;
+  const char *fmt;
+  vecpf_arena_stats_t stats;
+  vp_u_t vp_u;
+  unsigned int parsed[8];
+  unsigned int wide_parsed[16];
+  vp_u_t wide_vec[4];
+  const char *end;
+  vecpf_plan_t *plan;
+  char maxlen_buf[VECPF_FORMAT_MAXLEN (VECPF_MOD_VL, 'd', 0, -1)];
 
   puts ("\nUnsigned 32 bit integer tests.\n");
   test(uint32_tests, VDT_unsigned_int, UINT32_TEST_VECTOR)
 
+  puts ("\nUnsigned 32 bit integer tests - decimal digit groups.\n");
+  test(uint32_tests, VDT_unsigned_int, UINT32_GROUPS_TEST_VECTOR)
+
   puts ("\nSigned 32 bit integer tests.\n");
   test(int32_tests, VDT_signed_int, INT32_TEST_VECTOR)
 
@@ -1970,6 +2316,28 @@ main (int argc, char *argv[])
   puts ("\nFloat tests.\n");
   test(float_tests, VDT_float, FLOAT_TEST_VECTOR)
 
+  puts ("\nFloat special value tests.\n");
+  test(float_special_tests, VDT_float, FLOAT_SPECIAL_TEST_VECTOR)
+
+  /* The library rounds to nearest itself, and leaves other modes to libc.  */
+  fesetround (FE_UPWARD);
+  vecpf_snprintf (actual_output, sizeof (actual_output), "%.1vf",
+                  (vector float) { 0.25f, -0.25f, 0.75f, 2.25f });
+  compare (__LINE__, "0.3 -0.2 0.8 2.3", actual_output);
+  fesetround (FE_TONEAREST);
+  vecpf_snprintf (actual_output, sizeof (actual_output), "%.1vf",
+                  (vector float) { 0.25f, -0.25f, 0.75f, 2.25f });
+  compare (__LINE__, "0.2 -0.2 0.8 2.2", actual_output);
+
+  puts ("\nFloat shortest round trip tests.\n");
+  test_expected(shortest_float_tests, SHORTEST_FLOAT_TEST_VECTOR)
+  test_expected(shortest_float_special_tests, FLOAT_SPECIAL_TEST_VECTOR)
+  vecpf_shortest_float (actual_output, sizeof (actual_output),
+                        SHORTEST_FLOAT_TEST_VECTOR);
+  compare (__LINE__, shortest_float_tests[0].expected, actual_output);
+  vecpf_shortest_float (actual_output, 8, SHORTEST_FLOAT_TEST_VECTOR);
+  compare (__LINE__, "0.1 -1.", actual_output);
+
   puts ("\nChar tests - test 'character' ouput.\n");
   test(char_tests, VDT_unsigned_char, CHAR_TEST_VECTOR)
 
@@ -1984,7 +2352,7 @@ main (int argc, char *argv[])
   test(int128_tests, VDT_int128, INT128_TEST_VECTOR)
 #endif
 
-#ifdef __VSX__
+#ifdef VECPF_HAVE_VSX_TYPES
   puts ("\nDouble tests (VSX).\n");
   test(double_tests, VDT_double, DOUBLE_TEST_VECTOR)
 
@@ -1999,6 +2367,593 @@ main (int argc, char *argv[])
 
   puts ("\nUnsigned 64 bit integer tests (unsigned long).\n");
   test(uint64_tests, VDT_unsigned_long, UINT64_TEST_VECTOR_2)
+
+  puts ("\nUnsigned 64 bit integer tests - decimal digit groups.\n");
+  test(uint64_tests, VDT_unsigned_long, UINT64_GROUPS_TEST_VECTOR)
+
+  puts ("\nDouble shortest round trip tests (VSX).\n");
+  test_expected(shortest_double_tests, SHORTEST_DOUBLE_TEST_VECTOR)
+  test_expected(shortest_double_tests_2, SHORTEST_DOUBLE_TEST_VECTOR_2)
+  vecpf_shortest_double (actual_output, sizeof (actual_output),
+                         SHORTEST_DOUBLE_TEST_VECTOR);
+  compare (__LINE__, shortest_double_tests[0].expected, actual_output);
+#endif
+
+  puts ("\nDirect formatting tests.\n");
+  for (dptr = direct_tests; dptr->format; dptr++)
+    {
+      memcpy (&vec, dptr->vec, sizeof (vec));
+      sprintf (expected_output, dptr->format, vec);
+      vecpf_format (actual_output, sizeof (actual_output), dptr->vec,
+                    dptr->spec, dptr->flags, dptr->width, dptr->prec);
+      compare (dptr->src_line, expected_output, actual_output);
+      /* A buffer with room for all a kernel may use is rendered into in
+         place.  */
+      vecpf_format (mt_actual_output, sizeof (mt_actual_output), dptr->vec,
+                    dptr->spec, dptr->flags, dptr->width, dptr->prec);
+      compare (dptr->src_line, expected_output, mt_actual_output);
+    }
+
+  /* A short buffer gets what fits, and the return value says how much
+     room the whole output needs.  */
+  len = vecpf_format (actual_output, 6, &UINT32_TEST_VECTOR,
+                      VECPF_SPEC (VECPF_MOD_VL, 'u'), 0, 0, -1);
+  compare (__LINE__, "42949", actual_output);
+  sprintf (expected_output, "%d", len);
+  compare (__LINE__, "26", expected_output);
+
+  /* 'h' alone isn't a vector modifier.  */
+  len = vecpf_format (actual_output, sizeof (actual_output),
+                      &UINT32_TEST_VECTOR, VECPF_SPEC (VECPF_MOD_VH, 'f'),
+                      0, 0, -1);
+  sprintf (expected_output, "%d", len);
+  compare (__LINE__, "-1", expected_output);
+
+  puts ("\nOutput length tests.\n");
+  for (dptr = direct_tests; dptr->format; dptr++)
+    {
+      memcpy (&vec, dptr->vec, sizeof (vec));
+      sprintf (expected_output, "%d",
+               (int) snprintf (NULL, 0, dptr->format, vec));
+      sprintf (actual_output, "%d",
+               vecpf_formatted_length (dptr->vec, dptr->spec, dptr->flags,
+                                       dptr->width, dptr->prec));
+      compare (dptr->src_line, expected_output, actual_output);
+    }
+
+  memset (&vp_u, 0, sizeof (vp_u));
+  test_lengths (__LINE__, &vp_u);
+  memset (&vp_u, 0xff, sizeof (vp_u));
+  test_lengths (__LINE__, &vp_u);
+  memset (&vp_u, 0x80, sizeof (vp_u));
+  test_lengths (__LINE__, &vp_u);
+  for (i = 0; i < 4; i++)
+    vp_u.f[i] = -3.40282347e+38f;
+  test_lengths (__LINE__, &vp_u);
+  vp_u.d[0] = vp_u.d[1] = -1.7976931348623157e+308;
+  test_lengths (__LINE__, &vp_u);
+  test_lengths (__LINE__, &INT16_TEST_VECTOR);
+
+  /* The bound is a constant expression.  */
+  memset (&vp_u, 0x80, sizeof (vp_u));
+  fmt = "%vld";
+  sprintf (expected_output, fmt, vp_u.v);
+  vecpf_format (maxlen_buf, sizeof (maxlen_buf), &vp_u,
+                VECPF_SPEC (VECPF_MOD_VL, 'd'), 0, 0, -1);
+  compare (__LINE__, expected_output, maxlen_buf);
+
+  puts ("\nArray formatting tests.\n");
+  vecpf_format_array (actual_output, sizeof (actual_output), FLOAT_TEST_ARRAY,
+                      10, VECPF_SPEC (VECPF_MOD_V, 'f'), 0, 0, 1, "\n");
+  compare (__LINE__, "1.5 -2.2 3.0 4.1\n5.0 -6.5 7.0 8.8\n9.5 -10.0\n",
+           actual_output);
+  vecpf_format_array (actual_output, sizeof (actual_output), UINT32_TEST_ARRAY,
+                      6, VECPF_SPEC (VECPF_MOD_VL, 'u'), VECPF_FLAG_LEFT, 5,
+                      -1, "|");
+  compare (__LINE__, "1     22    333   4444 |55555 4294967295|",
+           actual_output);
+  vecpf_format_array (actual_output, sizeof (actual_output), CHAR_TEST_ARRAY,
+                      19, VECPF_SPEC (VECPF_MOD_V, 'c'), 0, 0, -1, "/");
+  compare (__LINE__, "Hello, vector wo/rld/", actual_output);
+  /* The libc fallback gets the same short tail.  */
+  vecpf_format_array (actual_output, sizeof (actual_output), FLOAT_TEST_ARRAY,
+                      5, VECPF_SPEC (VECPF_MOD_V, 'a'), 0, 0, -1, NULL);
+  compare (__LINE__, "0x1.8p+0 -0x1.2p+1 0x1.8p+1 0x1.08p+20x1.4p+2",
+           actual_output);
+
+  len = vecpf_format_array (actual_output, 10, UINT32_TEST_ARRAY, 6,
+                            VECPF_SPEC (VECPF_MOD_VL, 'u'), 0, 0, -1, "\n");
+  compare (__LINE__, "1 22 333 ", actual_output);
+  sprintf (expected_output, "%d", len);
+  compare (__LINE__, "31", expected_output);
+
+  fp = tmpfile ();
+  if (fp != NULL)
+    {
+      vecpf_fprint_array (fp, UINT32_TEST_ARRAY, 6,
+                          VECPF_SPEC (VECPF_MOD_VL, 'x'), 0, 0, -1, "\n");
+      fflush (fp);
+      vecpf_dprint_array (fileno (fp), UINT32_TEST_ARRAY, 3,
+                          VECPF_SPEC (VECPF_MOD_VL, 'u'), 0, 0, -1, "\n");
+      rewind (fp);
+      len = fread (actual_output, 1, sizeof (actual_output) - 1, fp);
+      actual_output[len] = '\0';
+      compare (__LINE__, "1 16 14d 115c\nd903 ffffffff\n1 22 333\n",
+               actual_output);
+      fclose (fp);
+    }
+
+  puts ("\nParallel array formatting tests.\n");
+  for (i = 0; i < MT_TEST_ARRAY_LEN; i++)
+    MT_TEST_ARRAY[i] = i * 0.731f - 1000.0f;
+  vecpf_format_array (mt_expected_output, sizeof (mt_expected_output),
+                      MT_TEST_ARRAY, MT_TEST_ARRAY_LEN,
+                      VECPF_SPEC (VECPF_MOD_V, 'g'), 0, 0, -1, "\n");
+  vecpf_format_array_mt (mt_actual_output, sizeof (mt_actual_output),
+                         MT_TEST_ARRAY, MT_TEST_ARRAY_LEN,
+                         VECPF_SPEC (VECPF_MOD_V, 'g'), 0, 0, -1, "\n", 3);
+  compare (__LINE__, mt_expected_output, mt_actual_output);
+  vecpf_format_array_mt (mt_actual_output, 100000, MT_TEST_ARRAY,
+                         MT_TEST_ARRAY_LEN, VECPF_SPEC (VECPF_MOD_V, 'g'), 0,
+                         0, -1, "\n", 3);
+  mt_expected_output[100000 - 1] = '\0';
+  compare (__LINE__, mt_expected_output, mt_actual_output);
+
+  puts ("\nHeap and arena string tests.\n");
+  fmt = "[%vd] [%+.3vf]";
+  sprintf (expected_output, fmt, UINT32_TEST_VECTOR, FLOAT_TEST_VECTOR);
+  len = vecpf_asprintf (&str, fmt, UINT32_TEST_VECTOR, FLOAT_TEST_VECTOR);
+  if (str != NULL)
+    {
+      compare (__LINE__, expected_output, str);
+      free (str);
+    }
+  sprintf (actual_output, "%d", len);
+  sprintf (expected_output, "%d", (int) strlen (expected_output));
+  compare (__LINE__, expected_output, actual_output);
+
+  /* Too long for vecpf_vasprintf's first try.  */
+  fmt = "%200vlu";
+  sprintf (expected_output, fmt, UINT32_TEST_VECTOR);
+  vecpf_asprintf (&str, fmt, UINT32_TEST_VECTOR);
+  if (str != NULL)
+    {
+      compare (__LINE__, expected_output, str);
+      free (str);
+    }
+
+  /* Strings stay put until the reset, and the memory is reused after.  */
+  fmt = "%vd";
+  str = vecpf_arena_printf (fmt, UINT32_TEST_VECTOR);
+  sprintf (expected_output, fmt, UINT32_TEST_VECTOR);
+  fmt = "%vlx";
+  str2 = vecpf_arena_printf (fmt, UINT32_TEST_VECTOR);
+  compare (__LINE__, expected_output, str);
+  sprintf (expected_output, fmt, UINT32_TEST_VECTOR);
+  compare (__LINE__, expected_output, str2);
+  vecpf_arena_stats (&stats);
+  len = strlen (str) + strlen (str2) + 2;
+  sprintf (actual_output, "%d", (int) stats.used);
+  sprintf (expected_output, "%d", len);
+  compare (__LINE__, expected_output, actual_output);
+  vecpf_arena_reset ();
+  fmt = "%vc";
+  str2 = vecpf_arena_printf (fmt, CHAR_TEST_VECTOR);
+  compare (__LINE__, "reused", str == str2 ? "reused" : "moved");
+  vecpf_arena_stats (&stats);
+  sprintf (actual_output, "%d %d", (int) stats.used, (int) stats.high_water);
+  sprintf (expected_output, "17 %d", len);
+  compare (__LINE__, expected_output, actual_output);
+  vecpf_arena_reset ();
+
+  /* A hugepage arena works whether or not there are hugetlb pages, and
+     its blocks are unmapped when it starts over.  */
+  vecpf_arena_config (0, VECPF_ARENA_HUGEPAGE);
+  fmt = "%vd";
+  str = vecpf_arena_printf (fmt, UINT32_TEST_VECTOR);
+  sprintf (expected_output, fmt, UINT32_TEST_VECTOR);
+  compare (__LINE__, expected_output, str != NULL ? str : "(null)");
+  vecpf_arena_reset ();
+  vecpf_arena_config (0, 0);
+  if (str != NULL)
+    {
+      void *page = (void *) ((uintptr_t) str
+                             & ~((uintptr_t) sysconf (_SC_PAGESIZE) - 1));
+
+      len = msync (page, 1, MS_ASYNC);
+      sprintf (actual_output, "%d %d", len, errno == ENOMEM);
+      compare (__LINE__, "-1 1", actual_output);
+    }
+  vecpf_arena_stats (&stats);
+  sprintf (actual_output, "%d", (int) stats.reserved);
+  compare (__LINE__, "0", actual_output);
+
+  puts ("\nParsing tests.\n");
+  /* Whatever a conversion prints reads back as the same vector.  */
+  for (dptr = direct_tests; dptr->format; dptr++)
+    {
+      if ((dptr->spec >> 8) == VECPF_MOD_VZ)
+        continue;
+      memcpy (&vec, dptr->vec, sizeof (vec));
+      sprintf (expected_output, dptr->format, vec);
+      memset (&vp_u, 0, sizeof (vp_u));
+      len = vecpf_parse (expected_output, dptr->spec, &vp_u);
+      sprintf (actual_output, dptr->format, vp_u.v);
+      compare (dptr->src_line, expected_output, actual_output);
+      /* Less any padding after the last lane.  */
+      for (i = strlen (expected_output); i > 0; i--)
+        if (expected_output[i - 1] != ' ')
+          break;
+      sprintf (actual_output, "%d", len);
+      sprintf (expected_output, "%d", i);
+      compare (dptr->src_line, expected_output, actual_output);
+    }
+
+  /* Every byte of a 'c' vector is a lane, spaces included, so "%vc"
+     reads back but a width's padding is read as lanes.  */
+  fmt = "%d %vc";
+  sprintf (expected_output, fmt + 3, CHAR_TEST_VECTOR);
+  len = vecpf_parse (expected_output, VECPF_SPEC (VECPF_MOD_V, 'c'), &vp_u);
+  sprintf (actual_output, fmt, len, vp_u.v);
+  compare (__LINE__, "16 this space is fo", actual_output);
+  vecpf_format (expected_output, sizeof (expected_output), &CHAR_TEST_VECTOR,
+                VECPF_SPEC (VECPF_MOD_V, 'c'), 0, 3, -1);
+  len = vecpf_parse (expected_output, VECPF_SPEC (VECPF_MOD_V, 'c'), &vp_u);
+  sprintf (actual_output, fmt, len, vp_u.v);
+  compare (__LINE__, "16   t  h  i  s    ", actual_output);
+
+  /* Padding, the '#' prefix, and the PIM separators.  */
+  vecpf_parse ("   0x2a,0X2A;  2a:0", VECPF_SPEC (VECPF_MOD_VL, 'x'), &vp_u);
+  sprintf (actual_output, "%u %u %u %u", vp_u.ui[0], vp_u.ui[1],
+           vp_u.ui[2], vp_u.ui[3]);
+  compare (__LINE__, "42 42 42 0", actual_output);
+
+  /* Nothing before or after the string is read, as a malloc'd one shows
+     under a memory checker.  */
+  str = malloc (sizeof ("1 2 3 4"));
+  if (str != NULL)
+    {
+      strcpy (str, "1 2 3 4");
+      len = vecpf_parse (str, VECPF_SPEC (VECPF_MOD_VL, 'd'), &vp_u);
+      sprintf (actual_output, "%d %d %d %d %d", len, vp_u.si[0], vp_u.si[1],
+               vp_u.si[2], vp_u.si[3]);
+      compare (__LINE__, "7 1 2 3 4", actual_output);
+      free (str);
+    }
+
+  len = vecpf_parse ("40000 1 2 3 4 5 6 7", VECPF_SPEC (VECPF_MOD_VH, 'd'),
+                     &vp_u);
+  sprintf (actual_output, "%d %d", len, errno == ERANGE);
+  compare (__LINE__, "-1 1", actual_output);
+  len = vecpf_parse ("1 2 3", VECPF_SPEC (VECPF_MOD_VL, 'u'), &vp_u);
+  sprintf (actual_output, "%d %d", len, errno == EINVAL);
+  compare (__LINE__, "-1 1", actual_output);
+
+  /* An array reads back across its separators, and stops where the
+     lanes do.  */
+  vecpf_format_array (expected_output, sizeof (expected_output),
+                      UINT32_TEST_ARRAY, 6, VECPF_SPEC (VECPF_MOD_VL, 'u'),
+                      0, 0, -1, "\n");
+  strcat (expected_output, "end");
+  len = vecpf_parse_array (expected_output, VECPF_SPEC (VECPF_MOD_VL, 'u'),
+                           parsed, 8, &end);
+  sprintf (actual_output, "%d %u %u \"%s\"", len, parsed[4], parsed[5],
+           end);
+  compare (__LINE__, "6 55555 4294967295 \"\nend\"", actual_output);
+
+  puts ("\nActivation tests.\n");
+  /* Loading the library was the first enable, so the hooks stay until a
+     second disable.  */
+  vec = (vector unsigned int) { 1, 2, 3, 4 };
+  fmt = "%vld";
+  vecpf_enable ();
+  vecpf_disable ();
+  sprintf (actual_output, fmt, vec);
+  compare (__LINE__, "1 2 3 4", actual_output);
+  len = vecpf_disable ();
+  sprintf (actual_output, "%d %d %x %5.2f %c", len, -7, 42, 3.25, 'v');
+  compare (__LINE__, "0 -7 2a  3.25 v", actual_output);
+  len = vecpf_disable ();
+  sprintf (actual_output, "%d %d", len, errno == EINVAL);
+  compare (__LINE__, "-1 1", actual_output);
+  vecpf_enable ();
+  sprintf (actual_output, fmt, vec);
+  compare (__LINE__, "1 2 3 4", actual_output);
+
+  puts ("\nEngine tests.\n");
+  for (dptr = direct_tests; dptr->format; dptr++)
+    {
+      memcpy (&vec, dptr->vec, sizeof (vec));
+      sprintf (expected_output, dptr->format, vec);
+      vecpf_snprintf (actual_output, sizeof (actual_output), dptr->format,
+                      vec);
+      compare (dptr->src_line, expected_output, actual_output);
+    }
+
+  /* Scalars, vectors and positional arguments side by side, the same with
+     the hooks and without them.  */
+  vec = (vector unsigned int) { 1, 2, 3, 4 };
+  fmt = "[%-6s|%+.3d|%#x|%vld|%5.1f|%c|%%|%p]";
+  sprintf (expected_output, fmt, "ab", 7, 255, vec, 2.25, 'z', NULL);
+  vecpf_disable ();
+  vecpf_snprintf (actual_output, sizeof (actual_output), fmt, "ab", 7, 255,
+                  vec, 2.25, 'z', NULL);
+  compare (__LINE__, expected_output, actual_output);
+  /* glibc keeps the sign flags for a pointer.  */
+  fmt = "[%+p|% p|%-+20p|%.6p]";
+  vecpf_snprintf (actual_output, sizeof (actual_output), fmt,
+                  (void *) 0x1234, (void *) 0x1234, (void *) 0x1234,
+                  (void *) 0x1234);
+  compare (__LINE__, "[+0x1234| 0x1234|+0x1234             |0x001234]",
+           actual_output);
+  sprintf (expected_output, fmt, (void *) 0x1234, (void *) 0x1234,
+           (void *) 0x1234, (void *) 0x1234);
+  compare (__LINE__, expected_output, actual_output);
+  fmt = "%2$vlx %1$s %2$#vlo %3$*4$d";
+  vecpf_snprintf (actual_output, sizeof (actual_output), fmt, "mid", vec,
+                  5, -3);
+  compare (__LINE__, "1 2 3 4 mid 01 02 03 04 5  ", actual_output);
+  vecpf_snprintf (actual_output, sizeof (actual_output), "%d%n %s", 123,
+                  &len, (char *) NULL);
+  sprintf (expected_output, "%d", len);
+  compare (__LINE__, "3", expected_output);
+  compare (__LINE__, "123 (null)", actual_output);
+  /* %m is the errno on entry, and "%#m" its name where libc prints that.  */
+  fmt = "[%m|%-12.3m|%#m|%d]";
+  errno = EPERM;
+  sprintf (expected_output, fmt, 1);
+  errno = EPERM;
+  vecpf_snprintf (actual_output, sizeof (actual_output), fmt, 1);
+  compare (__LINE__, expected_output, actual_output);
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35)
+  compare (__LINE__, "[Operation not permitted|Ope         |EPERM|1]",
+           actual_output);
+#endif
+
+  /* Truncated output still counts every byte.  */
+  fmt = "%vld %s";
+  len = vecpf_snprintf (actual_output, 6, fmt, vec, "end");
+  compare (__LINE__, "1 2 3", actual_output);
+  sprintf (expected_output, "%d", len);
+  compare (__LINE__, "11", expected_output);
+  len = vecpf_snprintf (NULL, 0, fmt, vec, "end");
+  sprintf (expected_output, "%d", len);
+  compare (__LINE__, "11", expected_output);
+
+  /* The format is read no further than its null byte, wherever in a
+     block of sixteen that falls.  */
+  for (i = 0; i < 34; i++)
+    {
+      str = malloc (i + 3);
+      if (str == NULL)
+        break;
+      memset (str, 'a', i);
+      strcpy (str + i, "%d");
+      sprintf (expected_output, str, i);
+      vecpf_snprintf (actual_output, sizeof (actual_output), str, i);
+      compare (__LINE__, expected_output, actual_output);
+      free (str);
+    }
+
+  fp = tmpfile ();
+  if (fp != NULL)
+    {
+      len = vecpf_fprintf (fp, "%s %vc\n", "stream", CHAR_TEST_VECTOR);
+      rewind (fp);
+      if (fgets (actual_output, sizeof (actual_output), fp) == NULL)
+        actual_output[0] = '\0';
+      compare (__LINE__, "stream this space is fo\n", actual_output);
+      sprintf (expected_output, "%d", len);
+      compare (__LINE__, "24", expected_output);
+      fclose (fp);
+    }
+
+  /* Heap and arena strings don't need the hooks either.  */
+  len = vecpf_asprintf (&str, "[v=%vld]", vec);
+  compare (__LINE__, "[v=1 2 3 4]", str != NULL ? str : "(null)");
+  sprintf (expected_output, "%d", len);
+  compare (__LINE__, "11", expected_output);
+  free (str);
+  str = vecpf_arena_printf ("[v=%vld]", vec);
+  compare (__LINE__, "[v=1 2 3 4]", str != NULL ? str : "(null)");
+  vecpf_arena_reset ();
+  vecpf_enable ();
+
+  puts ("\nPlan tests.\n");
+  for (dptr = direct_tests; dptr->format; dptr++)
+    {
+      memcpy (&vec, dptr->vec, sizeof (vec));
+      len = sprintf (expected_output, dptr->format, vec);
+      plan = vecpf_compile (dptr->format);
+      vecpf_sprint (plan, actual_output, sizeof (actual_output), vec);
+      compare (dptr->src_line, expected_output, actual_output);
+      /* The worst case covers this case.  */
+      compare (dptr->src_line, "fits",
+               vecpf_plan_maxlen (plan) > (size_t) len ? "fits" : "short");
+      vecpf_plan_free (plan);
+    }
+
+  /* Text around the conversions, "%%" and something that isn't a
+     conversion are all copied once, when the plan is made.  */
+  vec = (vector unsigned int) { 1, 2, 3, 4 };
+  fmt = "tick %u lanes=%vlx sum=%vf%%%y\n";
+  plan = vecpf_compile (fmt);
+  /* The sizeof counts the null byte, and an unsigned int 12 bytes.  */
+  sprintf (expected_output, "%d", (int) vecpf_plan_maxlen (plan));
+  sprintf (actual_output, "%d",
+           (int) (sizeof ("tick  lanes= sum=%%y\n") + 12
+                  + VECPF_FORMAT_MAXLEN (VECPF_MOD_VL, 'x', 0, -1) - 1
+                  + VECPF_FORMAT_MAXLEN (VECPF_MOD_V, 'f', 0, -1) - 1));
+  compare (__LINE__, actual_output, expected_output);
+  vecpf_sprint (plan, actual_output, sizeof (actual_output), 7U, vec,
+                (vector float) { 0.5, 1, 2, 4 });
+  compare (__LINE__,
+           "tick 7 lanes=1 2 3 4 sum=0.500000 1.000000 2.000000 4.000000%%y\n",
+           actual_output);
+  vecpf_plan_free (plan);
+
+  /* Positional arguments, and no bound for a string.  */
+  plan = vecpf_compile ("%2$s=%1$vld %2$s");
+  vecpf_sprint (plan, actual_output, sizeof (actual_output), vec, "v");
+  compare (__LINE__, "v=1 2 3 4 v", actual_output);
+  compare (__LINE__, "unbounded",
+           vecpf_plan_maxlen (plan) == SIZE_MAX ? "unbounded" : "bounded");
+  vecpf_plan_free (plan);
+  plan = vecpf_compile ("%1$d %d");
+  sprintf (actual_output, "%d", plan == NULL && errno == EINVAL);
+  compare (__LINE__, "1", actual_output);
+
+  fp = tmpfile ();
+  if (fp != NULL)
+    {
+      plan = vecpf_compile ("%s %vc\n");
+      len = vecpf_print (plan, fp, "plan", CHAR_TEST_VECTOR);
+      vecpf_plan_free (plan);
+      rewind (fp);
+      if (fgets (actual_output, sizeof (actual_output), fp) == NULL)
+        actual_output[0] = '\0';
+      compare (__LINE__, "plan this space is fo\n", actual_output);
+      sprintf (expected_output, "%d", len);
+      compare (__LINE__, "22", expected_output);
+      fclose (fp);
+    }
+
+  puts ("\nWide vector tests.\n");
+  memcpy (&wide_vec[0], &UINT32_TEST_VECTOR, 16);
+  memcpy (&wide_vec[1], &INT16_TEST_VECTOR, 16);
+  memcpy (&wide_vec[2], &FLOAT_TEST_VECTOR, 16);
+  memcpy (&wide_vec[3], &SIGNED_CHAR_TEST_VECTOR, 16);
+  test_wide (__LINE__, wide_vec);
+  memset (wide_vec, 0x80, sizeof (wide_vec));
+  test_wide (__LINE__, wide_vec);
+
+  len = vecpf_format (actual_output, sizeof (actual_output), wide_vec,
+                      VECPF_SPEC (VECPF_MOD_VL | VECPF_MOD_WIDTH_MASK, 'd'),
+                      0, 0, -1);
+  sprintf (actual_output, "%d %d", len, errno == EINVAL);
+  compare (__LINE__, "-1 1", actual_output);
+
+  /* The library's own printf takes them by value.  */
+  fmt = "%vl256d|%.1vv512f|%-3vl256x|";
+  vecpf_snprintf (actual_output, sizeof (actual_output), fmt,
+                  (v8si_t) { 1, -2, 3, -4, 5, -6, 7, -2147483647 - 1 },
+                  (v8df_t) { 0.25, 1, -2, 3.5, 4, 5, 6, 1e10 },
+                  (v8si_t) { 10, 11, 12, 13, 14, 15, 16, 17 });
+  compare (__LINE__, "1 -2 3 -4 5 -6 7 -2147483648|"
+           "0.2 1.0 -2.0 3.5 4.0 5.0 6.0 10000000000.0|"
+           "a   b   c   d   e   f   10  11 |", actual_output);
+  fmt = "%2$#vh512x %1$s";
+  vecpf_snprintf (actual_output, sizeof (actual_output), fmt, "end",
+                  (v8df_t) { 0 });
+  vecpf_format (expected_output, sizeof (expected_output), &(v8df_t) { 0 },
+                VECPF_SPEC (VECPF_MOD_VH | VECPF_MOD_512, 'x'),
+                VECPF_FLAG_ALT, 0, -1);
+  strcat (expected_output, " end");
+  compare (__LINE__, expected_output, actual_output);
+  vecpf_snprintf (actual_output, sizeof (actual_output), "%l256d|%d", 5);
+  compare (__LINE__, "%l256d|5", actual_output);
+
+  plan = vecpf_compile ("%vll256u");
+  vecpf_sprint (plan, actual_output, sizeof (actual_output),
+                (v4di_t) { -1, 2, 3, 4294967296LL });
+  compare (__LINE__, "18446744073709551615 2 3 4294967296", actual_output);
+  sprintf (expected_output, "%d", (int) vecpf_plan_maxlen (plan));
+  sprintf (actual_output, "%d",
+           (int) VECPF_FORMAT_MAXLEN (VECPF_MOD_VLL | VECPF_MOD_256, 'u', 0,
+                                      -1));
+  compare (__LINE__, actual_output, expected_output);
+  vecpf_plan_free (plan);
+
+  /* Arrays and parsing take a wide vector's worth of lanes at a time.  */
+  vecpf_format_array (actual_output, sizeof (actual_output),
+                      FLOAT_TEST_ARRAY, 10,
+                      VECPF_SPEC (VECPF_MOD_V | VECPF_MOD_256, 'g'), 0, 0, -1,
+                      "\n");
+  compare (__LINE__, "1.5 -2.25 3 4.125 5 -6.5 7 8.75\n9.5 -10\n",
+           actual_output);
+  len = vecpf_parse ("1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17",
+                     VECPF_SPEC (VECPF_MOD_VL | VECPF_MOD_512, 'u'),
+                     wide_parsed);
+  sprintf (actual_output, "%d %u %u", len, wide_parsed[0], wide_parsed[15]);
+  compare (__LINE__, "38 1 16", actual_output);
+  vecpf_format_array (mt_expected_output, sizeof (mt_expected_output),
+                      MT_TEST_ARRAY, MT_TEST_ARRAY_LEN,
+                      VECPF_SPEC (VECPF_MOD_V | VECPF_MOD_512, 'e'), 0, 0, -1,
+                      "\n");
+  vecpf_format_array_mt (mt_actual_output, sizeof (mt_actual_output),
+                         MT_TEST_ARRAY, MT_TEST_ARRAY_LEN,
+                         VECPF_SPEC (VECPF_MOD_V | VECPF_MOD_512, 'e'), 0, 0,
+                         -1, "\n", 4);
+  compare (__LINE__, "same",
+           strcmp (mt_expected_output, mt_actual_output) == 0
+           ? "same" : "different");
+
+  /* A 64 byte vector is rendered aside when what is left of the stream's
+     chunk or the caller's buffer might not hold it.  */
+  fp = tmpfile ();
+  if (fp != NULL)
+    {
+      vecpf_fprint_array (fp, MT_TEST_ARRAY, MT_TEST_ARRAY_LEN,
+                          VECPF_SPEC (VECPF_MOD_V | VECPF_MOD_512, 'e'), 0,
+                          0, -1, "\n");
+      rewind (fp);
+      len = fread (mt_actual_output, 1, sizeof (mt_actual_output) - 1, fp);
+      mt_actual_output[len] = '\0';
+      compare (__LINE__, "same",
+               strcmp (mt_expected_output, mt_actual_output) == 0
+               ? "same" : "different");
+      fclose (fp);
+    }
+  len = vecpf_format_array (mt_actual_output, 1000, MT_TEST_ARRAY,
+                            MT_TEST_ARRAY_LEN,
+                            VECPF_SPEC (VECPF_MOD_V | VECPF_MOD_512, 'e'), 0,
+                            0, -1, "\n");
+  sprintf (actual_output, "%d %d", len == (int) strlen (mt_expected_output),
+           strncmp (mt_expected_output, mt_actual_output, 999) == 0
+           && mt_actual_output[999] == '\0');
+  compare (__LINE__, "1 1", actual_output);
+
+#ifdef __SSE2__
+  puts ("\nSSE2 vector tests.\n");
+  /* The SSE types are generic vectors, and are passed as any other.  */
+  fmt = "%vld %vx";
+  sprintf (actual_output, fmt, _mm_set_epi32 (4, 3, -2, 1),
+           _mm_set1_epi8 (0x5a));
+  compare (__LINE__, "1 -2 3 4 5a 5a 5a 5a 5a 5a 5a 5a 5a 5a 5a 5a 5a 5a 5a 5a",
+           actual_output);
+  fmt = "%.1vf|%vvg|%vllx";
+  vecpf_snprintf (actual_output, sizeof (actual_output), fmt,
+                  _mm_set_ps (4, 3, 2, 1), _mm_set_pd (2.5, -1),
+                  _mm_set_epi64x (-1, 255));
+  compare (__LINE__, "1.0 2.0 3.0 4.0|-1 2.5|ff ffffffffffffffff",
+           actual_output);
+#endif
+
+  puts ("\nProcessor level tests.\n");
+  /* "make check-isa" runs the tests with VECPF_ISA set to every level that
+     was built.  The library must use that level if the processor runs it,
+     and the newest one the processor runs otherwise.  */
+  fmt = vecpf_isa ();
+  str = getenv ("VECPF_ISA");
+  printf ("Lane kernels: %s\n", fmt);
+#ifdef VECPF_HWCAPS
+  compare (__LINE__, VECPF_HWCAPS, fmt);
+#else
+  if (str != NULL && isa_runs (str) == 1)
+    compare (__LINE__, str, fmt);
+  else
+    {
+      static const char *const newest_first[] =
+        {
+          "x86-64-v4", "x86-64-v3", "power10", "power9", "power8", "baseline"
+        };
+
+      if (str != NULL)
+        printf ("VECPF_ISA=%s can't run here\n", str);
+      for (i = 0; isa_runs (newest_first[i]) != 1; i++)
+        ;
+      compare (__LINE__, newest_first[i], fmt);
+    }
 #endif
 
   if (failed) {
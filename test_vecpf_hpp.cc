@@ -0,0 +1,403 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+/* Tests of the C++ interfaces in vecpf.hpp.  What they print is checked
+   against vecpf_snprintf with the same format, or against a literal.  */
+
+#include "config.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* {fmt}'s formatters are there only if it comes first.  */
+#if __has_include (<fmt/format.h>)
+# define FMT_HEADER_ONLY 1
+# include <fmt/format.h>
+#endif
+
+#include "vecpf.hpp"
+
+/* altivec.h's "vector" macro would take std::vector.  */
+#ifdef vector
+# undef vector
+#endif
+
+static int failed;
+static int test_count;
+static int verbose;
+
+static void
+compare (int src_line, const char *expected, const char *actual)
+{
+  if (strcmp (expected, actual))
+    {
+      fprintf (stderr, "Error:   Expected: \"%s\", got \"%s\"  source: %s:%d\n",
+	       expected, actual, __FILE__, src_line);
+      failed++;
+    }
+  else if (verbose)
+    fprintf (stdout, "Success: Expected: \"%s\", got \"%s\"  source: %s:%d\n",
+	     expected, actual, __FILE__, src_line);
+
+  test_count++;
+}
+
+/* vecpf::format<F> of V against vecpf_snprintf, and the output within
+   the buffer's bound.  */
+template<vecpf::fixed_string F, typename V>
+  static void
+  compare_format (int src_line, const V &v)
+  {
+    auto actual = vecpf::format<F> (v);
+    char expected[1024];
+
+    vecpf_snprintf (expected, sizeof (expected), F.str, v);
+    compare (src_line, expected, actual.c_str ());
+    compare (src_line, "fits",
+	     actual.size () < actual.capacity ? "fits" : "overflows");
+  }
+
+#define COMPARE_INT_FORMATS(mod, v)					\
+  do									\
+    {									\
+      compare_format<"%" mod "d"> (__LINE__, v);			\
+      compare_format<"%" mod "u"> (__LINE__, v);			\
+      compare_format<"%" mod "o"> (__LINE__, v);			\
+      compare_format<"%" mod "x"> (__LINE__, v);			\
+      compare_format<"%+" mod "i"> (__LINE__, v);			\
+      compare_format<"% 05" mod "d"> (__LINE__, v);			\
+      compare_format<"%-9.4" mod "d"> (__LINE__, v);			\
+      compare_format<"%#.0" mod "o"> (__LINE__, v);			\
+      compare_format<"%#012" mod "x"> (__LINE__, v);			\
+      compare_format<"%-#7" mod "X"> (__LINE__, v);			\
+      compare_format<"%.0" mod "u"> (__LINE__, v);			\
+      compare_format<"%30" mod "d"> (__LINE__, v);			\
+    }									\
+  while (0)
+
+/* The formatters of whichever of std::format and {fmt} there are.  */
+#ifdef __cpp_lib_format
+# define COMPARE_STD_FORMAT(expected, f, v)				\
+  compare (__LINE__, expected, std::format (f, v).c_str ())
+#else
+# define COMPARE_STD_FORMAT(expected, f, v)  do { } while (0)
+#endif
+#ifdef FMT_VERSION
+# define COMPARE_FMT_FORMAT(expected, f, v)				\
+  compare (__LINE__, expected, fmt::format (f, v).c_str ())
+#else
+# define COMPARE_FMT_FORMAT(expected, f, v)  do { } while (0)
+#endif
+#define COMPARE_FORMATTER(expected, f, v)				\
+  do									\
+    {									\
+      COMPARE_STD_FORMAT (expected, f, v);				\
+      COMPARE_FMT_FORMAT (expected, f, v);				\
+    }									\
+  while (0)
+
+/* What the stream manipulators M, then V, put on an ostringstream.  */
+#define COMPARE_OSTREAM(expected, m, v)					\
+  do									\
+    {									\
+      std::ostringstream os;						\
+									\
+      os << m << v;							\
+      compare (__LINE__, expected, os.str ().c_str ());			\
+    }									\
+  while (0)
+
+int
+main (int argc, char *argv[])
+{
+  if (argc > 1 && strcmp (argv[1], "-v") == 0)
+    verbose = 1;
+
+  __vector signed char sc = { -128, -99, -1, 0, 1, 7, 8, 9,
+			      10, 42, 99, 100, 101, 126, 127, -7 };
+  __vector unsigned char uc = { 0, 1, 7, 8, 9, 10, 15, 16,
+				99, 100, 127, 128, 200, 254, 255, 0 };
+  __vector signed short ss = { -32768, -1000, -1, 0, 1, 999, 12345, 32767 };
+  __vector unsigned short us = { 0, 1, 8, 4096, 32768, 40000, 65534, 65535 };
+  __vector signed int si = { -2147483647 - 1, -1, 0, 2147483647 };
+  __vector unsigned int ui = { 0, 1, 305419896, 4294967295U };
+  __vector float f = { 1.5f, -2.25f, 3e10f, 0.1f };
+
+  puts ("\nCompile time format tests.\n");
+  COMPARE_INT_FORMATS ("v", sc);
+  COMPARE_INT_FORMATS ("v", uc);
+  COMPARE_INT_FORMATS ("vh", ss);
+  COMPARE_INT_FORMATS ("hv", us);
+  COMPARE_INT_FORMATS ("vl", si);
+  COMPARE_INT_FORMATS ("lv", ui);
+#ifdef VECPF_HAVE_VSX_TYPES
+  {
+    __vector signed long long sl = { -9223372036854775807LL - 1, 1234567 };
+    __vector unsigned long long ul = { 0, 18446744073709551615ULL };
+    __vector double d = { 1.0 / 3, -1e300 };
+
+    COMPARE_INT_FORMATS ("vll", sl);
+    COMPARE_INT_FORMATS ("llv", ul);
+    compare_format<"%vvf"> (__LINE__, d);
+    compare_format<"%-+20.10vvE"> (__LINE__, d);
+    compare_format<"%vvr"> (__LINE__, d);
+  }
+#endif
+#ifdef VECPF_HPP_INT128
+  {
+    __vector signed __int128 sq = { (__int128) -1 << 100 };
+    __vector unsigned __int128 uq = { ~(unsigned __int128) 0 / 3 };
+
+    COMPARE_INT_FORMATS ("vz", sq);
+    COMPARE_INT_FORMATS ("zv", uq);
+  }
+#endif
+  compare_format<"%vc"> (__LINE__, uc + 'a');
+  compare_format<"%-3vc|"> (__LINE__, uc + 'a');
+  compare_format<"%vf"> (__LINE__, f);
+  compare_format<"%12.3ve"> (__LINE__, f);
+  compare_format<"%#vg"> (__LINE__, f);
+  compare_format<"%va"> (__LINE__, f);
+  compare_format<"%vr"> (__LINE__, f);
+
+  /* Text, "%%" and more than one vector.  */
+  {
+    auto out = vecpf::format<"tick lanes=%#vlx sum=%.1vf 100%%\n"> (ui, f);
+    char expected[512];
+
+    vecpf_snprintf (expected, sizeof (expected),
+		    "tick lanes=%#vlx sum=%.1vf 100%%\n", ui, f);
+    compare (__LINE__, expected, out.c_str ());
+    compare (__LINE__, "0 0x1 0x12345678 0xffffffff",
+	     vecpf::format<"%#vlx"> (ui).c_str ());
+  }
+
+  /* vecpf::format_to leaves the end to the caller, and the bound is the
+     one vecpf.h gives.  */
+  {
+    char buf[vecpf::format_maxlen<"[%vhd]">];
+    char expected[16];
+    char *end = vecpf::format_to<"[%vhd]"> (buf, ss);
+
+    *end = '\0';
+    compare (__LINE__, "[-32768 -1000 -1 0 1 999 12345 32767]", buf);
+    sprintf (buf, "%d", (int) vecpf::format_maxlen<"[%vhd]">);
+    sprintf (expected, "%d",
+	     (int) (VECPF_FORMAT_MAXLEN (VECPF_MOD_VH, 'd', 0, -1) + 2));
+    compare (__LINE__, expected, buf);
+  }
+
+  puts ("\nFormatter tests.\n");
+  {
+    __vector signed int si2 = { -5, 0, 17, 2147483647 };
+    __vector float f2 = { 1.5f, -2.25f, __builtin_inff (), 0.1f };
+    __vector unsigned char abc = { 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h',
+				   'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p' };
+
+    COMPARE_FORMATTER ("-5 0 17 2147483647", "{}", si2);
+    COMPARE_FORMATTER ("0 1 305419896 4294967295", "{}", ui);
+    COMPARE_FORMATTER ("0xfffffffb, 0, 0x11, 0x7fffffff", "{:#x|, }", si2);
+    COMPARE_FORMATTER ("FFFFFFFB;0;11;7FFFFFFF", "{:X|;}", si2);
+    COMPARE_FORMATTER ("0 01 02215053170 037777777777", "{:#o}", ui);
+    COMPARE_FORMATTER ("***-5**** ****0**** ***17**** 2147483647", "{:*^9}",
+		       si2);
+    COMPARE_FORMATTER ("-5    0     17    2147483647", "{:<5}", si2);
+    COMPARE_FORMATTER ("-00005 +00000 +00017 +2147483647", "{:+06}", si2);
+    COMPARE_FORMATTER ("0xfffffffb 0000000000 0x00000011 0x7fffffff",
+		       "{:#010x}", si2);
+    COMPARE_FORMATTER ("-0005 0000 0017 2147483647", "{:.4}", si2);
+    COMPARE_FORMATTER ("-128 -99 -1 0 1 7 8 9 10 42 99 100 101 126 127 -7",
+		       "{}", sc);
+    COMPARE_FORMATTER ("abcdefghijklmnop", "{:c|}", abc);
+    COMPARE_FORMATTER ("a  |b  |c  |d  |e  |f  |g  |h  |i  |j  |k  |l  "
+		       "|m  |n  |o  |p  ", "{:3c||}", abc);
+    COMPARE_FORMATTER ("1.5 -2.25 inf 0.1", "{}", f2);
+    COMPARE_FORMATTER ("00001.50 -0002.25      inf 00000.10", "{:08.2f}",
+		       f2);
+    COMPARE_FORMATTER (" 1.5  -2.25   inf   0.1", "{: |  }", f2);
+    COMPARE_FORMATTER ("0x1.8p+0 -0x1.2p+1 inf 0x1.99999ap-4", "{:a}", f2);
+    COMPARE_FORMATTER ("1.5 -2.2 inf 0.1", "{:.2}", f2);
+#ifdef VECPF_HAVE_VSX_TYPES
+    {
+      __vector double d = { 1.0 / 3, -1e300 };
+      __vector unsigned long long ul = { 1, 18446744073709551615ULL };
+
+      COMPARE_FORMATTER ("  3.333e-01;-1.000e+300", "{:>11.3e|;}", d);
+      COMPARE_FORMATTER ("1 FFFFFFFFFFFFFFFF", "{:X}", ul);
+    }
+#endif
+#ifdef VECPF_HPP_INT128
+    {
+      __vector signed __int128 sq = { -1 };
+
+      COMPARE_FORMATTER ("-1-1", "{}", sq);
+    }
+#endif
+  }
+
+  puts ("\nInserter tests.\n");
+  {
+    __vector signed int si2 = { -5, 0, 17, 2147483647 };
+    __vector float f2 = { 1.5f, -2.25f, __builtin_inff (), 0.1f };
+
+    COMPARE_OSTREAM ("-5 0 17 2147483647", "", si2);
+    COMPARE_OSTREAM ("fffffffb 0 11 7fffffff", std::hex, si2);
+    COMPARE_OSTREAM ("0 0X1 0X12345678 0XFFFFFFFF",
+		     std::hex << std::showbase << std::uppercase, ui);
+    COMPARE_OSTREAM ("0 01 02215053170 037777777777",
+		     std::oct << std::showbase, ui);
+    COMPARE_OSTREAM ("-5 +0 +17 +2147483647", std::showpos, si2);
+    COMPARE_OSTREAM ("0 1 305419896 4294967295", std::showpos, ui);
+    COMPARE_OSTREAM ("    -5      0     17 2147483647", std::setw (6), si2);
+    COMPARE_OSTREAM ("-5**** 0***** 17**** 2147483647",
+		     std::left << std::setfill ('*') << std::setw (6), si2);
+    COMPARE_OSTREAM ("-**5 +**0 +*17 +2147483647",
+		     std::internal << std::showpos << std::setfill ('*')
+		     << std::setw (4), si2);
+    COMPARE_OSTREAM ("-128 -99 -1 0 1 7 8 9 10 42 99 100 101 126 127 -7",
+		     "", sc);
+    COMPARE_OSTREAM ("1.5 -2.25 inf 0.1", "", f2);
+    COMPARE_OSTREAM ("1.50 -2.25 inf 0.10",
+		     std::fixed << std::setprecision (2), f2);
+    COMPARE_OSTREAM ("+1.500E+00 -2.250E+00 +INF +1.000E-01",
+		     std::scientific << std::uppercase << std::showpos
+		     << std::setprecision (3), f2);
+    COMPARE_OSTREAM ("0x1.8p+0 -0x1.2p+1 inf 0x1.99999ap-4",
+		     std::hexfloat, f2);
+    COMPARE_OSTREAM ("1.50 -2.25 inf 0.100",
+		     std::showpoint << std::setprecision (3), f2);
+
+    /* The width is used up, and the sentry sees a bad stream.  */
+    {
+      std::ostringstream os;
+
+      os << std::setw (3) << si2 << '|' << 5;
+      compare (__LINE__, " -5   0  17 2147483647|5", os.str ().c_str ());
+      os.setstate (std::ios_base::failbit);
+      os << si2;
+      compare (__LINE__, " -5   0  17 2147483647|5", os.str ().c_str ());
+    }
+  }
+
+#ifdef __cpp_impl_coroutine
+  puts ("\nChunk tests.\n");
+  {
+    std::vector<__vector signed int> arr (1000);
+    std::string whole, joined;
+    const char *data = nullptr;
+    size_t nchunks = 0;
+    int same_buffer = 1, bounded = 1;
+
+    for (size_t i = 0; i < arr.size (); i++)
+      arr[i] = (__vector signed int) { (int) i, -(int) i * 7, 1 << (i % 31),
+				       (int) (i * 2654435761U) };
+    whole.resize (vecpf_format_array (NULL, 0, arr.data (), arr.size () * 4,
+				      VECPF_SPEC (VECPF_MOD_VL, 'x'), 0, 0,
+				      -1, ";\n"));
+    vecpf_format_array (&whole[0], whole.size () + 1, arr.data (),
+			arr.size () * 4, VECPF_SPEC (VECPF_MOD_VL, 'x'), 0,
+			0, -1, ";\n");
+
+    /* Chunks of 200 bytes hold 4 vectors of at most 38 bytes each.  */
+    for (std::string_view chunk
+	 : vecpf::format_chunks (std::span (arr), { 'x', 0, 0, -1, ";\n" },
+				 200))
+      {
+	if (data != nullptr && chunk.data () != data)
+	  same_buffer = 0;
+	if (chunk.size () > 200)
+	  bounded = 0;
+	data = chunk.data ();
+	joined += chunk;
+	nchunks++;
+      }
+    compare (__LINE__, whole.c_str (), joined.c_str ());
+    compare (__LINE__, "250 chunks", (std::to_string (nchunks)
+				      + " chunks").c_str ());
+    compare (__LINE__, "reused", same_buffer ? "reused" : "not reused");
+    compare (__LINE__, "bounded", bounded ? "bounded" : "too big");
+
+    /* A chunk is at least one vector, and the default is decimal with a
+       newline after each.  */
+    joined.clear ();
+    nchunks = 0;
+    for (std::string_view chunk
+	 : vecpf::format_chunks (std::span (arr).first (2), {}, 1))
+      {
+	joined += chunk;
+	nchunks++;
+      }
+    compare (__LINE__, "0 0 1 0\n1 -7 2 -1640531535\n", joined.c_str ());
+    compare (__LINE__, "2 chunks", (std::to_string (nchunks)
+				    + " chunks").c_str ());
+
+    nchunks = 0;
+    for (std::string_view chunk
+	 : vecpf::format_chunks (std::span (arr).first (0)))
+      nchunks += chunk.size () + 1;
+    compare (__LINE__, "0 chunks", (std::to_string (nchunks)
+				    + " chunks").c_str ());
+
+    /* Spans of a fixed extent, from an array of either kind.  */
+    {
+      const __vector signed int fixed[2] = { arr[0], arr[1] };
+      std::array<__vector signed int, 2> fixed2 = { arr[0], arr[1] };
+
+      joined.clear ();
+      for (std::string_view chunk : vecpf::format_chunks (std::span (fixed)))
+	joined += chunk;
+      for (std::string_view chunk
+	   : vecpf::format_chunks (std::span (fixed2), { 0, 0, 0, -1, " " }))
+	joined += chunk;
+      compare (__LINE__, "0 0 1 0\n1 -7 2 -1640531535\n"
+			 "0 0 1 0 1 -7 2 -1640531535 ", joined.c_str ());
+    }
+
+    /* 'e' takes no integer vector.  */
+    try
+      {
+	for (std::string_view chunk
+	     : vecpf::format_chunks (std::span (arr), { 'e' }))
+	  joined += chunk;
+	compare (__LINE__, "EINVAL", "no error");
+      }
+    catch (const std::system_error &e)
+      {
+	compare (__LINE__, "EINVAL",
+		 e.code () == std::errc::invalid_argument ? "EINVAL" : "?");
+      }
+  }
+#endif
+
+  if (failed)
+    {
+      fprintf (stderr, "\nWarning: %d tests failed!\n", failed);
+      return 1;
+    }
+
+  printf ("\nAll tests passed (%d tests).\n", test_count);
+  return 0;
+}
@@ -24,15 +24,41 @@
 
 #define _GNU_SOURCE
 
+#include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <printf.h>
-
-#include <altivec.h>
+#include <wchar.h>
+#include <langinfo.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
 #include "config.h"
+
+#ifdef HAVE_REGISTER_PRINTF_TYPE
+# include <printf.h>
+#else
+/* A libc without glibc's printf hooks leaves nothing to register, but the
+   plans' libc paths still take their conversion as a printf_info: these
+   are the members of glibc's they use.  */
+struct printf_info
+{
+  int prec;
+  int width;
+  wchar_t spec;
+  unsigned int alt:1;
+  unsigned int space:1;
+  unsigned int left:1;
+  unsigned int showsign:1;
+  unsigned int group:1;
+  wchar_t pad;
+};
+#endif
 #include "vecpf.h"
+#include "vecpf_priv.h"
 
 /* libvecpf
 
@@ -105,6 +131,7 @@
 
 #define FMT_STR_MAXLEN  64
 
+#ifdef HAVE_REGISTER_PRINTF_TYPE
 /* A handle for the vector data type.  Filled in by register_printf_type
    when the library first initializes. */
 
@@ -136,6 +163,7 @@ static vector_modifier_t vector_mods[] =
 };
 static const int vector_mods_len = sizeof (vector_mods) /
 				   sizeof (vector_mods[0]);
+#endif
 
 /* Master tables of valid specifiers and modifiers and how to handle them.
    We have one table for integer conversions and one table for floating
@@ -239,6 +267,7 @@ static const int int_types_table_len = sizeof (int_types_table) /
 static const vector_types_rec_t fp_types_table[] =
 {
   {L'f', 4, "f", 4, VDT_float},
+  {L'F', 4, "F", 4, VDT_float},
   {L'e', 4, "e", 4, VDT_float},
   {L'E', 4, "E", 4, VDT_float},
   {L'g', 4, "g", 4, VDT_float},
@@ -247,21 +276,214 @@ static const vector_types_rec_t fp_types_table[] =
   {L'A', 4, "A", 4, VDT_float},
 
   {L'f', 5, "f", 8, VDT_double},
+  {L'F', 5, "F", 8, VDT_double},
   {L'e', 5, "e", 8, VDT_double},
   {L'E', 5, "E", 8, VDT_double},
   {L'g', 5, "g", 8, VDT_double},
   {L'G', 5, "G", 8, VDT_double},
   {L'a', 5, "a", 8, VDT_double},
   {L'A', 5, "A", 8, VDT_double},
+
+  /* Shortest round trip.  Not a libc conversion, so mod_and_spec is never
+     used.  */
+  {L'r', 4, "r", 4, VDT_float},
+  {L'r', 5, "r", 8, VDT_double},
 };
 static const int fp_types_table_len = sizeof (fp_types_table) /
 				      sizeof (fp_types_table[0]);
 
+/* Output of the libc fallbacks, accumulated so that it reaches the stream
+   in one write like the kernels' does, or can be copied out to a caller's
+   buffer.  It starts out on the stack and moves to the heap if a lane is
+   too wide for that.  */
+typedef struct
+{
+  char *buf;
+  size_t len;
+  size_t cap;
+  int failed;
+  char stack[VEC_OUT_LEN (LIBVECTOR_VECTOR_WIDTH_BYTES)];
+} vec_strbuf_t;
+
+static void
+vec_sb_init (vec_strbuf_t *sb)
+{
+  sb->buf = sb->stack;
+  sb->len = 0;
+  sb->cap = sizeof (sb->stack);
+  sb->failed = 0;
+}
+
+/* Make room for NEED more bytes plus a null.  */
+static int
+vec_sb_reserve (vec_strbuf_t *sb, size_t need)
+{
+  size_t cap = sb->cap;
+  char *buf;
+
+  if (sb->len + need < sb->cap)
+    return 0;
+
+  while (sb->len + need >= cap)
+    cap *= 2;
+  if (sb->buf == sb->stack)
+    {
+      buf = malloc (cap);
+      if (buf != NULL)
+	memcpy (buf, sb->buf, sb->len);
+    }
+  else
+    buf = realloc (sb->buf, cap);
+  if (buf == NULL)
+    {
+      sb->failed = 1;
+      return -1;
+    }
+  sb->buf = buf;
+  sb->cap = cap;
+  return 0;
+}
+
+static void
+vec_sb_putc (vec_strbuf_t *sb, char c)
+{
+  if (vec_sb_reserve (sb, 1) == 0)
+    sb->buf[sb->len++] = c;
+}
+
+static void
+vec_sb_printf (vec_strbuf_t *sb, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  if (sb->failed)
+    return;
+
+  va_start (ap, fmt);
+  n = vsnprintf (sb->buf + sb->len, sb->cap - sb->len, fmt, ap);
+  va_end (ap);
+
+  if (n >= 0 && (size_t) n >= sb->cap - sb->len)
+    {
+      if (vec_sb_reserve (sb, n) != 0)
+	return;
+      va_start (ap, fmt);
+      n = vsnprintf (sb->buf + sb->len, sb->cap - sb->len, fmt, ap);
+      va_end (ap);
+    }
+
+  if (n < 0)
+    sb->failed = 1;
+  else
+    sb->len += n;
+}
+
+static void
+vec_sb_free (vec_strbuf_t *sb)
+{
+  if (sb->buf != sb->stack)
+    free (sb->buf);
+}
+
+#ifdef HAVE_REGISTER_PRINTF_TYPE
+/* Write out and release SB.  Returns the number of bytes written, or -1
+   on failure.  */
+static int
+vec_sb_write (vec_strbuf_t *sb, FILE *fp)
+{
+  int ret = -1;
+
+  if (!sb->failed
+      && fwrite_unlocked (sb->buf, 1, sb->len, fp) == sb->len)
+    ret = sb->len;
+  vec_sb_free (sb);
+  return ret;
+}
+#endif
+
+/* Dispatch plans.
+
+   Which rec, kernel and fallback handle a conversion depends only on the
+   conversion character and on which of our modifiers glibc matched, so it
+   is worked out once in __libvecpf_init and stored in a table indexed by
+   both, and by the width of the vector for the direct interfaces.  Each
+   registered modifier owns a single bit of printf_info.user; vec_mod_slot
+   maps that bit back to the modifier's index in vector_mods and
+   vec_spec_slot maps a conversion character to a row.  */
+
+#define VEC_MODS_MAX    10
+#define VEC_SPEC_CHARS  "diouxXcfFeEgGaAr"
+#define VEC_SPECS_LEN   (sizeof (VEC_SPEC_CHARS) - 1)
+
+/* Vectors of 16, 32 and 64 bytes, indexed by the VECPF_MOD_WIDTH_MASK
+   bits of a modifier.  The printf hooks only ever use the first.  */
+#define VEC_WIDTHS      3
+
+typedef struct vec_plan vec_plan_t;
+
+/* Render the first NLANES lanes of the vector into OUT, which must hold at
+   least VEC_OUT_LEN (PLAN->bytes) bytes.  Returns the number of bytes
+   written.  */
+typedef int (*vec_render_fn) (char *out, const vec_wide_t *vp_u, int nlanes,
+			      const vec_plan_t *plan,
+			      const vecpf_conv_t *conv);
+
+/* The number of bytes the plan's render function would write for the
+   same arguments.  */
+typedef int (*vec_length_fn) (const vec_wide_t *vp_u, int nlanes,
+			      const vec_plan_t *plan,
+			      const vecpf_conv_t *conv);
+
+/* Append the first NLANES lanes of the vector, printed one at a time
+   through libc, to SB.  */
+typedef void (*vec_libc_fn) (vec_strbuf_t *sb,
+			     const struct printf_info *info,
+			     const vec_wide_t *vp_u, int nlanes,
+			     const vector_types_rec_t *rec);
+
+struct vec_plan
+{
+  const vector_types_rec_t *rec;	/* NULL if not a valid combination.  */
+  vec_render_fn render;			/* NULL to always use LIBC.  */
+  vec_length_fn length;			/* NULL to render and count.  */
+  vec_libc_fn libc;
+  int lanes;				/* Lanes in a vector.  */
+  int bytes;				/* Size of a vector.  */
+  int check_fp_env;			/* Kernel needs the C radix and
+					   round to nearest.  */
+};
+
+static vec_plan_t vec_plans[VEC_WIDTHS][VEC_SPECS_LEN][VEC_MODS_MAX];
+static signed char vec_spec_slot[128];
+
+#ifdef HAVE_REGISTER_PRINTF_TYPE
+static signed char vec_mod_slot[16];
+
+/* All of the bits our modifiers were given, or'd together.  */
+static unsigned short vec_mods_mask;
+
+/* Rendered conversions are cached per thread, keyed by a word packing the
+   parts of the printf_info that they depend on.  A format string used in a
+   loop hits the same entry every time.  */
+
+#define VEC_PLAN_CACHE_SIZE  8
+
+typedef struct
+{
+  unsigned long long key;	/* 0 for an empty entry.  */
+  const vec_plan_t *plan;	/* NULL if the conversion isn't ours.  */
+  int use_kernel;
+  vecpf_conv_t conv;
+} vec_plan_cache_t;
+
+static __thread vec_plan_cache_t vec_plan_cache[VEC_PLAN_CACHE_SIZE];
+
 /* Variable argument handler registered with register_printf_type */
 static void
 vec_va (void *mem, va_list *ap)
 {
-  vector unsigned int v = va_arg (*ap, vector unsigned int);
+  __vector unsigned int v = va_arg (*ap, __vector unsigned int);
   memcpy (mem, &v, sizeof(v));
 }
 
@@ -269,20 +491,16 @@ vec_va (void *mem, va_list *ap)
 static int
 vec_ais (const struct printf_info *info, size_t n, int *argtype, int *size)
 {
-  int i;
-  for (i=0; i<vector_mods_len; ++i)
+  /* Only return '1' if we're supposed to be handling this data type.  */
+  if (info->user & vec_mods_mask)
     {
-      /* Only return '1' if we're supposed to be handling this data type.  */
-      if ((info->user & vector_mods[i].bits))
-  	{
-	  argtype[0] = printf_argtype_vec;
-	  size[0] = sizeof (vector unsigned int);
-	  return 1;
-	}
+      argtype[0] = printf_argtype_vec;
+      size[0] = sizeof (__vector unsigned int);
+      return 1;
     }
   return -1;
 }
-
+#endif
 
 static void
 gen_fmt_str (const struct printf_info *info, const char *sz_flags_and_conv,
@@ -314,95 +532,239 @@ gen_fmt_str (const struct printf_info *info, const char *sz_flags_and_conv,
            FMT_STR_MAXLEN - fmt_str_idx);
 }
 
+/* Fill in the kernel view of a conversion from the printf_info glibc hands
+   us.  Returns 0 if the in-library kernels can render it, or -1 if it has to
+   be handed back to libc one lane at a time: oversized fields and wide
+   streams.  Whether the locale groups digits is checked separately, since
+   that can change between calls.  */
+static void
+vec_conv_fill (const struct printf_info *info, vecpf_conv_t *conv)
+{
+  conv->alt = info->alt;
+  conv->space = info->space;
+  conv->left = info->left;
+  conv->showsign = info->showsign;
+  conv->group = info->group;
+  conv->zero = (info->pad == '0');
+  conv->width = info->width;
+  conv->prec = info->prec;
+  conv->spec = info->spec;
+}
+
+#ifdef HAVE_REGISTER_PRINTF_TYPE
 static int
-vec_printf_d (FILE *fp, const struct printf_info *info,
-              const void *const *args)
+vec_conv_from_info (const struct printf_info *info, vecpf_conv_t *conv)
 {
-  char fmt_str[FMT_STR_MAXLEN];
+  if (info->wide
+      || info->width > VEC_LANE_WIDTH_MAX
+      || info->prec > VEC_LANE_WIDTH_MAX)
+    return -1;
+
+  vec_conv_fill (info, conv);
+  return 0;
+}
+#endif
+
+static int
+vec_render_c (char *out, const vec_wide_t *vp_u, int nlanes,
+	      const vec_plan_t *plan, const vecpf_conv_t *conv)
+{
+  char *p = out;
   int i;
-  int limit;
 
-  vp_u_t vp_u;
+  /* Characters are the only conversion without a separator.  */
+  for (i = 0; i < nlanes; i++)
+    p += __vecpf_fmt_int (p, vp_u->uc[i], 0, conv);
+  return p - out;
+}
 
-  /* Find entry in table. */
-  int table_idx = -1;
-  int j;
+static int
+vec_render_radix (char *out, const vec_wide_t *vp_u, int nlanes,
+		  const vec_plan_t *plan, const vecpf_conv_t *conv)
+{
+  return __vecpf_render_radix (out, vp_u, plan->rec->element_size, nlanes,
+			       conv);
+}
+
+static int
+vec_render_dec (char *out, const vec_wide_t *vp_u, int nlanes,
+		const vec_plan_t *plan, const vecpf_conv_t *conv)
+{
+  return __vecpf_render_dec (out, vp_u, plan->rec->element_size, nlanes,
+			     conv);
+}
+
+static int
+vec_length_int (const vec_wide_t *vp_u, int nlanes, const vec_plan_t *plan,
+		const vecpf_conv_t *conv)
+{
+  return __vecpf_length_int (vp_u, plan->rec->element_size, nlanes, conv);
+}
+
+static int
+vec_render_float (char *out, const vec_wide_t *vp_u, int nlanes,
+		  const vec_plan_t *plan, const vecpf_conv_t *conv)
+{
+  char *p = out;
+  int i;
 
-  for (j=0; j<int_types_table_len; ++j)
+  for (i = 0; i < nlanes; i++)
     {
-      if ((info->spec == int_types_table[j].spec)
-           && (info->user & vector_mods[int_types_table[j].bits_index].bits))
-      {
-        table_idx = j;
-        break;
-      }
+      if (i > 0)
+	*p++ = ' ';
+      p += __vecpf_fmt_fp (p, vp_u->f[i], conv);
     }
+  return p - out;
+}
 
-  if (table_idx == -1)
-    return -2;
+static int
+vec_render_double (char *out, const vec_wide_t *vp_u, int nlanes,
+		   const vec_plan_t *plan, const vecpf_conv_t *conv)
+{
+  char *p = out;
+  int i;
 
-  gen_fmt_str (info, int_types_table[table_idx].mod_and_spec, fmt_str);
+  for (i = 0; i < nlanes; i++)
+    {
+      if (i > 0)
+	*p++ = ' ';
+      p += __vecpf_fmt_fp (p, vp_u->d[i], conv);
+    }
+  return p - out;
+}
 
-  limit = LIBVECTOR_VECTOR_WIDTH_BYTES /
-          int_types_table[table_idx].element_size;
+static int
+vec_render_shortest_float (char *out, const vec_wide_t *vp_u, int nlanes,
+			   const vec_plan_t *plan, const vecpf_conv_t *conv)
+{
+  char *p = out;
+  int i;
 
-  for (i=0; i < limit; i++)
+  for (i = 0; i < nlanes; i++)
+    {
+      if (i > 0)
+	*p++ = ' ';
+      p += __vecpf_fmt_shortest (p, vp_u->f[i], 1, conv);
+    }
+  return p - out;
+}
+
+static int
+vec_render_shortest_double (char *out, const vec_wide_t *vp_u, int nlanes,
+			    const vec_plan_t *plan, const vecpf_conv_t *conv)
+{
+  char *p = out;
+  int i;
+
+  for (i = 0; i < nlanes; i++)
     {
-      memcpy (&vp_u, *((void***)args)[0], sizeof( vp_u.v ));
+      if (i > 0)
+	*p++ = ' ';
+      p += __vecpf_fmt_shortest (p, vp_u->d[i], 0, conv);
+    }
+  return p - out;
+}
+
+/* libc has no shortest round trip conversion to fall back on, so fields
+   too wide for the stack buffer are rendered straight into SB once it has
+   grown to fit.  */
+static void
+vec_printf_r_wide (vec_strbuf_t *sb, const struct printf_info *info,
+		   const vec_wide_t *vp_u, int nlanes,
+		   const vector_types_rec_t *rec)
+{
+  vecpf_conv_t conv;
+
+  vec_conv_fill (info, &conv);
+
+  if (vec_sb_reserve (sb, nlanes * ((size_t) info->width
+			       + VEC_SHORTEST_LANE_MAXLEN + 1)) != 0)
+    return;
+
+  if (rec->data_type == VDT_double)
+    sb->len += vec_render_shortest_double (sb->buf + sb->len, vp_u, nlanes,
+					   NULL, &conv);
+  else
+    sb->len += vec_render_shortest_float (sb->buf + sb->len, vp_u, nlanes,
+					  NULL, &conv);
+}
+
+/* The original per-lane path: one nested snprintf per element.  Only used
+   for the conversions vec_conv_from_info turns down.  */
+static void
+vec_printf_d_libc (vec_strbuf_t *sb, const struct printf_info *info,
+		   const vec_wide_t *vec, int nlanes,
+		   const vector_types_rec_t *rec)
+{
+  char fmt_str[FMT_STR_MAXLEN];
+  int i;
+  int limit;
+
+  vec_wide_t vp_u = *vec;
+
+  gen_fmt_str (info, rec->mod_and_spec, fmt_str);
 
-      switch (int_types_table[table_idx].data_type)
+  limit = nlanes;
+
+  for (i=0; i < limit; i++)
+    {
+      switch (rec->data_type)
       {
 #ifdef HAVE_INT128_T
         case VDT_int128:
         {
-# ifdef __LITTLE_ENDIAN__
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.ull[1]);
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.ull[0]);
+# if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+          vec_sb_printf (sb, fmt_str, info->width, info->prec,
+                         vp_u.ull[2 * i + 1]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec,
+                         vp_u.ull[2 * i]);
 # else
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.ull[0]);
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.ull[1]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec,
+                         vp_u.ull[2 * i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec,
+                         vp_u.ull[2 * i + 1]);
 # endif
           break;
         }
 #endif
         case VDT_unsigned_long_long:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.ull[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.ull[i]);
           break;
         }
         case VDT_signed_long_long:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.sll[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.sll[i]);
           break;
         }
         case VDT_unsigned_int:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.ui[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.ui[i]);
           break;
         }
         case VDT_signed_int:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.si[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.si[i]);
           break;
         }
         case VDT_unsigned_short:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.uh[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.uh[i]);
           break;
         }
         case VDT_signed_short:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.sh[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.sh[i]);
           break;
         }
         case VDT_unsigned_char:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.uc[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.uc[i]);
           break;
         }
         case VDT_signed_char:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.sc[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.sc[i]);
           break;
         }
 
@@ -410,87 +772,987 @@ vec_printf_d (FILE *fp, const struct printf_info *info,
 
       if ((limit > 1 ) && (i < (limit-1)))
         {
-          if (!((int_types_table[table_idx].data_type == VDT_unsigned_char)
-             && (!strcmp(int_types_table[table_idx].mod_and_spec, "c"))))
+          if (!((rec->data_type == VDT_unsigned_char)
+             && (!strcmp(rec->mod_and_spec, "c"))))
           {
-            fputs (" ", fp);
+            vec_sb_putc (sb, ' ');
           }
         }
     } /* end for */
-
-  return 0;
 }
 
-static int
-vec_printf_f (FILE *fp, const struct printf_info *info,
-              const void *const *args)
+/* The original per-lane path: one nested snprintf per element.  Used for
+   'a' and 'A', and for whatever vec_conv_from_info or the rounding mode and
+   radix checks in vec_printf turn down.  */
+static void
+vec_printf_f_libc (vec_strbuf_t *sb, const struct printf_info *info,
+		   const vec_wide_t *vec, int nlanes,
+		   const vector_types_rec_t *rec)
 {
   char fmt_str[FMT_STR_MAXLEN];
   int i;
   int limit;
 
-  vp_u_t vp_u;
-
-  /* Find entry in table. */
-  int table_idx = -1;
-  int j;
-
-  for (j=0; j<fp_types_table_len; ++j)
-    {
-      if ((info->spec == fp_types_table[j].spec)
-           && (info->user & vector_mods[fp_types_table[j].bits_index].bits))
-      {
-        table_idx = j;
-        break;
-      }
-    }
-
-  if (table_idx == -1) {
-    return -2;
-  }
+  vec_wide_t vp_u = *vec;
 
-  gen_fmt_str (info, fp_types_table[table_idx].mod_and_spec, fmt_str);
+  gen_fmt_str (info, rec->mod_and_spec, fmt_str);
 
-  limit = LIBVECTOR_VECTOR_WIDTH_BYTES /
-          fp_types_table[table_idx].element_size;
+  limit = nlanes;
 
   for (i=0; i < limit; i++)
     {
-      memcpy (&vp_u, *((void***)args)[0], sizeof( vp_u.v ));
-
-      switch (fp_types_table[table_idx].data_type)
+      switch (rec->data_type)
       {
         case VDT_float:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.f[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.f[i]);
           break;
         }
         case VDT_double:
         {
-          fprintf (fp, fmt_str, info->width, info->prec, vp_u.d[i]);
+          vec_sb_printf (sb, fmt_str, info->width, info->prec, vp_u.d[i]);
           break;
         }
       } /* end switch */
 
       if ((limit > 1 ) && (i < (limit-1)))
         {
-	  /* This should never happen in the 'fp' path.  */
-          if (!((int_types_table[table_idx].data_type == VDT_unsigned_char)
-             && (!strcmp(int_types_table[table_idx].mod_and_spec, "c"))))
-          {
-            fputs (" ", fp);
-          }
+          vec_sb_putc (sb, ' ');
         }
     } /* end for */
+}
+
+#ifdef HAVE_REGISTER_PRINTF_TYPE
+/* Resolve INFO to its plan and kernel view through the per-thread cache.
+   Returns NULL if the conversion isn't one of ours.  *USE_KERNEL is set to
+   zero if the conversion has to go through the plan's libc path.  */
+static const vec_plan_t *
+vec_lookup (const struct printf_info *info, vecpf_conv_t *conv,
+	    int *use_kernel)
+{
+  vec_plan_cache_t *ent = NULL;
+  const vec_plan_t *plan;
+  unsigned long long key = 0;
+  unsigned int mods;
+
+  /* Everything but out of range widths and precisions fits in the key;
+     those always go to libc anyway, so they are simply not cached.  */
+  if (info->width >= 0 && info->width < 0xffff
+      && info->prec >= -1 && info->prec < 0xffff
+      && info->spec >= 0 && info->spec < 0x100)
+    {
+      key = (unsigned long long) info->spec
+	    | (unsigned long long) info->user << 8
+	    | (unsigned long long) info->alt << 24
+	    | (unsigned long long) info->space << 25
+	    | (unsigned long long) info->left << 26
+	    | (unsigned long long) info->showsign << 27
+	    | (unsigned long long) info->group << 28
+	    | (unsigned long long) info->wide << 29
+	    | (unsigned long long) (info->pad == '0') << 30
+	    | 1ULL << 31
+	    | (unsigned long long) (info->prec + 1) << 32
+	    | (unsigned long long) info->width << 48;
+      ent = &vec_plan_cache[(key * 0x9e3779b97f4a7c15ULL) >> 61];
+      if (ent->key == key)
+	{
+	  *conv = ent->conv;
+	  *use_kernel = ent->use_kernel;
+	  return ent->plan;
+	}
+    }
+
+  mods = info->user & vec_mods_mask;
+  if (mods == 0 || info->spec < 0 || info->spec >= 128
+      || vec_spec_slot[info->spec] < 0)
+    plan = NULL;
+  else
+    {
+      plan = &vec_plans[0][vec_spec_slot[info->spec]]
+			  [vec_mod_slot[__builtin_ctz (mods)]];
+      if (plan->rec == NULL)
+	plan = NULL;
+    }
+
+  *use_kernel = (plan != NULL && plan->render != NULL
+		 && vec_conv_from_info (info, conv) == 0);
+
+  if (ent != NULL)
+    {
+      ent->key = key;
+      ent->plan = plan;
+      ent->use_kernel = *use_kernel;
+      if (*use_kernel)
+	ent->conv = *conv;
+    }
+
+  return plan;
+}
+
+static int
+vec_printf (FILE *fp, const struct printf_info *info,
+	    const void *const *args)
+{
+  char out[VEC_OUT_LEN (LIBVECTOR_VECTOR_WIDTH_BYTES)];
+  vecpf_conv_t conv;
+  vec_wide_t vp_u;
+  const vec_plan_t *plan;
+  int use_kernel;
+  int len;
+
+  plan = vec_lookup (info, &conv, &use_kernel);
+  if (plan == NULL)
+    return -2;
+
+  /* The kernels only know the C locale's conventions: no thousands
+     grouping, '.' for the radix, and round to nearest.  */
+  if (use_kernel && conv.group)
+    {
+      const char *sep = nl_langinfo (THOUSEP);
+      if (sep != NULL && *sep != '\0')
+	use_kernel = 0;
+    }
+  if (use_kernel && plan->check_fp_env && !__vecpf_fp_env_is_c ())
+    use_kernel = 0;
+
+  memcpy (&vp_u, *((void***)args)[0], LIBVECTOR_VECTOR_WIDTH_BYTES);
+
+  if (!use_kernel)
+    {
+      vec_strbuf_t sb;
+
+      vec_sb_init (&sb);
+      plan->libc (&sb, info, &vp_u, plan->lanes, plan->rec);
+      return vec_sb_write (&sb, fp);
+    }
+
+  len = plan->render (out, &vp_u, plan->lanes, plan, &conv);
+
+  /* vfprintf holds the stream's lock for as long as it runs, handlers
+     included, so the write doesn't need to take it again.  */
+  if (fwrite_unlocked (out, 1, len, fp) != (size_t) len)
+    return -1;
+
+  return len;
+}
+#endif
+
+/* Copy the LEN bytes rendered at OUT into the SIZE bytes at BUF the way
+   snprintf would.  */
+static int
+vec_copy_out (char *buf, size_t size, const char *out, int len)
+{
+  if (size > 0)
+    {
+      size_t n = (size_t) len < size ? (size_t) len : size - 1;
+      memcpy (buf, out, n);
+      buf[n] = '\0';
+    }
+  return len;
+}
+
+/* A conversion of the direct formatting API, resolved once so that a whole
+   array can be run through it.  */
+typedef struct
+{
+  const vec_plan_t *plan;
+  vecpf_conv_t conv;
+  int use_kernel;
+  struct printf_info info;	/* For the plan's libc path.  */
+} vec_direct_t;
+
+/* The plan for the direct formatting conversion SPEC, or NULL if it
+   isn't one the printf hooks accept at some vector width.  */
+static const vec_plan_t *
+vec_spec_plan (int spec)
+{
+  int mod = spec >> 8;
+  int w = (mod & VECPF_MOD_WIDTH_MASK) >> 4;
+  int c = spec & 0xff;
+  const vec_plan_t *plan;
+
+  mod &= ~VECPF_MOD_WIDTH_MASK;
+  if (mod < 0 || mod >= VEC_MODS_MAX || w >= VEC_WIDTHS || c >= 128
+      || vec_spec_slot[c] < 0)
+    return NULL;
+  plan = &vec_plans[w][vec_spec_slot[c]][mod];
+  return plan->rec != NULL ? plan : NULL;
+}
+
+/* Resolve SPEC, FLAGS, WIDTH and PREC as vecpf.h describes them into D.
+   Returns -1 with errno set to EINVAL if they don't name a conversion the
+   printf hooks accept.  */
+static int
+vec_direct_setup (vec_direct_t *d, int spec, int flags, int width, int prec)
+{
+  int c = spec & 0xff;
+
+  d->plan = vec_spec_plan (spec);
+  if (d->plan == NULL || (flags & ~VECPF_FLAG_ALL) != 0 || width < 0)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  memset (&d->conv, 0, sizeof (d->conv));
+  d->conv.alt = (flags & VECPF_FLAG_ALT) != 0;
+  d->conv.zero = (flags & VECPF_FLAG_ZERO) != 0;
+  d->conv.left = (flags & VECPF_FLAG_LEFT) != 0;
+  d->conv.space = (flags & VECPF_FLAG_SPACE) != 0;
+  d->conv.showsign = (flags & VECPF_FLAG_PLUS) != 0;
+  d->conv.width = width;
+  d->conv.prec = prec < 0 ? -1 : prec;
+  d->conv.spec = c;
+
+  d->use_kernel = (d->plan->render != NULL
+		   && width <= VEC_LANE_WIDTH_MAX
+		   && prec <= VEC_LANE_WIDTH_MAX
+		   && (!d->plan->check_fp_env || __vecpf_fp_env_is_c ()));
+
+  /* The same fallback vec_printf uses, driven by a printf_info of our
+     own.  */
+  memset (&d->info, 0, sizeof (d->info));
+  d->info.prec = d->conv.prec;
+  d->info.width = width;
+  d->info.spec = c;
+  d->info.alt = d->conv.alt;
+  d->info.space = d->conv.space;
+  d->info.left = d->conv.left;
+  d->info.showsign = d->conv.showsign;
+  d->info.pad = d->conv.zero ? L'0' : L' ';
+
+  return 0;
+}
+
+int
+vecpf_format (char *buf, size_t size, const void *vec, int spec, int flags,
+	      int width, int prec)
+{
+  char stack[VEC_OUT_LEN (16)];
+  vec_direct_t d;
+  vec_strbuf_t sb;
+  vec_wide_t vp_u;
+  int len;
+
+  if (vec_direct_setup (&d, spec, flags, width, prec) != 0)
+    return -1;
+  memcpy (&vp_u, vec, d.plan->bytes);
+
+  if (d.use_kernel)
+    {
+      /* Straight into BUF if it has all the room the kernel may use, else
+	 into the stack and copied; only the wider vectors need more room
+	 than the stack has.  */
+      char *out = buf;
+
+      if (size < VEC_OUT_LEN (d.plan->bytes))
+	{
+	  out = stack;
+	  if (VEC_OUT_LEN (d.plan->bytes) > sizeof (stack)
+	      && (out = malloc (VEC_OUT_LEN (d.plan->bytes))) == NULL)
+	    return -1;
+	}
+      len = d.plan->render (out, &vp_u, d.plan->lanes, d.plan, &d.conv);
+      if (out == buf)
+	buf[len] = '\0';
+      else
+	{
+	  vec_copy_out (buf, size, out, len);
+	  if (out != stack)
+	    free (out);
+	}
+      return len;
+    }
 
+  vec_sb_init (&sb);
+  d.plan->libc (&sb, &d.info, &vp_u, d.plan->lanes, d.plan->rec);
+  len = sb.failed ? -1 : vec_copy_out (buf, size, sb.buf, sb.len);
+  vec_sb_free (&sb);
+  return len;
+}
+
+int
+vecpf_formatted_length (const void *vec, int spec, int flags, int width,
+			int prec)
+{
+  vec_direct_t d;
+  vec_wide_t vp_u;
+
+  if (vec_direct_setup (&d, spec, flags, width, prec) != 0)
+    return -1;
+  if (!d.use_kernel || d.plan->length == NULL)
+    return vecpf_format (NULL, 0, vec, spec, flags, width, prec);
+
+  memcpy (&vp_u, vec, d.plan->bytes);
+  return d.plan->length (&vp_u, d.plan->lanes, d.plan, &d.conv);
+}
+
+int attribute_hidden
+__vecpf_spec_type (int spec, int *element_size, int *lanes)
+{
+  const vec_plan_t *plan = vec_spec_plan (spec);
+
+  if (plan == NULL)
+    return -1;
+  *element_size = plan->rec->element_size;
+  *lanes = plan->lanes;
+  return plan->rec->data_type;
+}
+
+/* Array formatting.
+
+   The conversion is resolved once for the whole array and every vector is
+   rendered straight into its destination: the caller's buffer while there
+   is room for a whole vector left in it, otherwise a chunk that is handed
+   to the stream or file descriptor whenever it fills up.  */
+
+/* Bytes written to a stream or descriptor at a time.  A vector of up to
+   32 bytes is always rendered in the chunk; a wider one that doesn't fit
+   in what is left of it, or of the caller's buffer, is rendered into a
+   scratch buffer allocated the first time it is needed.  */
+#define VEC_ARRAY_CHUNK     (16 * 1024)
+
+/* How many vectors ahead of the one being formatted to prefetch.
+   Formatting a vector takes long enough that a few ahead hides the
+   latency.  */
+#define VEC_ARRAY_PREFETCH  8
+
+typedef struct
+{
+  char *buf;			/* vecpf_format_array's buffer.  */
+  size_t size;
+  FILE *fp;			/* vecpf_fprint_array's stream, or NULL.  */
+  int fd;			/* vecpf_dprint_array's descriptor, or -1.  */
+  size_t total;			/* Bytes of output so far.  */
+  size_t len;			/* Bytes waiting in CHUNK.  */
+  int grow;			/* BUF is malloc'd and grows as needed.  */
+  int failed;
+  char *scratch;		/* VEC_OUT_MAXLEN bytes, or NULL.  */
+  char chunk[VEC_ARRAY_CHUNK];
+} vec_sink_t;
+
+static void
+vec_sink_init (vec_sink_t *k, char *buf, size_t size, FILE *fp, int fd)
+{
+  k->buf = buf;
+  k->size = size;
+  k->fp = fp;
+  k->fd = fd;
+  k->total = 0;
+  k->len = 0;
+  k->grow = 0;
+  k->failed = 0;
+  k->scratch = NULL;
+}
+
+/* Whether K stores into the caller's buffer rather than writing out.  */
+static int
+vec_sink_is_buf (const vec_sink_t *k)
+{
+  return k->fp == NULL && k->fd < 0;
+}
+
+static int
+vec_write_fd (int fd, const char *p, size_t n)
+{
+  while (n > 0)
+    {
+      ssize_t w = write (fd, p, n);
+      if (w < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+      p += w;
+      n -= w;
+    }
   return 0;
 }
 
+/* Write N bytes at P to the sink's stream or descriptor.  */
+static void
+vec_sink_write (vec_sink_t *k, const char *p, size_t n)
+{
+  int ret;
+
+  if (k->failed || n == 0)
+    return;
+  if (k->fp != NULL)
+    ret = fwrite_unlocked (p, 1, n, k->fp) == n ? 0 : -1;
+  else
+    ret = vec_write_fd (k->fd, p, n);
+  if (ret != 0)
+    k->failed = 1;
+}
+
+static void
+vec_sink_flush (vec_sink_t *k)
+{
+  vec_sink_write (k, k->chunk, k->len);
+  k->len = 0;
+}
+
+/* Make room in a growing sink's buffer for N more bytes and a null.  */
+static void
+vec_sink_grow (vec_sink_t *k, size_t n)
+{
+  size_t size = k->size > 0 ? k->size : VEC_ARRAY_CHUNK;
+  char *buf;
+
+  if (!k->grow || k->failed || k->total + n < k->size)
+    return;
+  while (k->total + n >= size)
+    size *= 2;
+  buf = realloc (k->buf, size);
+  if (buf == NULL)
+    {
+      k->failed = 1;
+      return;
+    }
+  k->buf = buf;
+  k->size = size;
+}
+
+static void
+vec_sink_put (vec_sink_t *k, const char *p, size_t n)
+{
+  if (vec_sink_is_buf (k))
+    {
+      vec_sink_grow (k, n);
+      if (k->total < k->size)
+	{
+	  size_t room = k->size - 1 - k->total;
+	  memcpy (k->buf + k->total, p, n < room ? n : room);
+	}
+    }
+  else if (k->len + n <= sizeof (k->chunk))
+    {
+      memcpy (k->chunk + k->len, p, n);
+      k->len += n;
+    }
+  else
+    {
+      vec_sink_flush (k);
+      if (n < sizeof (k->chunk))
+	{
+	  memcpy (k->chunk, p, n);
+	  k->len = n;
+	}
+      else
+	vec_sink_write (k, p, n);
+    }
+  k->total += n;
+}
+
+/* Where to render the next vector: N bytes, at most VEC_OUT_MAXLEN, that
+   are either the output's final place or somewhere to copy them from:
+   the chunk, which a buffer sink doesn't otherwise use, or the scratch
+   buffer.  Returns NULL if there is no memory for that.  */
+static char *
+vec_sink_begin (vec_sink_t *k, size_t n)
+{
+  if (vec_sink_is_buf (k))
+    {
+      vec_sink_grow (k, n);
+      if (k->total < k->size && k->size - k->total > n)
+	return k->buf + k->total;
+      if (n <= sizeof (k->chunk))
+	return k->chunk;
+    }
+  else
+    {
+      if (sizeof (k->chunk) - k->len < n)
+	vec_sink_flush (k);
+      if (sizeof (k->chunk) - k->len >= n)
+	return k->chunk + k->len;
+    }
+
+  if (k->scratch == NULL && (k->scratch = malloc (VEC_OUT_MAXLEN)) == NULL)
+    k->failed = 1;
+  return k->scratch;
+}
+
+static void
+vec_sink_end (vec_sink_t *k, const char *p, size_t n)
+{
+  if (p == k->scratch || (vec_sink_is_buf (k) && p == k->chunk))
+    vec_sink_put (k, p, n);
+  else
+    {
+      if (!vec_sink_is_buf (k))
+	k->len += n;
+      k->total += n;
+    }
+}
+
+/* Format the NELEM lanes at SRC as D says into K, SEPLEN bytes of SEP
+   after every vector.  */
+static void
+vec_array_emit (vec_sink_t *k, const vec_direct_t *d, const void *base,
+		size_t nelem, const char *sep, size_t seplen)
+{
+  const unsigned char *src = base;
+  size_t esize = d->plan->rec->element_size;
+  size_t bytes = d->plan->bytes;
+  size_t nvec = (nelem + d->plan->lanes - 1) / d->plan->lanes;
+  size_t i;
+  vec_wide_t vp_u;
+
+  for (i = 0; i < nvec && !k->failed; i++)
+    {
+      int nlanes = d->plan->lanes;
+
+      /* Never read past the last lane of a short tail.  */
+      if (i == nvec - 1 && nelem % d->plan->lanes != 0)
+	{
+	  nlanes = nelem % d->plan->lanes;
+	  memset (&vp_u, 0, bytes);
+	  memcpy (&vp_u, src, nlanes * esize);
+	}
+      else
+	{
+	  __builtin_prefetch (src + VEC_ARRAY_PREFETCH * bytes);
+	  memcpy (&vp_u, src, bytes);
+	}
+      src += bytes;
+
+      if (d->use_kernel)
+	{
+	  char *p = vec_sink_begin (k, VEC_OUT_LEN (bytes));
+
+	  if (p == NULL)
+	    break;
+	  vec_sink_end (k, p, d->plan->render (p, &vp_u, nlanes, d->plan,
+					       &d->conv));
+	}
+      else
+	{
+	  vec_strbuf_t sb;
+
+	  vec_sb_init (&sb);
+	  d->plan->libc (&sb, &d->info, &vp_u, nlanes, d->plan->rec);
+	  if (sb.failed)
+	    k->failed = 1;
+	  else
+	    vec_sink_put (k, sb.buf, sb.len);
+	  vec_sb_free (&sb);
+	}
+
+      if (seplen > 0)
+	vec_sink_put (k, sep, seplen);
+    }
+}
+
+static ssize_t
+vec_array_run (vec_sink_t *k, const void *base, size_t nelem, int spec,
+	       int flags, int width, int prec, const char *sep)
+{
+  vec_direct_t d;
+
+  if (vec_direct_setup (&d, spec, flags, width, prec) != 0)
+    return -1;
+
+  vec_array_emit (k, &d, base, nelem, sep, sep != NULL ? strlen (sep) : 0);
+  free (k->scratch);
+
+  if (!vec_sink_is_buf (k))
+    vec_sink_flush (k);
+
+  return k->failed ? -1 : (ssize_t) k->total;
+}
+
+ssize_t
+vecpf_format_array (char *buf, size_t size, const void *base, size_t nelem,
+		    int spec, int flags, int width, int prec, const char *sep)
+{
+  vec_sink_t k;
+  ssize_t ret;
+
+  vec_sink_init (&k, buf, size, NULL, -1);
+  ret = vec_array_run (&k, base, nelem, spec, flags, width, prec, sep);
+  if (size > 0)
+    buf[k.total < size ? k.total : size - 1] = '\0';
+  return ret;
+}
+
+ssize_t
+vecpf_fprint_array (FILE *fp, const void *base, size_t nelem, int spec,
+		    int flags, int width, int prec, const char *sep)
+{
+  vec_sink_t k;
+  ssize_t ret;
+
+  vec_sink_init (&k, NULL, 0, fp, -1);
+  flockfile (fp);
+  ret = vec_array_run (&k, base, nelem, spec, flags, width, prec, sep);
+  funlockfile (fp);
+  return ret;
+}
+
+ssize_t
+vecpf_dprint_array (int fd, const void *base, size_t nelem, int spec,
+		    int flags, int width, int prec, const char *sep)
+{
+  vec_sink_t k;
+
+  vec_sink_init (&k, NULL, 0, NULL, fd);
+  return vec_array_run (&k, base, nelem, spec, flags, width, prec, sep);
+}
+
+/* Parallel array formatting.
+
+   The array is cut into tasks of VEC_MT_CHUNK_VECS vectors, 32 KiB of
+   input, whose output fits in L2 alongside it for every conversion but
+   the widest fields.  The tasks are formatted by the worker pool into
+   buffers of their own, a batch of a few per thread at a time so the
+   output of a huge array is never all in memory at once.  Each batch is
+   then written out in order with writev, or fwrite for a stream, straight
+   from those buffers, or copied into its place in the caller's buffer
+   once the lengths before it are known.  */
+
+#define VEC_MT_CHUNK_VECS  2048
+#define VEC_MT_BATCH       4	/* Tasks per thread in a batch.  */
+
+typedef struct
+{
+  char *buf;
+  size_t len;
+  int failed;
+} vec_mt_piece_t;
+
+typedef struct
+{
+  const vec_direct_t *d;
+  const unsigned char *base;
+  size_t nelem;
+  const char *sep;
+  size_t seplen;
+  size_t first;			/* First task of the batch.  */
+  vec_mt_piece_t *pieces;	/* One per task of the batch.  */
+  char *buf;			/* Where the copy pass puts the batch.  */
+  size_t size;
+  size_t offset;		/* Output before the batch.  */
+} vec_mt_job_t;
+
+static void
+vec_mt_render (void *arg, size_t task)
+{
+  vec_mt_job_t *job = arg;
+  vec_mt_piece_t *piece = &job->pieces[task];
+  size_t per_task = (size_t) VEC_MT_CHUNK_VECS * job->d->plan->lanes;
+  size_t start = (job->first + task) * per_task;
+  size_t n = job->nelem - start < per_task ? job->nelem - start : per_task;
+  vec_sink_t k;
+
+  vec_sink_init (&k, NULL, 0, NULL, -1);
+  k.grow = 1;
+  vec_array_emit (&k, job->d,
+		  job->base + (start / job->d->plan->lanes)
+			      * job->d->plan->bytes,
+		  n, job->sep, job->seplen);
+  free (k.scratch);
+
+  piece->buf = k.buf;
+  piece->len = k.total;
+  piece->failed = k.failed;
+}
+
+/* Copy a piece to its offset in the caller's buffer, leaving room for
+   the null.  The offsets are in the LEN fields, turned into running
+   totals by the caller.  */
+static void
+vec_mt_copy (void *arg, size_t task)
+{
+  vec_mt_job_t *job = arg;
+  vec_mt_piece_t *piece = &job->pieces[task];
+  size_t off = job->offset + (task > 0 ? job->pieces[task - 1].len : 0);
+  size_t n = piece->len - (task > 0 ? job->pieces[task - 1].len : 0);
+
+  if (off + 1 < job->size)
+    memcpy (job->buf + off, piece->buf,
+	    n < job->size - 1 - off ? n : job->size - 1 - off);
+}
+
 static int
-__register_printf_vec( void )
+vec_writev_fd (int fd, struct iovec *iov, int cnt)
+{
+  while (cnt > 0)
+    {
+      ssize_t w = writev (fd, iov, cnt < IOV_MAX ? cnt : IOV_MAX);
+      if (w < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+      while (cnt > 0 && (size_t) w >= iov->iov_len)
+	{
+	  w -= iov->iov_len;
+	  iov++;
+	  cnt--;
+	}
+      if (cnt > 0)
+	{
+	  iov->iov_base = (char *) iov->iov_base + w;
+	  iov->iov_len -= w;
+	}
+    }
+  return 0;
+}
+
+/* Format the array into BUF, FP or FD, whichever isn't NULL or -1.  */
+static ssize_t
+vec_array_mt (char *buf, size_t size, FILE *fp, int fd, const void *base,
+	      size_t nelem, int spec, int flags, int width, int prec,
+	      const char *sep, int nthreads)
+{
+  vec_mt_job_t job;
+  vec_direct_t d;
+  size_t ntasks, batch, total = 0;
+  int failed = 0;
+
+  if (vec_direct_setup (&d, spec, flags, width, prec) != 0)
+    return -1;
+
+  nthreads = __vecpf_pool_threads (nthreads);
+  ntasks = (nelem + (size_t) VEC_MT_CHUNK_VECS * d.plan->lanes - 1)
+	   / ((size_t) VEC_MT_CHUNK_VECS * d.plan->lanes);
+  batch = (size_t) nthreads * VEC_MT_BATCH;
+
+  job.d = &d;
+  job.base = base;
+  job.nelem = nelem;
+  job.sep = sep;
+  job.seplen = sep != NULL ? strlen (sep) : 0;
+  job.buf = buf;
+  job.size = size;
+  job.pieces = malloc ((ntasks < batch ? ntasks : batch)
+		       * (sizeof (vec_mt_piece_t) + sizeof (struct iovec)));
+  if (job.pieces == NULL && ntasks > 0)
+    return -1;
+
+  for (job.first = 0; job.first < ntasks && !failed; job.first += batch)
+    {
+      size_t n = ntasks - job.first < batch ? ntasks - job.first : batch;
+      struct iovec *iov = (struct iovec *) (job.pieces + n);
+      size_t len = 0;
+      size_t i;
+
+      __vecpf_pool_run (nthreads, vec_mt_render, &job, n);
+
+      for (i = 0; i < n; i++)
+	{
+	  failed |= job.pieces[i].failed;
+	  iov[i].iov_base = job.pieces[i].buf;
+	  iov[i].iov_len = job.pieces[i].len;
+	  len += job.pieces[i].len;
+	}
+
+      if (fp != NULL)
+	{
+	  for (i = 0; i < n && !failed; i++)
+	    failed = (fwrite_unlocked (iov[i].iov_base, 1, iov[i].iov_len, fp)
+		      != iov[i].iov_len);
+	}
+      else if (fd >= 0)
+	failed = failed || vec_writev_fd (fd, iov, n) != 0;
+      else if (!failed && total + 1 < size)
+	{
+	  for (i = 1; i < n; i++)
+	    job.pieces[i].len += job.pieces[i - 1].len;
+	  job.offset = total;
+	  __vecpf_pool_run (nthreads, vec_mt_copy, &job, n);
+	}
+
+      for (i = 0; i < n; i++)
+	free (job.pieces[i].buf);
+      total += len;
+    }
+
+  free (job.pieces);
+  if (buf != NULL && size > 0)
+    buf[total < size ? total : size - 1] = '\0';
+  return failed ? -1 : (ssize_t) total;
+}
+
+ssize_t
+vecpf_format_array_mt (char *buf, size_t size, const void *base,
+		       size_t nelem, int spec, int flags, int width, int prec,
+		       const char *sep, int nthreads)
+{
+  return vec_array_mt (buf, size, NULL, -1, base, nelem, spec, flags, width,
+		       prec, sep, nthreads);
+}
+
+ssize_t
+vecpf_fprint_array_mt (FILE *fp, const void *base, size_t nelem, int spec,
+		       int flags, int width, int prec, const char *sep,
+		       int nthreads)
+{
+  ssize_t ret;
+
+  flockfile (fp);
+  ret = vec_array_mt (NULL, 0, fp, -1, base, nelem, spec, flags, width,
+		      prec, sep, nthreads);
+  funlockfile (fp);
+  return ret;
+}
+
+ssize_t
+vecpf_dprint_array_mt (int fd, const void *base, size_t nelem, int spec,
+		       int flags, int width, int prec, const char *sep,
+		       int nthreads)
+{
+  return vec_array_mt (NULL, 0, NULL, fd, base, nelem, spec, flags, width,
+		       prec, sep, nthreads);
+}
+
+int
+vecpf_shortest_float (char *buf, size_t size, __vector float v)
+{
+  char out[VECPF_SHORTEST_FLOAT_MAXLEN];
+  vecpf_conv_t conv = { 0 };
+  vec_wide_t vp_u;
+
+  conv.prec = -1;
+  conv.spec = 'r';
+  memcpy (&vp_u, &v, sizeof (v));
+
+  return vec_copy_out (buf, size, out,
+		       vec_render_shortest_float (out, &vp_u, 4, NULL, &conv));
+}
+
+#ifdef VECPF_HAVE_VSX_TYPES
+int
+vecpf_shortest_double (char *buf, size_t size, __vector double v)
+{
+  char out[VECPF_SHORTEST_DOUBLE_MAXLEN];
+  vecpf_conv_t conv = { 0 };
+  vec_wide_t vp_u;
+
+  conv.prec = -1;
+  conv.spec = 'r';
+  memcpy (&vp_u, &v, sizeof (v));
+
+  return vec_copy_out (buf, size, out,
+		       vec_render_shortest_double (out, &vp_u, 2, NULL,
+						   &conv));
+}
+#endif
+
+#ifdef HAVE_REGISTER_PRINTF_TYPE
+/* Map the bits glibc gave our modifiers back to vector_mods.  Called once
+   the modifiers are registered.  */
+static void
+vec_build_mods (void)
 {
   int i;
 
+  memset (vec_mod_slot, 0, sizeof (vec_mod_slot));
+
+  /* register_printf_modifier hands out one bit per modifier, or -1 when it
+     runs out; leave those out of the mask so nothing ever maps to them.  */
+  vec_mods_mask = 0;
+  for (i = 0; i < vector_mods_len; i++)
+    {
+      unsigned short bits = vector_mods[i].bits;
+      if (bits != 0 && (bits & (bits - 1)) == 0)
+	{
+	  vec_mods_mask |= bits;
+	  vec_mod_slot[__builtin_ctz (bits)] = i;
+	}
+    }
+}
+
+#endif
+
+/* Fill in vec_plans from the type tables, once for every vector width.
+   The direct interfaces use them as well, so this doesn't wait for the
+   modifiers.  The VECPF_MOD_ constants in vecpf.h are the bits_index
+   values used here, with the width in VECPF_MOD_WIDTH_MASK.  */
+static void
+vec_build_plans (void)
+{
+  const char *specs = VEC_SPEC_CHARS;
+  int i, w;
+
+  memset (vec_spec_slot, -1, sizeof (vec_spec_slot));
+  for (i = 0; specs[i] != '\0'; i++)
+    vec_spec_slot[(int) specs[i]] = i;
+
+  for (w = 0; w < VEC_WIDTHS; w++)
+    {
+      int bytes = LIBVECTOR_VECTOR_WIDTH_BYTES << w;
+
+      for (i = 0; i < int_types_table_len; i++)
+	{
+	  const vector_types_rec_t *rec = &int_types_table[i];
+	  vec_plan_t *plan
+	    = &vec_plans[w][vec_spec_slot[rec->spec]][rec->bits_index];
+
+	  plan->rec = rec;
+	  plan->lanes = bytes / rec->element_size;
+	  plan->bytes = bytes;
+	  plan->libc = vec_printf_d_libc;
+	  plan->length = vec_length_int;
+	  plan->check_fp_env = 0;
+	  switch (rec->spec)
+	    {
+	      case L'c':
+		plan->render = vec_render_c;
+		break;
+	      case L'o':
+	      case L'x':
+	      case L'X':
+		plan->render = vec_render_radix;
+		break;
+	      default:
+		plan->render = vec_render_dec;
+		break;
+	    }
+	}
+
+      for (i = 0; i < fp_types_table_len; i++)
+	{
+	  const vector_types_rec_t *rec = &fp_types_table[i];
+	  vec_plan_t *plan
+	    = &vec_plans[w][vec_spec_slot[rec->spec]][rec->bits_index];
+
+	  plan->rec = rec;
+	  plan->lanes = bytes / rec->element_size;
+	  plan->bytes = bytes;
+	  plan->libc = vec_printf_f_libc;
+	  plan->length = NULL;
+	  plan->check_fp_env = 1;
+	  if (rec->spec == L'r')
+	    {
+	      /* The shortest digits don't depend on the rounding mode, and
+		 the output is meant to be read back with the C locale's
+		 radix.  */
+	      plan->libc = vec_printf_r_wide;
+	      plan->check_fp_env = 0;
+	      plan->render = (rec->data_type == VDT_double
+			      ? vec_render_shortest_double
+			      : vec_render_shortest_float);
+	    }
+	  else if (rec->spec == L'a' || rec->spec == L'A')
+	    plan->render = NULL;
+	  else if (rec->data_type == VDT_double)
+	    plan->render = vec_render_double;
+	  else
+	    plan->render = vec_render_float;
+	}
+    }
+}
+
+#ifdef HAVE_REGISTER_PRINTF_TYPE
+/* Register the vector type and modifiers.  glibc has no way to take
+   either back, so this is done once, at the first vecpf_enable.  */
+static void
+__register_printf_vec (void)
+{
+  int i;
 
   /* Register a new type, and a function to call to copy an element
      of that type when going through the varargs list.
@@ -508,32 +1770,90 @@ __register_printf_vec( void )
        = register_printf_modifier (vector_mods[i].modifier_string);
     }
 
+  vec_build_mods ();
+}
+
+/* Defined by a program that uses VECPF_MANUAL_ENABLE.  */
+extern int vecpf_manual_enable __attribute__ ((weak));
+
+static pthread_once_t vec_register_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t vec_enable_lock = PTHREAD_MUTEX_INITIALIZER;
+static int vec_enable_count;
 
-  /* Indicate our interest in integer types */
-  register_printf_specifier ('d', vec_printf_d, vec_ais);
-  register_printf_specifier ('i', vec_printf_d, vec_ais);
-  register_printf_specifier ('o', vec_printf_d, vec_ais);
-  register_printf_specifier ('u', vec_printf_d, vec_ais);
-  register_printf_specifier ('x', vec_printf_d, vec_ais);
-  register_printf_specifier ('X', vec_printf_d, vec_ais);
-  register_printf_specifier ('c', vec_printf_d, vec_ais);
-
-  /* Indicate our interest in fp types */
-  register_printf_specifier ('f', vec_printf_f, vec_ais);
-  register_printf_specifier ('F', vec_printf_f, vec_ais);
-  register_printf_specifier ('e', vec_printf_f, vec_ais);
-  register_printf_specifier ('E', vec_printf_f, vec_ais);
-  register_printf_specifier ('g', vec_printf_f, vec_ais);
-  register_printf_specifier ('G', vec_printf_f, vec_ais);
-  register_printf_specifier ('a', vec_printf_f, vec_ais);
-  register_printf_specifier ('A', vec_printf_f, vec_ais);
+/* Point every conversion character we handle, integer and floating point
+   alike, at HANDLER and ARGINFO; NULL gives them back to glibc.  */
+static void
+vec_register_specs (printf_function *handler, printf_arginfo_size_function
+		    *arginfo)
+{
+  const char *specs = VEC_SPEC_CHARS;
+  int i;
+
+  for (i = 0; specs[i] != '\0'; i++)
+    register_printf_specifier (specs[i], handler, arginfo);
+}
+
+int
+vecpf_enable (void)
+{
+  pthread_once (&vec_register_once, __register_printf_vec);
 
+  pthread_mutex_lock (&vec_enable_lock);
+  if (vec_enable_count++ == 0)
+    vec_register_specs (vec_printf, vec_ais);
+  pthread_mutex_unlock (&vec_enable_lock);
   return 0;
 }
 
+int
+vecpf_disable (void)
+{
+  int ret = 0;
+
+  pthread_mutex_lock (&vec_enable_lock);
+  if (vec_enable_count == 0)
+    {
+      errno = EINVAL;
+      ret = -1;
+    }
+  else if (--vec_enable_count == 0)
+    vec_register_specs (NULL, NULL);
+  pthread_mutex_unlock (&vec_enable_lock);
+  return ret;
+}
+#else
+/* Without printf hooks there is nothing to put the vector conversions
+   into; the library's own printf family and the direct interfaces don't
+   need them.  */
+int
+vecpf_enable (void)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
+int
+vecpf_disable (void)
+{
+  errno = ENOSYS;
+  return -1;
+}
+#endif
+
 void __attribute__ ((constructor)) __attribute__ ((visibility ("hidden") ))
 __libvecpf_init (void)
 {
-  __register_printf_vec ();
-}
+#ifdef HAVE_REGISTER_PRINTF_TYPE
+  const char *env = getenv ("VECPF_MANUAL_ENABLE");
+#endif
 
+  vec_build_plans ();
+
+#ifdef HAVE_REGISTER_PRINTF_TYPE
+  if (&vecpf_manual_enable != NULL && vecpf_manual_enable)
+    return;
+  if (env != NULL && env[0] != '\0' && strcmp (env, "0") != 0)
+    return;
+  vecpf_enable ();
+#endif
+}
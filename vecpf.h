@@ -25,6 +25,41 @@
 #ifndef _VECPF_H
 #define _VECPF_H
 
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/* The vector types.  On PowerPC they are AltiVec's.  Elsewhere GCC and
+   Clang's generic vectors of 16 bytes stand in for them, spelled the same
+   way, "__vector unsigned int"; they are passed as SSE vectors on x86, so
+   an __m128i, __m128 or __m128d can be printed with the conversion for its
+   lanes.  The bare "vector unsigned int" of AltiVec code is a macro there,
+   and would take the word from every other use, so C code that wants it
+   defines VECPF_VECTOR_KEYWORD before including this header.
+   VECPF_HAVE_VSX_TYPES is defined where there are vector long long and
+   vector double: under VSX, and always with generic vectors.  */
+
+#if defined (__powerpc__) || defined (__powerpc64__)
+# include <altivec.h>
+# ifdef __VSX__
+#  define VECPF_HAVE_VSX_TYPES 1
+# endif
+#else
+# ifndef __vector
+#  define __vector __attribute__ ((__vector_size__ (16)))
+# endif
+# if defined (VECPF_VECTOR_KEYWORD) && !defined (vector) \
+     && !defined (__cplusplus)
+#  define vector __vector
+# endif
+# define VECPF_HAVE_VSX_TYPES 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define LIBVECTOR_VECTOR_WIDTH_BYTES (16)
 
 /* Table of recognized data types.  */
@@ -49,7 +84,7 @@
 
 typedef union
 {
-  vector unsigned int v;
+  __vector unsigned int v;
   unsigned long long  ull[2];
   signed long long    sll[2];
   unsigned int        ui[4];
@@ -61,8 +96,385 @@ typedef union
   float                f[4];
   double               d[2];
 #ifdef HAVE_INT128_T
-  vector __int128_t    i;
+  __vector __int128_t  i;
 #endif
 } vp_u_t;
 
+/* Activation.
+
+   The vector conversions work by registering printf hooks for every
+   conversion character they share with scalar printf, and once glibc has
+   a hook for "%d" every printf in the process takes its slower path, even
+   one that never prints a vector.  By default the library registers them
+   when it is loaded.  A program that prints vectors only now and then can
+   keep scalar printf as it was until then, either by defining
+
+     VECPF_MANUAL_ENABLE;
+
+   at file scope in one of its own sources, or by running with
+   VECPF_MANUAL_ENABLE set to anything but "" or "0" in the environment.
+   The vector conversions are then available only between calls to
+   vecpf_enable and vecpf_disable.
+
+   vecpf_enable and vecpf_disable count: the hooks go in at the first
+   enable and are taken out again, leaving glibc's own conversions, when
+   every enable has been matched by a disable.  Loading the library
+   without either option counts as one enable.  glibc can't forget that
+   hooks were ever registered, so printf doesn't get all of its speed back
+   after the last disable, only what the hooks themselves cost.  Neither
+   should be called while another thread is in printf.  Both return 0, or
+   -1 with errno set to EINVAL for a disable with nothing to match.  A
+   library built for a libc without glibc's printf hooks, such as musl,
+   has none to register: both fail with ENOSYS there.  The direct
+   interfaces below and the library's own printf family don't depend on
+   either.  */
+
+#define VECPF_MANUAL_ENABLE  int vecpf_manual_enable = 1
+
+extern int vecpf_enable (void);
+extern int vecpf_disable (void);
+
+/* Processor level.
+
+   The integer lane kernels are built for the processor the library was
+   configured for and, where the compiler can target them, for POWER8,
+   POWER9 and POWER10 or x86-64-v3 and x86-64-v4 as well.  The newest
+   build the processor can run is picked when the library is loaded, or
+   the one named by VECPF_ISA in the environment if the processor can run
+   that.  vecpf_isa returns the name of the build in use, "baseline" for
+   the configured processor.
+
+   A library configured --with-glibc-hwcaps=LEVEL is built for LEVEL as a
+   whole and installed in LIBDIR/glibc-hwcaps/LEVEL, where the dynamic
+   loader prefers it on a processor that has LEVEL; vecpf_isa returns
+   LEVEL there.  */
+
+extern const char *vecpf_isa (void);
+
+/* Formatting without the hooks.
+
+   A printf family of the library's own, which reads the format string
+   itself and understands the standard conversions and the vector
+   modifiers alike.  Nothing goes through glibc's printf hooks, so these
+   work whether or not vecpf_enable is in effect, cost scalar printf
+   elsewhere in the process nothing, and need no -Wl,-u,__libvecpf_init in
+   a static link.  They return what the libc functions of the same names
+   would.  Positional arguments are supported; 'a', 'A', long double and
+   wide characters are printed by libc one conversion at a time.  */
+
+extern int vecpf_printf (const char *fmt, ...);
+extern int vecpf_vprintf (const char *fmt, va_list ap);
+extern int vecpf_fprintf (FILE *fp, const char *fmt, ...);
+extern int vecpf_vfprintf (FILE *fp, const char *fmt, va_list ap);
+extern int vecpf_snprintf (char *buf, size_t size, const char *fmt, ...);
+extern int vecpf_vsnprintf (char *buf, size_t size, const char *fmt,
+			    va_list ap);
+
+/* Compiled formats.
+
+   vecpf_compile parses FMT once, for a format that is printed again and
+   again, into a plan that vecpf_print and vecpf_sprint then run without
+   reading the format string.  They are vecpf_fprintf and vecpf_snprintf
+   with PLAN in place of the format, and print exactly what those would
+   for FMT.  The plan keeps a copy of FMT and is never changed once made,
+   so threads can share one.  vecpf_compile returns NULL with errno set if
+   there is no memory, or to EINVAL if FMT mixes positional and sequential
+   arguments.
+
+   vecpf_plan_maxlen is the size of a buffer that always holds what PLAN
+   prints, null byte included, or SIZE_MAX if that has no bound: "%s" and
+   "%m" without a precision, a '*' width or precision, long double, and
+   digit grouping.  */
+
+typedef struct vecpf_plan vecpf_plan_t;
+
+extern vecpf_plan_t *vecpf_compile (const char *fmt);
+extern void vecpf_plan_free (vecpf_plan_t *plan);
+extern size_t vecpf_plan_maxlen (const vecpf_plan_t *plan);
+extern int vecpf_print (const vecpf_plan_t *plan, FILE *fp, ...);
+extern int vecpf_vprint (const vecpf_plan_t *plan, FILE *fp, va_list ap);
+extern int vecpf_sprint (const vecpf_plan_t *plan, char *buf, size_t size,
+			 ...);
+extern int vecpf_vsprint (const vecpf_plan_t *plan, char *buf, size_t size,
+			  va_list ap);
+
+/* Direct formatting.
+
+   vecpf_format renders the vector at VEC into BUF exactly as snprintf
+   would for the conversion SPEC with the given FLAGS, WIDTH and PREC,
+   without going through printf.  SPEC is a VECPF_SPEC of one of the
+   VECPF_MOD_ modifiers and a conversion character, so "%-8.3vlx" is
+
+     vecpf_format (buf, size, &v, VECPF_SPEC (VECPF_MOD_VL, 'x'),
+		   VECPF_FLAG_LEFT, 8, 3);
+
+   WIDTH is 0 for none and PREC is -1 for none.  VEC need not be aligned.
+   At most SIZE bytes are stored, including the terminating null byte.
+   Returns the length of the whole output, so a return value of SIZE or
+   more means it was truncated and says how much room it needs.  Returns
+   -1 and sets errno to EINVAL for a combination of modifier and
+   conversion the printf hooks don't accept either.
+
+   Or'ing VECPF_MOD_256 or VECPF_MOD_512 into the modifier makes VEC a 32
+   or 64 byte vector, an AVX2 or AVX-512 register or a Power10 vector
+   pair, printed as one vector with twice or four times the lanes.  The
+   library's own printf family spells these with the width after the
+   modifier, "%vl256d" or "%vv512f", and takes the vector by value.  The
+   printf hooks don't: glibc has room for just sixteen modifiers in a
+   process, and the ones above use most of them.  */
+
+#define VECPF_MOD_VL   0	/* vl, lv: four words.  */
+#define VECPF_MOD_VH   2	/* vh, hv: eight halfwords.  */
+#define VECPF_MOD_V    4	/* v: sixteen bytes, or four floats.  */
+#define VECPF_MOD_VV   5	/* vv: two doubles.  */
+#define VECPF_MOD_VLL  6	/* vll, llv: two doublewords.  */
+#define VECPF_MOD_VZ   8	/* vz, zv: one quadword, where supported.  */
+
+#define VECPF_MOD_256         0x10	/* 32 byte vectors.  */
+#define VECPF_MOD_512         0x20	/* 64 byte vectors.  */
+#define VECPF_MOD_WIDTH_MASK  0x30
+
+#define VECPF_SPEC(mod, conv)  (((mod) << 8) | (unsigned char) (conv))
+
+#define VECPF_FLAG_ALT    0x01	/* '#' */
+#define VECPF_FLAG_ZERO   0x02	/* '0' */
+#define VECPF_FLAG_LEFT   0x04	/* '-' */
+#define VECPF_FLAG_SPACE  0x08	/* ' ' */
+#define VECPF_FLAG_PLUS   0x10	/* '+' */
+#define VECPF_FLAG_ALL    0x1f
+
+extern int vecpf_format (char *buf, size_t size, const void *vec, int spec,
+			 int flags, int width, int prec);
+
+/* Output length.
+
+   vecpf_formatted_length returns the length vecpf_format would return for
+   the same arguments, not counting the terminating null byte.  For the
+   integer conversions it is worked out from the number of digits in each
+   lane without rendering anything.  Returns -1 and sets errno to EINVAL
+   where vecpf_format would.
+
+   VECPF_FORMAT_MAXLEN (MOD, CONV, WIDTH, PREC) is a bound on the size of
+   the buffer any vector needs for that conversion, with any flags,
+   including the terminating null byte.  It is a constant expression when
+   its arguments are, so it can size an array on the stack:
+
+     char buf[VECPF_FORMAT_MAXLEN (VECPF_MOD_VL, 'x', 8, -1)];
+
+   VECPF_VECTOR_SIZE gives the size in bytes of the vectors MOD prints,
+   and VECPF_LANE_SIZE and VECPF_LANES the size in bytes and the number of
+   the lanes MOD and CONV split one into.  These macros evaluate their
+   arguments more than once.  */
+
+#define VECPF_VECTOR_SIZE(mod)  (16 << (((mod) & VECPF_MOD_WIDTH_MASK) >> 4))
+
+#define VECPF_LANE_SIZE(mod, conv)					\
+  (((mod) & ~VECPF_MOD_WIDTH_MASK) >= VECPF_MOD_VZ ? 16			\
+   : ((mod) & ~VECPF_MOD_WIDTH_MASK) >= VECPF_MOD_VV ? 8		\
+   : ((mod) & ~VECPF_MOD_WIDTH_MASK) == VECPF_MOD_V			\
+     ? (VECPF_IS_FP_CONV (conv) ? 4 : 1)				\
+   : ((mod) & ~VECPF_MOD_WIDTH_MASK) >= VECPF_MOD_VH ? 2 : 4)
+
+#define VECPF_LANES(mod, conv)						\
+  (VECPF_VECTOR_SIZE (mod) / VECPF_LANE_SIZE (mod, conv))
+
+#define VECPF_FORMAT_MAXLEN(mod, conv, width, prec)			\
+  (VECPF_LANES (mod, conv)						\
+   * (VECPF_LANE_SIZE (mod, conv) == 16					\
+      ? 2 * VECPF_LANE_MAXLEN (8, conv, width, prec) + 1		\
+      : VECPF_LANE_MAXLEN (VECPF_LANE_SIZE (mod, conv), conv, width,	\
+			   prec) + 1))
+
+/* The pieces of the above.  A lane is its field width or its body,
+   whichever is longer; one more byte per lane covers the separators and
+   the null byte.  The body of an integer lane is the digits of the
+   largest value its size holds, or the precision, plus a sign or a "0x"
+   prefix.  "%f" prints up to 39 integer digits for a float and 309 for a
+   double; "%e" and "%g" need at most 9 bytes besides the precision and
+   "%a" 12; "r" needs at most 24.  */
+
+#define VECPF_IS_FP_CONV(conv)						\
+  ((conv) == 'f' || (conv) == 'F' || (conv) == 'e' || (conv) == 'E'	\
+   || (conv) == 'g' || (conv) == 'G' || (conv) == 'a' || (conv) == 'A'	\
+   || (conv) == 'r')
+
+#define VECPF_INT_DIGITS(size, conv)					\
+  ((conv) == 'x' || (conv) == 'X' ? 2 * (size)				\
+   : (conv) == 'o' ? (8 * (size) + 2) / 3				\
+   : (size) == 1 ? 3 : (size) == 2 ? 5 : (size) == 4 ? 10 : 20)
+
+#define VECPF_FP_PREC(conv, prec)					\
+  ((prec) >= 0 ? (prec) : (conv) == 'a' || (conv) == 'A' ? 13 : 6)
+
+#define VECPF_LANE_BODY(size, conv, prec)				\
+  ((conv) == 'c' ? 1							\
+   : (conv) == 'r' ? 24							\
+   : (conv) == 'f' || (conv) == 'F'					\
+     ? ((size) == 4 ? 41 : 311) + VECPF_FP_PREC (conv, prec)		\
+   : (conv) == 'a' || (conv) == 'A' ? 12 + VECPF_FP_PREC (conv, prec)	\
+   : VECPF_IS_FP_CONV (conv) ? 9 + VECPF_FP_PREC (conv, prec)		\
+   : 2 + ((prec) > VECPF_INT_DIGITS (size, conv)			\
+	  ? (prec) : VECPF_INT_DIGITS (size, conv)))
+
+#define VECPF_LANE_MAXLEN(size, conv, width, prec)			\
+  ((width) > VECPF_LANE_BODY (size, conv, prec)				\
+   ? (width) : VECPF_LANE_BODY (size, conv, prec))
+
+extern int vecpf_formatted_length (const void *vec, int spec, int flags,
+				   int width, int prec);
+
+/* Parsing.
+
+   vecpf_parse reads one vector from STR in the form the conversion SPEC
+   prints it, SPEC being as for vecpf_format, and stores it in the 16, 32
+   or 64 bytes at VEC, which need not be aligned.  Lanes may be padded as
+   any width, precision and flags would pad them, the "0x" that '#' adds to
+   hex lanes may be there or not, and lanes are separated by white space or
+   by one of the AltiVec PIM separators ',', ';', ':' and '_'.  Leading
+   white space is skipped.  'c' is the exception to all of this: a space
+   may be a lane of its own, so every byte of a vector is one lane, as
+   "%vc" prints them, and what a width pads doesn't read back.  Floating
+   point lanes are read as strtod reads them.  The 'vz' modifier isn't
+   accepted, since it prints the two halves of a quadword with nothing
+   between them.  Returns the number of bytes read, or -1 with errno set to
+   EINVAL if STR doesn't start with a whole vector or SPEC isn't a
+   conversion, or to ERANGE if a lane doesn't fit in its type.
+
+   vecpf_parse_array reads up to NELEM lanes into the array at BASE, with
+   separators between vectors as well as lanes, so the output of
+   vecpf_format_array with a SEP of white space reads back.  It stops at
+   the first thing that isn't a lane, stores a pointer past the last lane
+   read in *ENDP if ENDP isn't NULL, and returns the number of lanes
+   stored, or -1 with errno set as above.  */
+
+extern int vecpf_parse (const char *str, int spec, void *vec);
+extern ssize_t vecpf_parse_array (const char *str, int spec, void *base,
+				  size_t nelem, const char **endp);
+
+/* Array formatting.
+
+   Format an array of NELEM lanes starting at BASE, one vector's worth of
+   lanes at a time, with SPEC, FLAGS, WIDTH and PREC as for vecpf_format.
+   SEP, if not NULL, is written after every vector, so "\n" gives one
+   line per vector as a printf ("%vf\n", ...) loop would.  NELEM counts
+   lanes of the conversion's type, not vectors: when it isn't a multiple
+   of the lanes in a vector, the last record prints only the lanes that
+   are there and nothing past BASE + NELEM lanes is read.  BASE need not
+   be aligned.
+
+   vecpf_format_array stores at most SIZE bytes into BUF, including the
+   terminating null byte, and returns the length of the whole output as
+   vecpf_format does.  vecpf_fprint_array writes to FP, holding its lock
+   for the whole array, and vecpf_dprint_array writes to the file
+   descriptor FD.  Those two return the number of bytes written.  All
+   three return -1 and set errno on failure.  */
+
+extern ssize_t vecpf_format_array (char *buf, size_t size, const void *base,
+				   size_t nelem, int spec, int flags,
+				   int width, int prec, const char *sep);
+extern ssize_t vecpf_fprint_array (FILE *fp, const void *base, size_t nelem,
+				   int spec, int flags, int width, int prec,
+				   const char *sep);
+extern ssize_t vecpf_dprint_array (int fd, const void *base, size_t nelem,
+				   int spec, int flags, int width, int prec,
+				   const char *sep);
+
+/* Parallel array formatting.
+
+   The same as the functions above, with the array split into pieces of a
+   few thousand vectors that are formatted on up to NTHREADS threads: the
+   calling thread and a pool of workers the library starts the first time
+   they are needed.  NTHREADS of 0 uses one thread per online processor.
+   The output is identical, and in order.  Formatting runs ahead of the
+   output by a few pieces per thread at most, so memory use doesn't grow
+   with the size of the array.  Only one parallel format runs at a time;
+   concurrent calls wait for the pool.  */
+
+extern ssize_t vecpf_format_array_mt (char *buf, size_t size,
+				      const void *base, size_t nelem,
+				      int spec, int flags, int width,
+				      int prec, const char *sep,
+				      int nthreads);
+extern ssize_t vecpf_fprint_array_mt (FILE *fp, const void *base,
+				      size_t nelem, int spec, int flags,
+				      int width, int prec, const char *sep,
+				      int nthreads);
+extern ssize_t vecpf_dprint_array_mt (int fd, const void *base,
+				      size_t nelem, int spec, int flags,
+				      int width, int prec, const char *sep,
+				      int nthreads);
+
+/* Heap strings.
+
+   vecpf_asprintf and vecpf_vasprintf are asprintf and vasprintf, vector
+   conversions included, but allocate the result once at its exact size
+   in the common case instead of growing it as it is formatted.  *STRP is
+   set to NULL on failure.  Like the arena functions below, they format as
+   vecpf_vsnprintf does, so they don't need the hooks.  */
+
+extern int vecpf_asprintf (char **strp, const char *fmt, ...);
+extern int vecpf_vasprintf (char **strp, const char *fmt, va_list ap);
+
+/* Arena strings.
+
+   vecpf_arena_printf and vecpf_arena_vprintf format into an arena that
+   belongs to the calling thread and return the string there, or NULL on
+   failure.  The string stays valid until the thread calls
+   vecpf_arena_reset, and is never freed on its own.  After a reset the
+   arena's memory is reused, so a thread that logs through the arena and
+   resets it once per message or per batch stops allocating as soon as the
+   arena has grown to its largest batch.  The arena is released when the
+   thread exits.
+
+   vecpf_arena_config sets the size of the blocks the calling thread's
+   arena is mapped in, 0 for the default of 256 KiB, and its flags.  With
+   VECPF_ARENA_HUGEPAGE the blocks are mapped from the hugetlb pool if it
+   has pages, else marked for transparent huge pages.  Settings apply to
+   blocks mapped after the call, which is all of them if nothing is in
+   the arena.  Returns -1 and sets errno to EINVAL for an unknown flag or
+   a block too small to hold anything.
+
+   vecpf_arena_stats reports the bytes handed out since the last reset,
+   the most there have ever been, and the bytes mapped.  */
+
+#define VECPF_ARENA_HUGEPAGE  0x1
+
+typedef struct
+{
+  size_t used;
+  size_t high_water;
+  size_t reserved;
+  int hugepage;			/* The current block is hugetlb.  */
+} vecpf_arena_stats_t;
+
+extern int vecpf_arena_config (size_t block_size, int flags);
+extern char *vecpf_arena_printf (const char *fmt, ...);
+extern char *vecpf_arena_vprintf (const char *fmt, va_list ap);
+extern void vecpf_arena_reset (void);
+extern void vecpf_arena_stats (vecpf_arena_stats_t *stats);
+
+/* Shortest round trip output.
+
+   Print every lane of V with the fewest significant digits that read back
+   as the same value with strtof or strtod, separated by spaces, into BUF.
+   This is the same output as the "%vr" and "%vvr" printf conversions with
+   no flags or width.  At most SIZE bytes are stored, including the
+   terminating null byte.  Returns the length of the whole output, as
+   snprintf does, so a return value of SIZE or more means it was truncated.
+   VECPF_SHORTEST_FLOAT_MAXLEN and VECPF_SHORTEST_DOUBLE_MAXLEN are always
+   large enough.  */
+
+#define VECPF_SHORTEST_FLOAT_MAXLEN  (4 * 16)
+#define VECPF_SHORTEST_DOUBLE_MAXLEN (2 * 25)
+
+extern int vecpf_shortest_float (char *buf, size_t size, __vector float v);
+#ifdef VECPF_HAVE_VSX_TYPES
+extern int vecpf_shortest_double (char *buf, size_t size,
+				  __vector double v);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* _VECPF_H  */
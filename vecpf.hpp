@@ -0,0 +1,1209 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+/* C++ interfaces to the Vector Printf Library.  Needs C++20.
+
+   Compile time formats.
+
+     auto s = vecpf::format<"%vlx %vf\n"> (v1, v2);
+     fputs (s.c_str (), stdout);
+
+   parses the format while the program is compiled, and checks every
+   argument against the conversion it goes with: the lane size the
+   modifier calls for must be the lane size of the vector, floating point
+   conversions take vector float or vector double, and integer ones take
+   integer vectors.  A mismatch, a conversion the library doesn't know, or
+   too many or too few arguments is a compile error.  Nothing is left to
+   do at run time but the lanes themselves: the literal text is copied,
+   the integer conversions are rendered lane by lane by inline code
+   specialized for their flags, width, precision and lane type, and the
+   floating point ones are handed to vecpf_format with their spec already
+   worked out.
+
+   The format may hold vector conversions with the vl, lv, vh, hv, v, vv,
+   vll, llv, vz and zv modifiers and "%%", with flags, widths and
+   precisions written out as numbers.  Scalar conversions, '*', positional
+   arguments and digit grouping, which depends on the locale, are refused;
+   vecpf_snprintf takes those.
+
+   The result is a vecpf::buffer<N>, whose N is the most the format can
+   print, null byte included, so it needs no allocation.
+   vecpf::format_to writes to a buffer of the caller's, which must have
+   room for vecpf::format_maxlen<FMT> bytes, and returns the end of the
+   output, which it doesn't terminate.
+
+   Formatters.
+
+     std::format ("{:#x|, }", v);
+     fmt::format ("{:>12.3e}", v);
+
+   The vector types can be given to std::format where the library has it,
+   and to {fmt} where <fmt/format.h> is included before this header.  The
+   spec is spelled as the standard one is, with a separator for the lanes
+   after it:
+
+     [[fill]align][sign][#][0][width][.precision][type][|separator]
+
+   but each lane is what printf makes of it, not what std::format would:
+   "a" gives "%a"'s "0x1.8p+0" where std::format has "1.8p+0", and '#'
+   is printf's, so a lane of zero is "0" under "{:#x}", not "0x0".
+
+   The width, fill and alignment, '0' and the sign apply to each lane, as
+   a printf width does.  The types are d, x, X and o for integer vectors,
+   and c as well for vectors of bytes; e, E, f, F, g, G, a and A for
+   vector float and vector double.  An integer vector's decimal lanes are
+   signed or unsigned as its type is, and its other types print lanes as
+   unsigned, as printf does.  Without a type, integer lanes are decimal
+   and floating point ones are the shortest that reads back, or "g" given
+   a precision.  A precision gives the minimum number of digits of an
+   integer lane.  The separator is up to 15 characters, a space if there
+   is none.  A quadword is a single lane, printed as the library prints
+   "%vz".  The lanes are rendered by vecpf_format and written straight to
+   the output iterator.
+
+   Inserters.
+
+     std::cout << std::hex << std::showbase << v << '\n';
+
+   operator<< prints the lanes separated by spaces, as printf's vector
+   conversions do, following the stream's base, float field, precision,
+   showbase, showpoint, showpos, uppercase, fill and adjustment.  The
+   width applies to each lane and is reset once the vector is out.  Byte
+   lanes are numbers, not characters.  The whole vector is formatted into
+   one buffer on the stack, without the stream's locale, and handed to
+   the stream buffer with a single sputn.
+
+   Chunks.
+
+     for (std::string_view chunk : vecpf::format_chunks (std::span (arr)))
+       write (fd, chunk.data (), chunk.size ());
+
+   vecpf::format_chunks is a coroutine that formats an array of vectors a
+   chunk of text at a time, into one buffer it reuses, so that the text
+   can be written or compressed while the rest is formatted and memory
+   stays the same however long the array is.  It needs a compiler with
+   coroutines.  */
+
+#ifndef _VECPF_HPP
+#define _VECPF_HPP
+
+#if __cplusplus < 202002L
+# error "vecpf.hpp needs C++20"
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <version>
+
+#ifdef __cpp_impl_coroutine
+# include <coroutine>
+# include <exception>
+#endif
+
+#ifdef __cpp_lib_format
+# include <format>
+#endif
+#ifdef FMT_VERSION
+# include <fmt/format.h>
+#endif
+
+#include <vecpf.h>
+
+/* altivec.h makes "bool" a macro for the vector keyword, which C++ can't
+   have.  */
+#ifdef bool
+# undef bool
+#endif
+
+/* The quadword conversions need a compiler with vector __int128.  */
+#if defined (HAVE_INT128_T) || defined (__POWER8_VECTOR__)		\
+    || (!defined (__powerpc__) && defined (__SIZEOF_INT128__))
+# define VECPF_HPP_INT128 1
+#endif
+
+namespace vecpf
+{
+  /* A string literal as a template argument.  */
+  template<std::size_t N>
+    struct fixed_string
+    {
+      char str[N];
+
+      constexpr
+      fixed_string (const char (&s)[N])
+      {
+	for (std::size_t i = 0; i < N; i++)
+	  str[i] = s[i];
+      }
+
+      static constexpr std::size_t length = N - 1;
+    };
+
+  /* Output of a known largest size N, null byte included.  */
+  template<std::size_t N>
+    struct buffer
+    {
+      char data[N];
+      std::size_t len;
+
+      static constexpr std::size_t capacity = N;
+
+      std::size_t
+      size () const
+      { return len; }
+
+      const char *
+      c_str () const
+      { return data; }
+
+      std::string_view
+      view () const
+      { return std::string_view (data, len); }
+
+      operator std::string_view () const
+      { return view (); }
+    };
+
+  namespace detail
+  {
+    /* The vector types, their lanes, and the modifier that prints them.  */
+    template<typename V>
+      struct lane_traits;
+
+#define VECPF_HPP_LANES(V, S, U, SIGNED, FP)				\
+    template<>								\
+      struct lane_traits<V>						\
+      {									\
+	typedef S signed_type;						\
+	typedef U unsigned_type;					\
+	static constexpr int size = sizeof (U);				\
+	static constexpr bool is_signed = SIGNED;			\
+	static constexpr bool is_fp = FP;				\
+	static constexpr int mod					\
+	  = (sizeof (U) == 16 ? VECPF_MOD_VZ				\
+	     : sizeof (U) == 8 ? (FP ? VECPF_MOD_VV : VECPF_MOD_VLL)	\
+	     : sizeof (U) == 4 ? (FP ? VECPF_MOD_V : VECPF_MOD_VL)	\
+	     : sizeof (U) == 2 ? VECPF_MOD_VH : VECPF_MOD_V);		\
+      };
+
+    VECPF_HPP_LANES (__vector signed char, signed char, unsigned char,
+		     true, false)
+    VECPF_HPP_LANES (__vector unsigned char, signed char, unsigned char,
+		     false, false)
+    VECPF_HPP_LANES (__vector signed short, short, unsigned short, true,
+		     false)
+    VECPF_HPP_LANES (__vector unsigned short, short, unsigned short, false,
+		     false)
+    VECPF_HPP_LANES (__vector signed int, int, unsigned int, true, false)
+    VECPF_HPP_LANES (__vector unsigned int, int, unsigned int, false,
+		     false)
+    VECPF_HPP_LANES (__vector float, float, float, true, true)
+#ifdef VECPF_HAVE_VSX_TYPES
+    VECPF_HPP_LANES (__vector signed long long, long long,
+		     unsigned long long, true, false)
+    VECPF_HPP_LANES (__vector unsigned long long, long long,
+		     unsigned long long, false, false)
+    VECPF_HPP_LANES (__vector double, double, double, true, true)
+#endif
+#ifdef VECPF_HPP_INT128
+    VECPF_HPP_LANES (__vector signed __int128, __int128,
+		     unsigned __int128, true, false)
+    VECPF_HPP_LANES (__vector unsigned __int128, __int128,
+		     unsigned __int128, false, false)
+#endif
+
+#undef VECPF_HPP_LANES
+
+    template<typename V>
+      concept vector_type = requires { lane_traits<V>::size; };
+
+    /* One conversion.  */
+    struct conv_t
+    {
+      char spec = 0;
+      int mod = 0;
+      int flags = 0;
+      int width = 0;
+      int prec = -1;
+    };
+
+    /* Literal text, as an offset into the format and a length, or a
+       conversion.  */
+    struct piece_t
+    {
+      std::size_t text = 0;
+      std::size_t len = 0;
+      bool is_conv = false;
+      conv_t conv;
+    };
+
+    /* Called only from a format that can't be compiled, so that the error
+       names the problem.  Never defined.  */
+    void format_error (const char *why);
+
+    constexpr bool
+    is_digit (char c)
+    { return c >= '0' && c <= '9'; }
+
+    constexpr bool
+    is_fp_conv (char c)
+    {
+      return c == 'f' || c == 'F' || c == 'e' || c == 'E' || c == 'g'
+	     || c == 'G' || c == 'a' || c == 'A' || c == 'r';
+    }
+
+    constexpr bool
+    is_int_conv (char c)
+    {
+      return c == 'd' || c == 'i' || c == 'o' || c == 'u' || c == 'x'
+	     || c == 'X';
+    }
+
+    /* The conversion after the '%' at S + *POS, with *POS moved past it.
+       "%%" is a conversion whose spec is '%'.  */
+    constexpr conv_t
+    parse_conv (const char *s, std::size_t *pos)
+    {
+      conv_t c;
+      std::size_t i = *pos + 1;
+
+      if (s[i] == '%')
+	{
+	  c.spec = '%';
+	  *pos = i + 1;
+	  return c;
+	}
+
+      for (;; i++)
+	{
+	  if (s[i] == '-')
+	    c.flags |= VECPF_FLAG_LEFT;
+	  else if (s[i] == '+')
+	    c.flags |= VECPF_FLAG_PLUS;
+	  else if (s[i] == ' ')
+	    c.flags |= VECPF_FLAG_SPACE;
+	  else if (s[i] == '#')
+	    c.flags |= VECPF_FLAG_ALT;
+	  else if (s[i] == '0')
+	    c.flags |= VECPF_FLAG_ZERO;
+	  else if (s[i] == '\'')
+	    format_error ("the ' flag depends on the locale");
+	  else
+	    break;
+	}
+
+      for (; is_digit (s[i]); i++)
+	c.width = c.width * 10 + (s[i] - '0');
+      if (s[i] == '.')
+	{
+	  c.prec = 0;
+	  for (i++; is_digit (s[i]); i++)
+	    c.prec = c.prec * 10 + (s[i] - '0');
+	}
+      if (s[i] == '*' || s[i] == '$')
+	format_error ("no '*' widths or positional arguments");
+      if (c.width > 4096 || c.prec > 4096)
+	format_error ("width or precision too large");
+
+      if (s[i] == 'v' && s[i + 1] == 'l' && s[i + 2] == 'l')
+	c.mod = VECPF_MOD_VLL, i += 3;
+      else if (s[i] == 'l' && s[i + 1] == 'l' && s[i + 2] == 'v')
+	c.mod = VECPF_MOD_VLL, i += 3;
+      else if ((s[i] == 'v' && s[i + 1] == 'l')
+	       || (s[i] == 'l' && s[i + 1] == 'v'))
+	c.mod = VECPF_MOD_VL, i += 2;
+      else if ((s[i] == 'v' && s[i + 1] == 'h')
+	       || (s[i] == 'h' && s[i + 1] == 'v'))
+	c.mod = VECPF_MOD_VH, i += 2;
+      else if ((s[i] == 'v' && s[i + 1] == 'z')
+	       || (s[i] == 'z' && s[i + 1] == 'v'))
+	c.mod = VECPF_MOD_VZ, i += 2;
+      else if (s[i] == 'v' && s[i + 1] == 'v')
+	c.mod = VECPF_MOD_VV, i += 2;
+      else if (s[i] == 'v')
+	c.mod = VECPF_MOD_V, i += 1;
+      else
+	format_error ("only vector conversions and %%");
+
+      c.spec = s[i];
+      if (c.mod == VECPF_MOD_V
+	  ? !is_int_conv (c.spec) && !is_fp_conv (c.spec) && c.spec != 'c'
+	  : c.mod == VECPF_MOD_VV ? !is_fp_conv (c.spec)
+	  : !is_int_conv (c.spec))
+	format_error ("conversion not valid with its modifier");
+
+      *pos = i + 1;
+      return c;
+    }
+
+    /* The pieces of FMT, into OUT if it isn't null; returns how many.  */
+    constexpr std::size_t
+    parse (const char *s, piece_t *out)
+    {
+      std::size_t n = 0;
+      std::size_t pos = 0;
+      std::size_t text = 0;
+
+      for (;;)
+	{
+	  if (s[pos] != '%' && s[pos] != '\0')
+	    {
+	      pos++;
+	      continue;
+	    }
+	  if (pos > text)
+	    {
+	      if (out)
+		out[n] = piece_t { text, pos - text, false, conv_t () };
+	      n++;
+	    }
+	  if (s[pos] == '\0')
+	    return n;
+
+	  conv_t c = parse_conv (s, &pos);
+	  if (c.spec == '%')
+	    /* The second '%' starts the next run of text.  */
+	    text = pos - 1;
+	  else
+	    {
+	      if (out)
+		out[n] = piece_t { 0, 0, true, c };
+	      n++;
+	      text = pos;
+	    }
+	}
+    }
+
+    /* The most C prints, without the null byte.  */
+    constexpr std::size_t
+    conv_maxlen (const conv_t &c)
+    {
+      return VECPF_FORMAT_MAXLEN (c.mod, c.spec, c.width, c.prec) - 1;
+    }
+
+    /* Everything vecpf::format needs to know about the format F.  */
+    template<fixed_string F>
+      struct plan
+      {
+	static constexpr std::size_t npieces = parse (F.str, nullptr);
+
+	struct pieces_t
+	{
+	  piece_t p[npieces > 0 ? npieces : 1];
+	};
+
+	static constexpr pieces_t pieces = []
+	  {
+	    pieces_t t {};
+	    parse (F.str, t.p);
+	    return t;
+	  } ();
+
+	static constexpr std::size_t nconvs = []
+	  {
+	    std::size_t n = 0;
+	    for (std::size_t i = 0; i < npieces; i++)
+	      n += pieces.p[i].is_conv;
+	    return n;
+	  } ();
+
+	static constexpr std::size_t maxlen = []
+	  {
+	    std::size_t n = 1;
+	    for (std::size_t i = 0; i < npieces; i++)
+	      n += (pieces.p[i].is_conv ? conv_maxlen (pieces.p[i].conv)
+		    : pieces.p[i].len);
+	    return n;
+	  } ();
+
+	/* The argument of piece I, if it is a conversion.  */
+	static constexpr std::size_t
+	arg_of (std::size_t i)
+	{
+	  std::size_t n = 0;
+	  for (std::size_t j = 0; j < i; j++)
+	    n += pieces.p[j].is_conv;
+	  return n;
+	}
+      };
+
+    /* Whether V can be printed with C.  */
+    template<conv_t C, typename V>
+      constexpr bool
+      conv_takes ()
+      {
+	typedef lane_traits<V> T;
+
+	if (VECPF_LANE_SIZE (C.mod, C.spec) != T::size)
+	  return false;
+	if (is_fp_conv (C.spec))
+	  return T::is_fp;
+	return !T::is_fp;
+      }
+
+    /* The digits of M in BASE, ending at END; returns where they start.  */
+    template<int Base, bool Upper, typename U>
+      inline char *
+      put_digits (char *end, U m)
+      {
+	const char *digits = Upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+	do
+	  {
+	    *--end = digits[m % Base];
+	    m /= Base;
+	  }
+	while (m != 0);
+	return end;
+      }
+
+    /* One integer lane, as printf prints it with C.  */
+    template<conv_t C, typename U>
+      inline char *
+      put_int (char *p, U mag, bool negative)
+      {
+	constexpr bool left = C.flags & VECPF_FLAG_LEFT;
+	constexpr bool alt = C.flags & VECPF_FLAG_ALT;
+	constexpr bool is_signed = C.spec == 'd' || C.spec == 'i';
+	constexpr int base = (C.spec == 'o' ? 8
+			      : C.spec == 'x' || C.spec == 'X' ? 16 : 10);
+	char tmp[4 * sizeof (U) + 4];
+	char *end = tmp + sizeof (tmp);
+	char *d = end;
+	char prefix[2];
+	int nprefix = 0;
+	int ndigits, zeros, pad;
+
+	if (!(C.prec == 0 && mag == 0))
+	  d = put_digits<base, C.spec == 'X'> (end, mag);
+	ndigits = end - d;
+	zeros = C.prec > ndigits ? C.prec - ndigits : 0;
+	if (C.spec == 'o' && alt && zeros == 0 && (ndigits == 0 || *d != '0'))
+	  zeros = 1;
+
+	if (is_signed && negative)
+	  prefix[nprefix++] = '-';
+	else if (is_signed && (C.flags & VECPF_FLAG_PLUS))
+	  prefix[nprefix++] = '+';
+	else if (is_signed && (C.flags & VECPF_FLAG_SPACE))
+	  prefix[nprefix++] = ' ';
+	else if (base == 16 && alt && mag != 0)
+	  {
+	    prefix[nprefix++] = '0';
+	    prefix[nprefix++] = C.spec;
+	  }
+
+	pad = C.width - (nprefix + zeros + ndigits);
+	if ((C.flags & VECPF_FLAG_ZERO) && !left && C.prec < 0 && pad > 0)
+	  {
+	    zeros += pad;
+	    pad = 0;
+	  }
+
+	if (!left)
+	  for (; pad > 0; pad--)
+	    *p++ = ' ';
+	for (int i = 0; i < nprefix; i++)
+	  *p++ = prefix[i];
+	for (; zeros > 0; zeros--)
+	  *p++ = '0';
+	while (d < end)
+	  *p++ = *d++;
+	for (; pad > 0; pad--)
+	  *p++ = ' ';
+	return p;
+      }
+
+    /* The vector V with C, lane by lane.  */
+    template<conv_t C, typename V>
+      inline char *
+      put_vector (char *p, const V &v)
+      {
+	typedef lane_traits<V> T;
+	typedef typename T::signed_type S;
+	typedef typename T::unsigned_type U;
+
+	if constexpr (T::is_fp)
+	  return p + vecpf_format (p, conv_maxlen (C) + 1, &v,
+				   VECPF_SPEC (C.mod, C.spec), C.flags,
+				   C.width, C.prec);
+	else if constexpr (C.spec == 'c')
+	  {
+	    for (int i = 0; i < 16; i++)
+	      {
+		if (!(C.flags & VECPF_FLAG_LEFT))
+		  for (int pad = C.width - 1; pad > 0; pad--)
+		    *p++ = ' ';
+		*p++ = (char) v[i];
+		if (C.flags & VECPF_FLAG_LEFT)
+		  for (int pad = C.width - 1; pad > 0; pad--)
+		    *p++ = ' ';
+	      }
+	    return p;
+	  }
+	else if constexpr (T::size == 16)
+	  {
+	    /* The two doublewords back to back, most significant first, as
+	       the library prints a quadword.  */
+	    unsigned long long half[2];
+
+	    std::memcpy (half, &v, sizeof (half));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	    std::swap (half[0], half[1]);
+#endif
+	    for (int i = 0; i < 2; i++)
+	      {
+		long long h = (long long) half[i];
+
+		if constexpr (C.spec == 'd' || C.spec == 'i')
+		  p = put_int<C, unsigned long long> (p, h < 0 ? 0 - half[i]
+						      : half[i], h < 0);
+		else
+		  p = put_int<C, unsigned long long> (p, half[i], false);
+	      }
+	    return p;
+	  }
+	else
+	  {
+	    for (int i = 0; i < 16 / T::size; i++)
+	      {
+		if (i > 0)
+		  *p++ = ' ';
+		if constexpr (C.spec == 'd' || C.spec == 'i')
+		  {
+		    S s = (S) v[i];
+		    p = put_int<C, U> (p, s < 0 ? (U) 0 - (U) s : (U) s, s < 0);
+		  }
+		else
+		  p = put_int<C, U> (p, (U) v[i], false);
+	      }
+	    return p;
+	  }
+      }
+
+    /* Piece I of F, with its argument from ARGS.  */
+    template<fixed_string F, std::size_t I, typename Tuple>
+      inline char *
+      put_piece (char *p, const Tuple &args)
+      {
+	typedef plan<F> P;
+	constexpr piece_t piece = P::pieces.p[I];
+
+	if constexpr (!piece.is_conv)
+	  {
+	    std::memcpy (p, F.str + piece.text, piece.len);
+	    return p + piece.len;
+	  }
+	else
+	  {
+	    constexpr std::size_t arg = P::arg_of (I);
+	    typedef std::remove_cvref_t<std::tuple_element_t<arg, Tuple>> V;
+
+	    static_assert (conv_takes<piece.conv, V> (),
+			   "vector type doesn't match its conversion");
+	    return put_vector<piece.conv> (p, std::get<arg> (args));
+	  }
+      }
+
+    template<fixed_string F, std::size_t... I, typename... Args>
+      inline char *
+      format_to (char *p, std::index_sequence<I...>, const Args &... args)
+      {
+	std::tuple<const Args &...> tuple (args...);
+
+	((p = put_piece<F, I> (p, tuple)), ...);
+	return p;
+      }
+  }
+
+  /* The size of a buffer that always holds what FMT prints, null byte
+     included.  */
+  template<fixed_string F>
+    inline constexpr std::size_t format_maxlen = detail::plan<F>::maxlen;
+
+  template<fixed_string F, detail::vector_type... Args>
+    inline char *
+    format_to (char *out, const Args &... args)
+    {
+      static_assert (sizeof... (Args) == detail::plan<F>::nconvs,
+		     "the number of vectors doesn't match the format");
+      return detail::format_to<F>
+	(out, std::make_index_sequence<detail::plan<F>::npieces> (), args...);
+    }
+
+  template<fixed_string F, detail::vector_type... Args>
+    inline buffer<format_maxlen<F>>
+    format (const Args &... args)
+    {
+      buffer<format_maxlen<F>> b;
+      char *end = format_to<F> (b.data, args...);
+
+      *end = '\0';
+      b.len = end - b.data;
+      return b;
+    }
+
+  namespace detail
+  {
+    /* A formatter's spec, for one vector.  */
+    struct format_spec
+    {
+      char fill = ' ';
+      char align = 0;
+      char sign = 0;
+      bool alt = false;
+      bool zero = false;
+      char zero_fill = '0';
+      int width = 0;
+      int prec = -1;
+      char type = 0;
+      char sep[16] = " ";
+      int seplen = 1;
+    };
+
+    /* Reads the spec for V from [P, END) into *S.  Returns where it
+       stopped, which is the closing brace, or sets *ERROR.  */
+    template<typename V>
+      constexpr const char *
+      parse_spec (const char *p, const char *end, format_spec *s,
+		  const char **error)
+      {
+	typedef lane_traits<V> T;
+	auto is_align = [] (char c) { return c == '<' || c == '>'
+					     || c == '^'; };
+
+	*error = nullptr;
+	if (end - p >= 2 && is_align (p[1]) && p[0] != '{' && p[0] != '}')
+	  {
+	    if ((unsigned char) p[0] >= 0x80)
+	      {
+		*error = "the fill must be one byte";
+		return p;
+	      }
+	    s->fill = p[0];
+	    s->align = p[1];
+	    p += 2;
+	  }
+	else if (p != end && is_align (p[0]))
+	  s->align = *p++;
+
+	if (p != end && (*p == '+' || *p == '-' || *p == ' '))
+	  s->sign = *p++;
+	if (p != end && *p == '#')
+	  s->alt = true, p++;
+	if (p != end && *p == '0')
+	  s->zero = true, p++;
+	for (; p != end && is_digit (*p); p++)
+	  s->width = s->width * 10 + (*p - '0');
+	if (p != end && *p == '.')
+	  {
+	    s->prec = 0;
+	    if (++p == end || !is_digit (*p))
+	      {
+		*error = "missing precision";
+		return p;
+	      }
+	    for (; p != end && is_digit (*p); p++)
+	      s->prec = s->prec * 10 + (*p - '0');
+	  }
+	if (s->width > 4096 || s->prec > 4096)
+	  {
+	    *error = "width or precision too large";
+	    return p;
+	  }
+
+	if (p != end && *p != '}' && *p != '|')
+	  s->type = *p++;
+	if (s->type == 'i' || s->type == 'u' || s->type == 'r'
+	    || (s->type != 0
+		&& (T::is_fp ? !is_fp_conv (s->type)
+		    : !is_int_conv (s->type)
+		      && !(s->type == 'c' && T::size == 1))))
+	  {
+	    *error = "type not valid for the vector";
+	    return p;
+	  }
+	if (s->type == 'c' && (s->sign || s->alt || s->zero || s->prec >= 0))
+	  {
+	    *error = "no sign, '#', '0' or precision with c";
+	    return p;
+	  }
+
+	if (p != end && *p == '|')
+	  {
+	    s->seplen = 0;
+	    for (p++; p != end && *p != '}'; p++)
+	      {
+		if (*p == '{' || s->seplen == (int) sizeof (s->sep) - 1)
+		  {
+		    *error = "separator too long or with a brace";
+		    return p;
+		  }
+		s->sep[s->seplen++] = *p;
+	      }
+	  }
+	if (p != end && *p != '}')
+	  *error = "invalid vector format spec";
+	return p;
+      }
+
+    template<typename Out>
+      inline Out
+      put_fill (Out out, char c, int n)
+      {
+	for (; n > 0; n--)
+	  *out++ = c;
+	return out;
+      }
+
+    /* The lane printf printed as [P, Q), with the sign, padding and
+       alignment of S.  */
+    template<typename Out>
+      Out
+      put_lane (Out out, const char *p, const char *q,
+		const format_spec &s, bool is_fp)
+      {
+	char sign = s.sign == '-' ? 0 : s.sign;
+	int nprefix = 0;
+	int pad, before, zeros;
+
+	if (p != q && *p == '-')
+	  sign = *p++;
+	if (q - p > 1 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+	  nprefix = 2;
+	pad = s.width - (sign != 0) - (int) (q - p);
+	if (pad < 0)
+	  pad = 0;
+
+	/* '0' pads after the sign and prefix, unless there is an
+	   alignment or the lane isn't a number.  */
+	if (s.zero && !s.align
+	    && !(is_fp && p != q && (*p == 'i' || *p == 'I' || *p == 'n'
+				     || *p == 'N')))
+	  zeros = pad, before = 0;
+	else
+	  {
+	    char align = s.align ? s.align : s.type == 'c' ? '<' : '>';
+
+	    zeros = 0;
+	    before = align == '>' ? pad : align == '^' ? pad / 2 : 0;
+	  }
+
+	out = put_fill (out, s.fill, before);
+	if (sign)
+	  *out++ = sign;
+	for (int i = 0; i < nprefix; i++)
+	  *out++ = *p++;
+	out = put_fill (out, s.zero_fill, zeros);
+	while (p < q)
+	  *out++ = *p++;
+	return put_fill (out, s.fill, pad - before - zeros);
+      }
+
+    /* V with S.  vecpf_format renders the lanes without a width or
+       sign, so that they are split by single spaces, and put_lane does
+       the rest; the digits, prefixes included, are printf's.  */
+    template<typename V, typename Out>
+      Out
+      format_vector (Out out, const V &v, const format_spec &s)
+      {
+	typedef lane_traits<V> T;
+	constexpr int nlanes = 16 / T::size;
+	char conv = s.type;
+	char small[1024];
+	std::unique_ptr<char[]> big;
+	char *buf = small;
+	const char *p, *end;
+	int n;
+
+	if (conv == 'c')
+	  {
+	    for (int i = 0; i < nlanes; i++)
+	      {
+		char c = (char) v[i];
+
+		if (i > 0)
+		  for (int j = 0; j < s.seplen; j++)
+		    *out++ = s.sep[j];
+		out = put_lane (out, &c, &c + 1, s, false);
+	      }
+	    return out;
+	  }
+
+	if (conv == 0)
+	  conv = !T::is_fp ? 'd' : s.prec >= 0 ? 'g' : 'r';
+	if (conv == 'd' && !T::is_signed)
+	  conv = 'u';
+
+	n = vecpf_format (buf, sizeof (small), &v, VECPF_SPEC (T::mod, conv),
+			  s.alt ? VECPF_FLAG_ALT : 0, 0, s.prec);
+	if (n >= (int) sizeof (small))
+	  {
+	    big.reset (new char[n + 1]);
+	    buf = big.get ();
+	    vecpf_format (buf, n + 1, &v, VECPF_SPEC (T::mod, conv),
+			  s.alt ? VECPF_FLAG_ALT : 0, 0, s.prec);
+	  }
+
+	p = buf;
+	end = buf + (n > 0 ? n : 0);
+	for (int i = 0; i < nlanes; i++)
+	  {
+	    const char *q = end;
+
+	    if (i + 1 < nlanes)
+	      {
+		q = (const char *) std::memchr (p, ' ', end - p);
+		if (q == nullptr)
+		  q = end;
+	      }
+	    if (i > 0)
+	      for (int j = 0; j < s.seplen; j++)
+		*out++ = s.sep[j];
+	    out = put_lane (out, p, q, s, T::is_fp);
+	    p = q < end ? q + 1 : end;
+	  }
+	return out;
+      }
+
+    /* V on OS, as its flags, width, precision and fill say.  */
+    template<typename V>
+      std::ostream &
+      insert (std::ostream &os, const V &v)
+      {
+	typedef lane_traits<V> T;
+	std::ios_base::fmtflags flags = os.flags ();
+	std::ios_base::fmtflags adjust = flags & std::ios_base::adjustfield;
+	std::ios_base::fmtflags fp = flags & std::ios_base::floatfield;
+	bool upper = flags & std::ios_base::uppercase;
+	format_spec s;
+	std::ostream::sentry sentry (os);
+
+	if (!sentry)
+	  return os;
+
+	if (T::is_fp)
+	  {
+	    s.type = (fp == std::ios_base::fixed ? 'f'
+		      : fp == std::ios_base::scientific ? 'e'
+		      : fp == (std::ios_base::fixed | std::ios_base::scientific)
+		      ? 'a' : 'g');
+	    if (s.type != 'a')
+	      s.prec = os.precision () > 4096 ? 4096 : (int) os.precision ();
+	    s.alt = flags & std::ios_base::showpoint;
+	  }
+	else
+	  {
+	    s.type = (flags & std::ios_base::hex ? 'x'
+		      : flags & std::ios_base::oct ? 'o' : 'd');
+	    s.alt = flags & std::ios_base::showbase;
+	  }
+	if (upper && s.type != 'd' && s.type != 'o')
+	  s.type -= 'a' - 'A';
+	if ((flags & std::ios_base::showpos)
+	    && (T::is_fp || (T::is_signed && s.type == 'd')))
+	  s.sign = '+';
+
+	s.fill = os.fill ();
+	s.width = os.width () > 4096 ? 4096 : (int) os.width ();
+	if (adjust == std::ios_base::internal)
+	  {
+	    s.zero = true;
+	    s.zero_fill = s.fill;
+	  }
+	else
+	  s.align = adjust == std::ios_base::left ? '<' : '>';
+	os.width (0);
+
+	/* The most vecpf_format prints with the width, which is as much as
+	   a lane's sign and padding can take.  */
+	std::size_t size = VECPF_FORMAT_MAXLEN (T::mod, s.type, s.width,
+						 s.prec);
+	char small[1024];
+	std::unique_ptr<char[]> big;
+	char *buf = small;
+
+	if (size > sizeof (small))
+	  {
+	    big.reset (new char[size]);
+	    buf = big.get ();
+	  }
+	std::streamsize n = format_vector (buf, v, s) - buf;
+	if (os.rdbuf ()->sputn (buf, n) != n)
+	  os.setstate (std::ios_base::badbit);
+	return os;
+      }
+  }
+
+#ifdef __cpp_impl_coroutine
+  /* A coroutine that yields Ts to a range for loop.  Each one is valid
+     until the loop asks for the next.  An exception the coroutine throws
+     comes out of the loop.  */
+  template<typename T>
+    class generator
+    {
+    public:
+      struct promise_type;
+      typedef std::coroutine_handle<promise_type> handle_type;
+
+      struct promise_type
+      {
+	const T *value = nullptr;
+	std::exception_ptr error;
+
+	generator
+	get_return_object ()
+	{ return generator (handle_type::from_promise (*this)); }
+
+	std::suspend_always
+	initial_suspend () noexcept
+	{ return {}; }
+
+	std::suspend_always
+	final_suspend () noexcept
+	{ return {}; }
+
+	std::suspend_always
+	yield_value (const T &v) noexcept
+	{
+	  value = &v;
+	  return {};
+	}
+
+	void
+	return_void ()
+	{ }
+
+	void
+	unhandled_exception ()
+	{ error = std::current_exception (); }
+      };
+
+      class iterator
+      {
+      public:
+	typedef T value_type;
+	typedef std::ptrdiff_t difference_type;
+
+	iterator () = default;
+
+	explicit
+	iterator (handle_type h)
+	  : h (h)
+	{ }
+
+	const T &
+	operator* () const
+	{ return *h.promise ().value; }
+
+	iterator &
+	operator++ ()
+	{
+	  next (h);
+	  return *this;
+	}
+
+	void
+	operator++ (int)
+	{ ++*this; }
+
+	bool
+	operator== (std::default_sentinel_t) const
+	{ return h.done (); }
+
+      private:
+	handle_type h;
+      };
+
+      generator (generator &&g) noexcept
+	: h (std::exchange (g.h, nullptr))
+      { }
+
+      generator &
+      operator= (generator &&g) noexcept
+      {
+	std::swap (h, g.h);
+	return *this;
+      }
+
+      ~generator ()
+      {
+	if (h)
+	  h.destroy ();
+      }
+
+      iterator
+      begin ()
+      {
+	next (h);
+	return iterator (h);
+      }
+
+      std::default_sentinel_t
+      end () const
+      { return {}; }
+
+    private:
+      explicit
+      generator (handle_type h)
+	: h (h)
+      { }
+
+      /* Runs the coroutine to its next value or its end.  */
+      static void
+      next (handle_type h)
+      {
+	h.resume ();
+	if (h.promise ().error)
+	  std::rethrow_exception (std::exchange (h.promise ().error,
+						 nullptr));
+      }
+
+      handle_type h;
+    };
+
+  /* How format_chunks prints each vector.  CONV, FLAGS, WIDTH and PREC
+     are as for vecpf_format, with the modifier the vector type calls
+     for; a CONV of 0 is decimal, signed or not as the type is, for
+     integers and the shortest that reads back for floating point.  SEP,
+     if not null, is written after every vector, and must outlive the
+     generator.  */
+  struct chunk_spec
+  {
+    char conv = 0;
+    int flags = 0;
+    int width = 0;
+    int prec = -1;
+    const char *sep = "\n";
+  };
+
+  /* The vectors of VECS as SPEC says, in chunks of at most CHUNK_SIZE
+     bytes, or one vector's worth where that is more.  Each chunk is a
+     whole number of vectors, formatted by vecpf_format_array into one
+     buffer the generator owns and reuses, so its memory doesn't grow
+     with VECS.  A chunk is valid until the next one is asked for.  A
+     conversion the vector type can't take throws std::system_error.  */
+  template<typename V, std::size_t E>
+    requires detail::vector_type<std::remove_const_t<V>>
+    generator<std::string_view>
+    format_chunks (std::span<V, E> vecs, chunk_spec spec = {},
+		   std::size_t chunk_size = 64 * 1024)
+    {
+      typedef detail::lane_traits<std::remove_const_t<V>> T;
+      char conv = (spec.conv ? spec.conv : T::is_fp ? 'r'
+		   : T::is_signed ? 'd' : 'u');
+      std::size_t seplen = spec.sep ? std::strlen (spec.sep) : 0;
+      std::size_t per_vector = (VECPF_FORMAT_MAXLEN (T::mod, conv,
+						     spec.width, spec.prec)
+				- 1 + seplen);
+      std::size_t nper = (chunk_size > per_vector
+			  ? chunk_size / per_vector : 1);
+      std::size_t size = nper * per_vector + 1;
+      std::unique_ptr<char[]> buf (new char[size]);
+
+      for (std::size_t i = 0; i < vecs.size (); i += nper)
+	{
+	  std::size_t n = vecs.size () - i < nper ? vecs.size () - i : nper;
+	  ssize_t len = vecpf_format_array (buf.get (), size, &vecs[i],
+					    n * (16 / T::size),
+					    VECPF_SPEC (T::mod, conv),
+					    spec.flags, spec.width, spec.prec,
+					    spec.sep);
+
+	  if (len < 0)
+	    throw std::system_error (errno, std::generic_category (),
+				     "vecpf_format_array");
+	  co_yield std::string_view (buf.get (), len);
+	}
+    }
+#endif
+}
+
+#ifdef __cpp_lib_format
+template<vecpf::detail::vector_type V>
+  struct std::formatter<V, char>
+  {
+    vecpf::detail::format_spec spec;
+
+    constexpr std::format_parse_context::iterator
+    parse (std::format_parse_context &ctx)
+    {
+      const char *begin = std::to_address (ctx.begin ());
+      const char *error;
+      const char *end
+	= vecpf::detail::parse_spec<V> (begin, std::to_address (ctx.end ()),
+					&spec, &error);
+
+      if (error)
+	throw std::format_error (error);
+      return ctx.begin () + (end - begin);
+    }
+
+    template<typename FormatContext>
+      typename FormatContext::iterator
+      format (const V &v, FormatContext &ctx) const
+      { return vecpf::detail::format_vector (ctx.out (), v, spec); }
+  };
+#endif
+
+#ifdef FMT_VERSION
+template<vecpf::detail::vector_type V>
+  struct fmt::formatter<V, char>
+  {
+    vecpf::detail::format_spec spec;
+
+    constexpr fmt::format_parse_context::iterator
+    parse (fmt::format_parse_context &ctx)
+    {
+      const char *error;
+      const char *end = vecpf::detail::parse_spec<V> (ctx.begin (),
+						      ctx.end (), &spec,
+						      &error);
+
+      if (error)
+	throw fmt::format_error (error);
+      return end;
+    }
+
+    template<typename FormatContext>
+      typename FormatContext::iterator
+      format (const V &v, FormatContext &ctx) const
+      { return vecpf::detail::format_vector (ctx.out (), v, spec); }
+  };
+#endif
+
+/* Inserters for the vector types.  They are at file scope, since ADL
+   can't find anything for a built in type.  */
+template<vecpf::detail::vector_type V>
+  inline std::ostream &
+  operator<< (std::ostream &os, const V &v)
+  { return vecpf::detail::insert (os, v); }
+
+#endif /* _VECPF_HPP  */
@@ -0,0 +1,329 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "config.h"
+#include "vecpf.h"
+
+/* Formatted output as a string the library allocates.
+
+   vecpf_vasprintf formats into a stack buffer first and only goes back to
+   vecpf_vsnprintf a second time for output that doesn't fit there, so the
+   common case is one format and one malloc of the exact size, where
+   asprintf grows a memory stream by repeated reallocs.
+
+   The arena keeps formatted strings in per-thread blocks that are mapped
+   once and then reused after every vecpf_arena_reset, so a thread that
+   formats into it and resets it regularly does no allocation at all once
+   the first block is big enough.  Strings are never moved: when one
+   doesn't fit in the current block a new block is chained on, and at the
+   next reset the chain is replaced by a single block as large as the most
+   the arena has held.  */
+
+#define VEC_ASPRINTF_STACK  512
+
+int
+vecpf_vasprintf (char **strp, const char *fmt, va_list ap)
+{
+  char stack[VEC_ASPRINTF_STACK];
+  va_list aq;
+  char *buf;
+  int n;
+
+  va_copy (aq, ap);
+  n = vecpf_vsnprintf (stack, sizeof (stack), fmt, aq);
+  va_end (aq);
+
+  *strp = NULL;
+  if (n < 0)
+    return -1;
+
+  buf = malloc ((size_t) n + 1);
+  if (buf == NULL)
+    return -1;
+
+  if ((size_t) n < sizeof (stack))
+    memcpy (buf, stack, (size_t) n + 1);
+  else if (vecpf_vsnprintf (buf, (size_t) n + 1, fmt, ap) != n)
+    {
+      free (buf);
+      return -1;
+    }
+
+  *strp = buf;
+  return n;
+}
+
+int
+vecpf_asprintf (char **strp, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, fmt);
+  n = vecpf_vasprintf (strp, fmt, ap);
+  va_end (ap);
+  return n;
+}
+
+/* Default size of an arena block, header included.  */
+#define VEC_ARENA_BLOCK     (256 * 1024)
+
+/* Blocks of a hugepage backed arena are a multiple of the size of the
+   pages MAP_HUGETLB maps, the system's default hugepage size: 2 MiB on
+   x86 and radix POWER9 hosts, but 16 MiB under the POWER hash MMU and
+   1 GiB with default_hugepagesz=1G.  Where that isn't known the hugetlb
+   pool isn't tried, and blocks for transparent huge pages are a multiple
+   of this.  */
+#define VEC_ARENA_HUGEPAGE  (2 * 1024 * 1024)
+
+typedef struct vec_arena_block
+{
+  struct vec_arena_block *prev;	/* The block filled before this one.  */
+  size_t size;			/* Mapped size, header included.  */
+  size_t used;			/* Bytes handed out past the header.  */
+  int huge;			/* Mapped with MAP_HUGETLB.  */
+} vec_arena_block_t;
+
+typedef struct
+{
+  vec_arena_block_t *cur;
+  size_t block_size;		/* 0 for VEC_ARENA_BLOCK.  */
+  int flags;
+  int registered;		/* The thread exit destructor is set.  */
+  size_t used;			/* Bytes handed out since the reset.  */
+  size_t high_water;
+  size_t reserved;
+} vec_arena_t;
+
+static __thread vec_arena_t vec_arena;
+
+static pthread_key_t vec_arena_key;
+static pthread_once_t vec_arena_once = PTHREAD_ONCE_INIT;
+
+/* The default hugepage size, 0 if unknown.  */
+static size_t vec_arena_hugepage;
+
+static void
+vec_arena_unmap (vec_arena_t *a)
+{
+  vec_arena_block_t *b, *prev;
+
+  for (b = a->cur; b != NULL; b = prev)
+    {
+      prev = b->prev;
+      a->reserved -= b->size;
+      munmap (b, b->size);
+    }
+  a->cur = NULL;
+}
+
+static void
+vec_arena_destroy (void *p)
+{
+  vec_arena_unmap (p);
+}
+
+static void
+vec_arena_init (void)
+{
+  FILE *fp;
+  char line[128];
+  unsigned long kb;
+
+  pthread_key_create (&vec_arena_key, vec_arena_destroy);
+
+  fp = fopen ("/proc/meminfo", "re");
+  if (fp == NULL)
+    return;
+  while (fgets (line, sizeof (line), fp) != NULL)
+    if (sscanf (line, "Hugepagesize: %lu kB", &kb) == 1)
+      {
+	vec_arena_hugepage = (size_t) kb * 1024;
+	break;
+      }
+  fclose (fp);
+}
+
+/* Map a block with room for at least NEED bytes after the header and
+   chain it on.  */
+static vec_arena_block_t *
+vec_arena_grow (vec_arena_t *a, size_t need)
+{
+  size_t size = a->block_size > 0 ? a->block_size : VEC_ARENA_BLOCK;
+  size_t align = (size_t) sysconf (_SC_PAGESIZE);
+  vec_arena_block_t *b = MAP_FAILED;
+  int huge = 0;
+
+  pthread_once (&vec_arena_once, vec_arena_init);
+  if (!a->registered)
+    {
+      pthread_setspecific (vec_arena_key, a);
+      a->registered = 1;
+    }
+
+  /* munmap fails for a hugetlb mapping whose length isn't a multiple of
+     its page size.  */
+  if (a->flags & VECPF_ARENA_HUGEPAGE)
+    align = vec_arena_hugepage > 0 ? vec_arena_hugepage : VEC_ARENA_HUGEPAGE;
+  if (need > size - sizeof (vec_arena_block_t))
+    size = need + sizeof (vec_arena_block_t);
+  size = (size + align - 1) & ~(align - 1);
+
+#ifdef MAP_HUGETLB
+  if ((a->flags & VECPF_ARENA_HUGEPAGE) && vec_arena_hugepage > 0)
+    {
+      b = mmap (NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      huge = (b != MAP_FAILED);
+    }
+#endif
+  if (b == MAP_FAILED)
+    {
+      b = mmap (NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (b == MAP_FAILED)
+	return NULL;
+#ifdef MADV_HUGEPAGE
+      /* No hugetlb pages reserved; transparent ones are the next best.  */
+      if (a->flags & VECPF_ARENA_HUGEPAGE)
+	madvise (b, size, MADV_HUGEPAGE);
+#endif
+    }
+
+  b->prev = a->cur;
+  b->size = size;
+  b->used = 0;
+  b->huge = huge;
+  a->cur = b;
+  a->reserved += size;
+  return b;
+}
+
+int
+vecpf_arena_config (size_t block_size, int flags)
+{
+  vec_arena_t *a = &vec_arena;
+
+  if ((flags & ~VECPF_ARENA_HUGEPAGE) != 0
+      || (block_size != 0 && block_size <= sizeof (vec_arena_block_t)))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  a->block_size = block_size;
+  a->flags = flags;
+
+  /* Nothing handed out refers to the blocks, so start over with the new
+     settings right away.  */
+  if (a->used == 0)
+    vec_arena_unmap (a);
+  return 0;
+}
+
+char *
+vecpf_arena_vprintf (const char *fmt, va_list ap)
+{
+  vec_arena_t *a = &vec_arena;
+  vec_arena_block_t *b = a->cur;
+  va_list aq;
+  size_t room;
+  char *p;
+  int n;
+
+  if (b == NULL && (b = vec_arena_grow (a, 0)) == NULL)
+    return NULL;
+
+  room = b->size - sizeof (*b) - b->used;
+  p = (char *) (b + 1) + b->used;
+  va_copy (aq, ap);
+  n = vecpf_vsnprintf (p, room, fmt, aq);
+  va_end (aq);
+  if (n < 0)
+    return NULL;
+
+  if ((size_t) n >= room)
+    {
+      if ((b = vec_arena_grow (a, (size_t) n + 1)) == NULL)
+	return NULL;
+      p = (char *) (b + 1);
+      if (vecpf_vsnprintf (p, (size_t) n + 1, fmt, ap) != n)
+	return NULL;
+    }
+
+  b->used += (size_t) n + 1;
+  a->used += (size_t) n + 1;
+  if (a->used > a->high_water)
+    a->high_water = a->used;
+  return p;
+}
+
+char *
+vecpf_arena_printf (const char *fmt, ...)
+{
+  va_list ap;
+  char *p;
+
+  va_start (ap, fmt);
+  p = vecpf_arena_vprintf (fmt, ap);
+  va_end (ap);
+  return p;
+}
+
+void
+vecpf_arena_reset (void)
+{
+  vec_arena_t *a = &vec_arena;
+
+  if (a->cur == NULL)
+    return;
+
+  /* Once the arena has needed more than one block, trade the chain for one
+     block that holds as much as all of them did.  */
+  if (a->cur->prev != NULL)
+    {
+      vec_arena_unmap (a);
+      vec_arena_grow (a, a->high_water);
+    }
+  else
+    a->cur->used = 0;
+  a->used = 0;
+}
+
+void
+vecpf_arena_stats (vecpf_arena_stats_t *stats)
+{
+  const vec_arena_t *a = &vec_arena;
+
+  stats->used = a->used;
+  stats->high_water = a->high_water;
+  stats->reserved = a->reserved;
+  stats->hugepage = a->cur != NULL && a->cur->huge;
+}
@@ -0,0 +1,1553 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <langinfo.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <wchar.h>
+
+#include "config.h"
+#include "vecpf.h"
+#include "vecpf_priv.h"
+
+/* The formatting engine.
+
+   vecpf_vsnprintf and the functions built on it read the whole format
+   string themselves, scalar conversions and vector ones alike, and never
+   go through glibc's printf hooks.  They work whether or not the hooks
+   are registered, and a statically linked program that uses only these
+   doesn't pull in the object with the constructor that registers them.
+
+   Literal text is scanned for the next '%' sixteen bytes at a time with
+   vector compares.  Every conversion is rendered by the same kernels as
+   the hooks use, straight into the caller's buffer or the stream buffer
+   when there is room: the integer kernels for d, i, o, u, x, X, c and p,
+   with a single lane for a scalar, and the float kernels for f, F, e, E,
+   g and G.  What those don't cover goes to libc's vsnprintf one scalar
+   conversion at a time, as the hooks hand it back: 'a' and 'A', long
+   double, wide characters and strings, fields wider than
+   VEC_LANE_WIDTH_MAX, digit grouping in a locale that groups, and
+   floating point in a locale or rounding mode the kernels don't follow.
+
+   Positional arguments ("%2$d") are read by a first pass over the format
+   that collects the type of every argument, after which they are all
+   fetched in order.  */
+
+/* Arguments as a conversion fetches them.  */
+enum
+{
+  VEC_ARG_INVALID,		/* Not a conversion; printed as it is.  */
+  VEC_ARG_NONE,
+  VEC_ARG_INT,
+  VEC_ARG_LONG,
+  VEC_ARG_LLONG,
+  VEC_ARG_INTMAX,
+  VEC_ARG_SIZE,
+  VEC_ARG_PTRDIFF,
+  VEC_ARG_DOUBLE,
+  VEC_ARG_LDOUBLE,
+  VEC_ARG_PTR,
+  VEC_ARG_WINT,
+  VEC_ARG_VEC,
+  VEC_ARG_VEC256,
+  VEC_ARG_VEC512
+};
+
+/* Scalar length modifiers.  */
+enum
+{
+  VEC_LEN_NONE,
+  VEC_LEN_HH,
+  VEC_LEN_H,
+  VEC_LEN_L,
+  VEC_LEN_LL,
+  VEC_LEN_BIGL,
+  VEC_LEN_J,
+  VEC_LEN_Z,
+  VEC_LEN_T
+};
+
+/* What the length modifier runs spell.  The vector modifiers are those of
+   vector_mods in vecpf.c, each with its VECPF_MOD_ value, and may be
+   followed by "256" or "512" for the wider vectors.  */
+static const struct
+{
+  char str[4];
+  signed char len;
+  signed char vmod;
+} vec_eng_mods[] =
+{
+  { "", VEC_LEN_NONE, -1 },
+  { "hh", VEC_LEN_HH, -1 },
+  { "h", VEC_LEN_H, -1 },
+  { "l", VEC_LEN_L, -1 },
+  { "ll", VEC_LEN_LL, -1 },
+  { "q", VEC_LEN_LL, -1 },
+  { "L", VEC_LEN_BIGL, -1 },
+  { "j", VEC_LEN_J, -1 },
+  { "z", VEC_LEN_Z, -1 },
+  { "Z", VEC_LEN_Z, -1 },
+  { "t", VEC_LEN_T, -1 },
+  { "vl", VEC_LEN_NONE, VECPF_MOD_VL },
+  { "lv", VEC_LEN_NONE, VECPF_MOD_VL },
+  { "vh", VEC_LEN_NONE, VECPF_MOD_VH },
+  { "hv", VEC_LEN_NONE, VECPF_MOD_VH },
+  { "v", VEC_LEN_NONE, VECPF_MOD_V },
+  { "vv", VEC_LEN_NONE, VECPF_MOD_VV },
+  { "vll", VEC_LEN_NONE, VECPF_MOD_VLL },
+  { "llv", VEC_LEN_NONE, VECPF_MOD_VLL },
+#ifdef HAVE_INT128_T
+  { "vz", VEC_LEN_NONE, VECPF_MOD_VZ },
+  { "zv", VEC_LEN_NONE, VECPF_MOD_VZ },
+#endif
+};
+
+/* One conversion specification.  */
+typedef struct
+{
+  vecpf_conv_t conv;
+  int len;			/* VEC_LEN_ */
+  int vmod;			/* VECPF_MOD_ and width, or -1 for a
+				   scalar.  */
+  int type;			/* VEC_ARG_ */
+  int arg;			/* Positional argument, or 0 for the next.  */
+  int width_arg;		/* Same for a '*' width, -1 for none.  */
+  int prec_arg;			/* Same for a '*' precision, -1 for none.  */
+} vec_spec_t;
+
+typedef union
+{
+  long long ll;			/* Any integer, converted to long long.  */
+  double d;
+  long double ld;
+  void *p;
+  wint_t wc;
+  vec_wide_t v;
+} vec_arg_t;
+
+/* Stream output is collected in a buffer of this size before it is
+   written.  A 16 byte vector always fits once it is flushed; a wider one
+   may be rendered elsewhere and copied.  */
+#define VEC_ENG_STREAM_BUF  8192
+
+/* Where the output goes: the caller's buffer for a string, or BUF and then
+   FP for a stream.  */
+typedef struct
+{
+  char *buf;
+  size_t size;			/* Of BUF, the null byte included.  */
+  size_t pos;			/* Bytes in BUF.  */
+  size_t total;			/* Bytes output, stored or not.  */
+  FILE *fp;			/* NULL for a string.  */
+  int error;
+  int fp_env;			/* __vecpf_fp_env_is_c, -1 until needed.  */
+  int saved_errno;		/* For %m.  */
+  void *heap;			/* From vec_out_reserve, for vec_out_commit.  */
+  char scratch[VEC_OUT_LEN (16)];	/* HEAP is used for wider.  */
+} vec_out_t;
+
+/* Set K up to output to the SIZE bytes at BUF, and from there to FP
+   unless that is NULL.  */
+static void
+vec_out_init (vec_out_t *k, char *buf, size_t size, FILE *fp)
+{
+  k->buf = buf;
+  k->size = size;
+  k->pos = 0;
+  k->total = 0;
+  k->fp = fp;
+  k->error = 0;
+  k->fp_env = -1;
+  k->saved_errno = errno;
+  k->heap = NULL;
+}
+
+static void
+vec_out_flush (vec_out_t *k)
+{
+  if (k->pos > 0 && !k->error
+      && fwrite_unlocked (k->buf, 1, k->pos, k->fp) != k->pos)
+    k->error = 1;
+  k->pos = 0;
+}
+
+/* The room left in a string's buffer, less the null byte.  */
+static inline size_t
+vec_out_room (const vec_out_t *k)
+{
+  return k->size > k->pos ? k->size - 1 - k->pos : 0;
+}
+
+static void
+vec_out_put (vec_out_t *k, const char *p, size_t n)
+{
+  k->total += n;
+  if (k->fp == NULL)
+    {
+      size_t room = vec_out_room (k);
+
+      if (n > room)
+	n = room;
+      if (n > 0)
+	memcpy (k->buf + k->pos, p, n);
+      k->pos += n;
+      return;
+    }
+
+  if (n > k->size - k->pos)
+    {
+      vec_out_flush (k);
+      if (n >= k->size)
+	{
+	  if (!k->error && fwrite_unlocked (p, 1, n, k->fp) != n)
+	    k->error = 1;
+	  return;
+	}
+    }
+  memcpy (k->buf + k->pos, p, n);
+  k->pos += n;
+}
+
+static void
+vec_out_pad (vec_out_t *k, char c, int n)
+{
+  char fill[64];
+
+  if (n <= 0)
+    return;
+  memset (fill, c, n < (int) sizeof (fill) ? n : (int) sizeof (fill));
+  while (n > 0)
+    {
+      int chunk = n < (int) sizeof (fill) ? n : (int) sizeof (fill);
+      vec_out_put (k, fill, chunk);
+      n -= chunk;
+    }
+}
+
+/* Room for N bytes of output, to be handed to vec_out_commit: right where
+   they go if they fit there, so a kernel renders straight into the
+   destination, or else somewhere to copy them from.  Returns NULL if
+   there is no memory for that.  */
+static char *
+vec_out_reserve (vec_out_t *k, size_t n)
+{
+  k->heap = NULL;
+  if (k->fp == NULL)
+    {
+      if (n <= vec_out_room (k))
+	return k->buf + k->pos;
+    }
+  else
+    {
+      if (n > k->size - k->pos)
+	vec_out_flush (k);
+      if (n <= k->size - k->pos)
+	return k->buf + k->pos;
+    }
+  if (n <= sizeof (k->scratch))
+    return k->scratch;
+  k->heap = malloc (n);
+  if (k->heap == NULL)
+    k->error = 1;
+  return k->heap;
+}
+
+static void
+vec_out_commit (vec_out_t *k, const char *p, size_t n)
+{
+  if (p == k->buf + k->pos)
+    {
+      k->pos += n;
+      k->total += n;
+      return;
+    }
+  vec_out_put (k, p, n);
+  free (k->heap);
+  k->heap = NULL;
+}
+
+/* Print with libc's vsnprintf: the conversions the kernels don't do.  */
+static void
+vec_out_libc (vec_out_t *k, const char *fmt, ...)
+{
+  char tmp[256];
+  char *big;
+  va_list ap;
+  int n;
+
+  va_start (ap, fmt);
+  n = vsnprintf (tmp, sizeof (tmp), fmt, ap);
+  va_end (ap);
+  if (n < 0)
+    {
+      k->error = 1;
+      return;
+    }
+  if ((size_t) n < sizeof (tmp))
+    {
+      vec_out_put (k, tmp, n);
+      return;
+    }
+
+  big = malloc ((size_t) n + 1);
+  if (big == NULL)
+    {
+      k->error = 1;
+      return;
+    }
+  va_start (ap, fmt);
+  vsnprintf (big, (size_t) n + 1, fmt, ap);
+  va_end (ap);
+  vec_out_put (k, big, n);
+  free (big);
+}
+
+/* The next '%' or the end of the string at or after P.  */
+static inline const char *
+vec_eng_find (const char *p)
+{
+  for (;;)
+    {
+      v16u8_t c = vec_load16 (p);
+      unsigned int bits = vec_bits16 ((v16u8_t) (c == '%')
+				      | (v16u8_t) (c == 0));
+
+      if (bits != 0)
+	return p + __builtin_ctz (bits);
+      p += 16;
+    }
+}
+
+/* A decimal number at *PP, and *PP past it; -1 if it doesn't fit in an
+   int.  */
+static int
+vec_eng_num (const char **pp)
+{
+  const char *p = *pp;
+  int n = 0;
+
+  while (*p >= '0' && *p <= '9')
+    {
+      if (n > (INT_MAX - 9) / 10)
+	n = -1;
+      else if (n >= 0)
+	n = n * 10 + (*p - '0');
+      p++;
+    }
+  *pp = p;
+  return n;
+}
+
+/* "N$" at *PP: N, with *PP past it, or 0 with *PP as it was.  */
+static int
+vec_eng_pos (const char **pp)
+{
+  const char *p = *pp;
+  int n;
+
+  if (*p < '1' || *p > '9')
+    return 0;
+  n = vec_eng_num (&p);
+  if (*p != '$' || n <= 0)
+    return 0;
+  *pp = p + 1;
+  return n;
+}
+
+/* Whether the modifier VMOD goes with the conversion C, as the type
+   tables in vecpf.c have it.  */
+static int
+vec_eng_vector_ok (int vmod, int c)
+{
+  int is_int = strchr ("diouxX", c) != NULL;
+  int is_fp = strchr ("fFeEgGaAr", c) != NULL;
+
+  switch (vmod & ~VECPF_MOD_WIDTH_MASK)
+    {
+    case VECPF_MOD_V:
+      return is_int || is_fp || c == 'c';
+    case VECPF_MOD_VV:
+      return is_fp;
+    default:
+      return is_int;
+    }
+}
+
+/* Parse the conversion specification after the '%' at P into S.  Returns
+   the first byte after it.  S->type is VEC_ARG_INVALID for something that
+   isn't a conversion, which is then printed as it stands.  */
+static const char *
+vec_eng_parse (const char *p, vec_spec_t *s)
+{
+  char run[4];
+  int nrun = 0;
+  int wide = 0;
+  size_t i;
+  int c;
+
+  memset (s, 0, sizeof (*s));
+  s->conv.prec = -1;
+  s->vmod = -1;
+  s->width_arg = -1;
+  s->prec_arg = -1;
+  s->type = VEC_ARG_INVALID;
+
+  s->arg = vec_eng_pos (&p);
+
+  for (;; p++)
+    {
+      if (*p == '-')
+	s->conv.left = 1;
+      else if (*p == '+')
+	s->conv.showsign = 1;
+      else if (*p == ' ')
+	s->conv.space = 1;
+      else if (*p == '#')
+	s->conv.alt = 1;
+      else if (*p == '0')
+	s->conv.zero = 1;
+      else if (*p == '\'')
+	s->conv.group = 1;
+      else
+	break;
+    }
+
+  if (*p == '*')
+    {
+      p++;
+      s->width_arg = vec_eng_pos (&p);
+    }
+  else if ((s->conv.width = vec_eng_num (&p)) < 0)
+    return p;
+
+  if (*p == '.')
+    {
+      p++;
+      if (*p == '*')
+	{
+	  p++;
+	  s->prec_arg = vec_eng_pos (&p);
+	}
+      else if ((s->conv.prec = vec_eng_num (&p)) < 0)
+	return p;
+    }
+
+  while (*p != '\0' && strchr ("hlLqjztZv", *p) != NULL)
+    {
+      if (nrun == 3)
+	return p;
+      run[nrun++] = *p++;
+    }
+  run[nrun] = '\0';
+
+  if (nrun > 0 && strncmp (p, "256", 3) == 0)
+    wide = VECPF_MOD_256, p += 3;
+  else if (nrun > 0 && strncmp (p, "512", 3) == 0)
+    wide = VECPF_MOD_512, p += 3;
+
+  c = (unsigned char) *p;
+  if (c == '\0')
+    return p;
+  p++;
+  s->conv.spec = c;
+
+  for (i = 0; i < sizeof (vec_eng_mods) / sizeof (vec_eng_mods[0]); i++)
+    if (strcmp (run, vec_eng_mods[i].str) == 0)
+      break;
+  if (i == sizeof (vec_eng_mods) / sizeof (vec_eng_mods[0]))
+    return p;
+  s->len = vec_eng_mods[i].len;
+  s->vmod = vec_eng_mods[i].vmod;
+
+  if (s->vmod >= 0)
+    {
+      s->vmod |= wide;
+      if (vec_eng_vector_ok (s->vmod, c))
+	s->type = (wide == VECPF_MOD_256 ? VEC_ARG_VEC256
+		   : wide == VECPF_MOD_512 ? VEC_ARG_VEC512 : VEC_ARG_VEC);
+      return p;
+    }
+  if (wide != 0)
+    return p;
+
+  switch (c)
+    {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'n':
+      switch (s->len)
+	{
+	case VEC_LEN_L:
+	  s->type = VEC_ARG_LONG;
+	  break;
+	case VEC_LEN_LL:
+	case VEC_LEN_BIGL:
+	  s->type = VEC_ARG_LLONG;
+	  break;
+	case VEC_LEN_J:
+	  s->type = VEC_ARG_INTMAX;
+	  break;
+	case VEC_LEN_Z:
+	  s->type = VEC_ARG_SIZE;
+	  break;
+	case VEC_LEN_T:
+	  s->type = VEC_ARG_PTRDIFF;
+	  break;
+	default:
+	  s->type = VEC_ARG_INT;
+	  break;
+	}
+      if (c == 'n')
+	s->type = VEC_ARG_PTR;
+      break;
+    case 'c':
+      s->type = s->len == VEC_LEN_L ? VEC_ARG_WINT : VEC_ARG_INT;
+      break;
+    case 'C':
+      s->type = VEC_ARG_WINT;
+      break;
+    case 's':
+    case 'S':
+    case 'p':
+      s->type = VEC_ARG_PTR;
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      s->type = s->len == VEC_LEN_BIGL ? VEC_ARG_LDOUBLE : VEC_ARG_DOUBLE;
+      break;
+    case '%':
+    case 'm':
+      s->type = VEC_ARG_NONE;
+      break;
+    }
+  return p;
+}
+
+static void
+vec_eng_fetch (int type, va_list *ap, vec_arg_t *a)
+{
+  switch (type)
+    {
+    case VEC_ARG_INT:
+      a->ll = va_arg (*ap, int);
+      break;
+    case VEC_ARG_LONG:
+      a->ll = va_arg (*ap, long);
+      break;
+    case VEC_ARG_LLONG:
+      a->ll = va_arg (*ap, long long);
+      break;
+    case VEC_ARG_INTMAX:
+      a->ll = va_arg (*ap, intmax_t);
+      break;
+    case VEC_ARG_SIZE:
+      a->ll = (long long) va_arg (*ap, size_t);
+      break;
+    case VEC_ARG_PTRDIFF:
+      a->ll = va_arg (*ap, ptrdiff_t);
+      break;
+    case VEC_ARG_DOUBLE:
+      a->d = va_arg (*ap, double);
+      break;
+    case VEC_ARG_LDOUBLE:
+      a->ld = va_arg (*ap, long double);
+      break;
+    case VEC_ARG_PTR:
+      a->p = va_arg (*ap, void *);
+      break;
+    case VEC_ARG_WINT:
+      a->wc = va_arg (*ap, wint_t);
+      break;
+    case VEC_ARG_VEC:
+      {
+	__vector unsigned int v = va_arg (*ap, __vector unsigned int);
+	memcpy (&a->v, &v, sizeof (v));
+	break;
+      }
+    case VEC_ARG_VEC256:
+      {
+	v8u32_t v = va_arg (*ap, v8u32_t);
+	memcpy (&a->v, &v, sizeof (v));
+	break;
+      }
+    case VEC_ARG_VEC512:
+      {
+	v16u32_t v = va_arg (*ap, v16u32_t);
+	memcpy (&a->v, &v, sizeof (v));
+	break;
+      }
+    }
+}
+
+/* A libc format for one conversion with the flags of CONV, "*.*" for the
+   width and precision, LEN and the conversion C.  */
+static void
+vec_eng_libc_format (char *fmt, const vecpf_conv_t *conv, const char *len,
+		     int c)
+{
+  char *p = fmt;
+
+  *p++ = '%';
+  if (conv->alt)
+    *p++ = '#';
+  if (conv->space)
+    *p++ = ' ';
+  if (conv->left)
+    *p++ = '-';
+  if (conv->showsign)
+    *p++ = '+';
+  if (conv->group)
+    *p++ = '\'';
+  if (conv->zero)
+    *p++ = '0';
+  strcpy (p, "*.*");
+  strcat (p, len);
+  p += strlen (p);
+  *p++ = c;
+  *p = '\0';
+}
+
+/* Whether the kernels can render S: no field they don't have room for,
+   no grouping where the locale groups, and for floating point, the C
+   locale's radix and round to nearest.  */
+static int
+vec_eng_use_kernel (vec_out_t *k, const vec_spec_t *s, int is_fp)
+{
+  if (s->conv.width > VEC_LANE_WIDTH_MAX || s->conv.prec > VEC_LANE_WIDTH_MAX)
+    return 0;
+  if (s->conv.group)
+    {
+      const char *sep = nl_langinfo (THOUSEP);
+      if (sep != NULL && *sep != '\0')
+	return 0;
+    }
+  if (is_fp)
+    {
+      if (k->fp_env < 0)
+	k->fp_env = __vecpf_fp_env_is_c ();
+      return k->fp_env;
+    }
+  return 1;
+}
+
+/* S's integer argument A as the type its length modifier names, as a
+   magnitude and a sign.  */
+static unsigned long long
+vec_eng_int (const vec_spec_t *s, const vec_arg_t *a, int *negative)
+{
+  int is_signed = (s->conv.spec == 'd' || s->conv.spec == 'i');
+  long long v = a->ll;
+
+  switch (s->len)
+    {
+    case VEC_LEN_HH:
+      v = is_signed ? (long long) (signed char) v : (unsigned char) v;
+      break;
+    case VEC_LEN_H:
+      v = is_signed ? (long long) (short) v : (unsigned short) v;
+      break;
+    case VEC_LEN_NONE:
+      v = is_signed ? (long long) (int) v : (unsigned int) v;
+      break;
+    case VEC_LEN_L:
+      v = is_signed ? (long long) (long) v : (long long) (unsigned long) v;
+      break;
+    case VEC_LEN_Z:
+      v = is_signed ? (long long) (ssize_t) v : (long long) (size_t) v;
+      break;
+    case VEC_LEN_T:
+      v = (long long) (ptrdiff_t) v;
+      break;
+    }
+
+  *negative = is_signed && v < 0;
+  return *negative ? -(unsigned long long) v : (unsigned long long) v;
+}
+
+/* A string for 's', cut at the precision and padded to the width.  */
+static void
+vec_eng_string (vec_out_t *k, const vec_spec_t *s, const char *str)
+{
+  size_t n;
+
+  /* glibc prints a null pointer as "(null)" if the precision lets all of
+     it through, and as nothing otherwise.  */
+  if (str == NULL)
+    str = (s->conv.prec < 0 || s->conv.prec >= 6) ? "(null)" : "";
+  n = s->conv.prec >= 0 ? strnlen (str, s->conv.prec) : strlen (str);
+
+  if (!s->conv.left)
+    vec_out_pad (k, ' ', s->conv.width - (int) n);
+  vec_out_put (k, str, n);
+  if (s->conv.left)
+    vec_out_pad (k, ' ', s->conv.width - (int) n);
+}
+
+/* A vector conversion, through the kernels or one lane at a time through
+   libc.  */
+static void
+vec_eng_vector (vec_out_t *k, const vec_spec_t *s, const vec_wide_t *v)
+{
+  int c = s->conv.spec;
+  int is_fp = strchr ("fFeEgGaAr", c) != NULL;
+  int size = VECPF_LANE_SIZE (s->vmod, c);
+  int lanes = VECPF_LANES (s->vmod, c);
+  char fmt[32];
+  char *out, *p;
+  int i;
+
+  if (c == 'r')
+    {
+      /* libc has nothing to fall back on, so wide fields are rendered
+	 into a buffer as large as they need.  */
+      out = vec_out_reserve (k, lanes * ((size_t) s->conv.width
+					 + VEC_SHORTEST_LANE_MAXLEN + 1));
+      if (out == NULL)
+	return;
+      for (i = 0, p = out; i < lanes; i++)
+	{
+	  if (i > 0)
+	    *p++ = ' ';
+	  p += __vecpf_fmt_shortest (p, size == 8 ? v->d[i] : v->f[i],
+				     size == 4, &s->conv);
+	}
+      vec_out_commit (k, out, p - out);
+      return;
+    }
+
+  if (c != 'a' && c != 'A' && vec_eng_use_kernel (k, s, is_fp))
+    {
+      out = vec_out_reserve (k, VEC_OUT_LEN (VECPF_VECTOR_SIZE (s->vmod)));
+      if (out == NULL)
+	return;
+      p = out;
+      if (c == 'c')
+	for (i = 0; i < lanes; i++)
+	  p += __vecpf_fmt_int (p, v->uc[i], 0, &s->conv);
+      else if (is_fp)
+	for (i = 0; i < lanes; i++)
+	  {
+	    if (i > 0)
+	      *p++ = ' ';
+	    p += __vecpf_fmt_fp (p, size == 8 ? v->d[i] : v->f[i], &s->conv);
+	  }
+      else if (c == 'o' || c == 'x' || c == 'X')
+	p += __vecpf_render_radix (p, v, size, lanes, &s->conv);
+      else
+	p += __vecpf_render_dec (p, v, size, lanes, &s->conv);
+      vec_out_commit (k, out, p - out);
+      return;
+    }
+
+  if (is_fp)
+    {
+      vec_eng_libc_format (fmt, &s->conv, "", c);
+      for (i = 0; i < lanes; i++)
+	{
+	  if (i > 0)
+	    vec_out_put (k, " ", 1);
+	  vec_out_libc (k, fmt, s->conv.width, s->conv.prec,
+			size == 8 ? v->d[i] : (double) v->f[i]);
+	}
+      return;
+    }
+
+  vec_eng_libc_format (fmt, &s->conv, c == 'c' ? "" : "ll", c);
+  if (size == 16)
+    {
+      /* The two doublewords of each back to back, most significant
+	 first.  */
+      for (i = 0; i < lanes; i++)
+	{
+	  if (i > 0)
+	    vec_out_put (k, " ", 1);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	  vec_out_libc (k, fmt, s->conv.width, s->conv.prec,
+			v->ull[2 * i + 1]);
+	  vec_out_libc (k, fmt, s->conv.width, s->conv.prec, v->ull[2 * i]);
+#else
+	  vec_out_libc (k, fmt, s->conv.width, s->conv.prec, v->ull[2 * i]);
+	  vec_out_libc (k, fmt, s->conv.width, s->conv.prec,
+			v->ull[2 * i + 1]);
+#endif
+	}
+      return;
+    }
+  for (i = 0; i < lanes; i++)
+    {
+      int is_signed = (c == 'd' || c == 'i');
+      long long lane;
+
+      if (i > 0 && c != 'c')
+	vec_out_put (k, " ", 1);
+      switch (size)
+	{
+	case 1:
+	  lane = is_signed ? v->sc[i] : v->uc[i];
+	  break;
+	case 2:
+	  lane = is_signed ? (short) v->sh[i] : (unsigned short) v->sh[i];
+	  break;
+	case 4:
+	  lane = is_signed ? (long long) v->si[i] : (long long) v->ui[i];
+	  break;
+	default:
+	  lane = v->sll[i];
+	  break;
+	}
+      if (c == 'c')
+	vec_out_libc (k, fmt, s->conv.width, s->conv.prec, (int) lane);
+      else
+	vec_out_libc (k, fmt, s->conv.width, s->conv.prec, lane);
+    }
+}
+
+/* Store the count of bytes output so far where %n points.  */
+static void
+vec_eng_store_count (const vec_out_t *k, const vec_spec_t *s, void *p)
+{
+  switch (s->len)
+    {
+    case VEC_LEN_HH:
+      *(signed char *) p = k->total;
+      break;
+    case VEC_LEN_H:
+      *(short *) p = k->total;
+      break;
+    case VEC_LEN_L:
+      *(long *) p = k->total;
+      break;
+    case VEC_LEN_LL:
+    case VEC_LEN_BIGL:
+      *(long long *) p = k->total;
+      break;
+    case VEC_LEN_J:
+      *(intmax_t *) p = k->total;
+      break;
+    case VEC_LEN_Z:
+      *(size_t *) p = k->total;
+      break;
+    case VEC_LEN_T:
+      *(ptrdiff_t *) p = k->total;
+      break;
+    default:
+      *(int *) p = k->total;
+      break;
+    }
+}
+
+/* Output the conversion S of the argument A.  */
+static void
+vec_eng_convert (vec_out_t *k, const vec_spec_t *s, const vec_arg_t *a)
+{
+  int c = s->conv.spec;
+  char fmt[32];
+  char *out;
+  int n;
+
+  if (s->type >= VEC_ARG_VEC)
+    {
+      vec_eng_vector (k, s, &a->v);
+      return;
+    }
+
+  switch (c)
+    {
+    case '%':
+      vec_out_put (k, "%", 1);
+      return;
+    case 'n':
+      vec_eng_store_count (k, s, a->p);
+      return;
+    case 's':
+      if (s->len != VEC_LEN_L)
+	{
+	  vec_eng_string (k, s, a->p);
+	  return;
+	}
+      /* Fall through.  */
+    case 'S':
+      vec_eng_libc_format (fmt, &s->conv, "l", 's');
+      vec_out_libc (k, fmt, s->conv.width, s->conv.prec, a->p);
+      return;
+    case 'm':
+      /* libc knows what it prints for the error, and "%#m" prints its name
+	 where libc has one for it, as glibc 2.35 and later do.  */
+      vec_eng_libc_format (fmt, &s->conv, "", 'm');
+      errno = k->saved_errno;
+      vec_out_libc (k, fmt, s->conv.width, s->conv.prec);
+      return;
+    case 'c':
+      if (s->type != VEC_ARG_WINT)
+	break;
+      /* Fall through.  */
+    case 'C':
+      vec_eng_libc_format (fmt, &s->conv, "l", 'c');
+      vec_out_libc (k, fmt, s->conv.width, s->conv.prec, a->wc);
+      return;
+    case 'p':
+      if (a->p == NULL)
+	{
+	  vec_spec_t nil = *s;
+	  nil.conv.prec = -1;
+	  vec_eng_string (k, &nil, "(nil)");
+	  return;
+	}
+      break;
+    }
+
+  if (s->type == VEC_ARG_DOUBLE || s->type == VEC_ARG_LDOUBLE)
+    {
+      if (s->type == VEC_ARG_DOUBLE && c != 'a' && c != 'A'
+	  && vec_eng_use_kernel (k, s, 1))
+	{
+	  out = vec_out_reserve (k, VEC_FP_LANE_MAXLEN);
+	  if (out != NULL)
+	    vec_out_commit (k, out, __vecpf_fmt_fp (out, a->d, &s->conv));
+	}
+      else if (s->type == VEC_ARG_LDOUBLE)
+	{
+	  vec_eng_libc_format (fmt, &s->conv, "L", c);
+	  vec_out_libc (k, fmt, s->conv.width, s->conv.prec, a->ld);
+	}
+      else
+	{
+	  vec_eng_libc_format (fmt, &s->conv, "", c);
+	  vec_out_libc (k, fmt, s->conv.width, s->conv.prec, a->d);
+	}
+      return;
+    }
+
+  /* d, i, o, u, x, X, c and p.  */
+  {
+    vecpf_conv_t conv = s->conv;
+    unsigned long long mag;
+    int negative = 0;
+
+    if (c == 'p')
+      mag = (uintptr_t) a->p;
+    else if (c == 'c')
+      mag = (unsigned char) a->ll;
+    else
+      mag = vec_eng_int (s, a, &negative);
+
+    if (vec_eng_use_kernel (k, s, 0))
+      {
+	out = vec_out_reserve (k, VEC_INT_LANE_MAXLEN / 2);
+	if (out != NULL)
+	  {
+	    n = __vecpf_fmt_int (out, mag, negative, &conv);
+	    vec_out_commit (k, out, n);
+	  }
+      }
+    else
+      {
+	vec_eng_libc_format (fmt, &conv, c == 'c' || c == 'p' ? "" : "ll",
+			     conv.spec);
+	if (c == 'c')
+	  vec_out_libc (k, fmt, conv.width, conv.prec, (int) mag);
+	else if (c == 'p')
+	  vec_out_libc (k, fmt, conv.width, conv.prec, a->p);
+	else
+	  vec_out_libc (k, fmt, conv.width, conv.prec,
+			negative ? -(long long) mag : (long long) mag);
+      }
+  }
+}
+
+/* A '*' width or precision: a negative width is the '-' flag and a
+   positive one, and a negative precision is none.  */
+static void
+vec_eng_star (vec_spec_t *s, int width, int prec)
+{
+  if (s->width_arg >= 0)
+    {
+      if (width < 0)
+	{
+	  s->conv.left = 1;
+	  width = width == INT_MIN ? INT_MAX : -width;
+	}
+      s->conv.width = width;
+    }
+  if (s->prec_arg >= 0)
+    s->conv.prec = prec < 0 ? -1 : prec;
+}
+
+/* The type of every argument the positional format FMT refers to, in
+   *TYPES, and how many there are in *NARGS.  Returns 0, or -1 with errno
+   set if FMT mixes positional and sequential arguments or there is no
+   memory.  */
+static int
+vec_eng_arg_types (const char *fmt, unsigned char **types, int *nargs)
+{
+  unsigned char *t = NULL;
+  int max = 0;
+  const char *p;
+  vec_spec_t s;
+  int i;
+
+  for (p = fmt; *(p = vec_eng_find (p)) != '\0';)
+    {
+      int want[3], type[3];
+
+      p = vec_eng_parse (p + 1, &s);
+      if (s.type == VEC_ARG_INVALID || s.type == VEC_ARG_NONE)
+	continue;
+      want[0] = s.arg;
+      type[0] = s.type;
+      want[1] = s.width_arg;
+      want[2] = s.prec_arg;
+      type[1] = type[2] = VEC_ARG_INT;
+      if (s.arg == 0 || s.width_arg == 0 || s.prec_arg == 0)
+	{
+	  /* Positional and sequential arguments don't mix.  */
+	  free (t);
+	  errno = EINVAL;
+	  return -1;
+	}
+      for (i = 0; i < 3; i++)
+	{
+	  if (want[i] <= 0)
+	    continue;
+	  if (want[i] > max)
+	    {
+	      unsigned char *n = realloc (t, want[i]);
+	      if (n == NULL)
+		{
+		  free (t);
+		  return -1;
+		}
+	      memset (n + max, VEC_ARG_INT, want[i] - max);
+	      t = n;
+	      max = want[i];
+	    }
+	  t[want[i] - 1] = type[i];
+	}
+    }
+
+  *types = t;
+  *nargs = max;
+  return 0;
+}
+
+/* Run the positional format FMT, which starts with its first conversion:
+   collect the type of every argument, fetch them all in order, then
+   output.  */
+static void
+vec_eng_run_positional (vec_out_t *k, const char *fmt, va_list *ap)
+{
+  unsigned char *types;
+  vec_arg_t *args;
+  const char *p;
+  vec_spec_t s;
+  int nargs, i;
+
+  if (vec_eng_arg_types (fmt, &types, &nargs) < 0)
+    {
+      k->error = 1;
+      return;
+    }
+  args = malloc ((nargs > 0 ? nargs : 1) * sizeof (*args));
+  if (args == NULL)
+    {
+      free (types);
+      k->error = 1;
+      return;
+    }
+  for (i = 0; i < nargs; i++)
+    vec_eng_fetch (types[i], ap, &args[i]);
+
+  for (p = fmt;;)
+    {
+      const char *pct = vec_eng_find (p);
+
+      if (pct > p)
+	vec_out_put (k, p, pct - p);
+      if (*pct == '\0')
+	break;
+      p = vec_eng_parse (pct + 1, &s);
+      if (s.type == VEC_ARG_INVALID)
+	{
+	  vec_out_put (k, pct, p - pct);
+	  continue;
+	}
+      vec_eng_star (&s, s.width_arg > 0 ? (int) args[s.width_arg - 1].ll : 0,
+		    s.prec_arg > 0 ? (int) args[s.prec_arg - 1].ll : 0);
+      vec_eng_convert (k, &s, s.arg > 0 ? &args[s.arg - 1] : NULL);
+    }
+
+  free (args);
+  free (types);
+}
+
+static void
+vec_eng_run (vec_out_t *k, const char *fmt, va_list *ap)
+{
+  const char *p = fmt;
+  vec_spec_t s;
+  vec_arg_t a;
+
+  for (;;)
+    {
+      const char *pct = vec_eng_find (p);
+      int width = 0, prec = 0;
+
+      if (pct > p)
+	vec_out_put (k, p, pct - p);
+      if (*pct == '\0')
+	return;
+
+      p = vec_eng_parse (pct + 1, &s);
+      if (s.arg > 0)
+	{
+	  vec_eng_run_positional (k, pct, ap);
+	  return;
+	}
+      if (s.type == VEC_ARG_INVALID)
+	{
+	  vec_out_put (k, pct, p - pct);
+	  continue;
+	}
+      if (s.width_arg >= 0)
+	width = va_arg (*ap, int);
+      if (s.prec_arg >= 0)
+	prec = va_arg (*ap, int);
+      vec_eng_star (&s, width, prec);
+      vec_eng_fetch (s.type, ap, &a);
+      vec_eng_convert (k, &s, &a);
+    }
+}
+
+/* The return value of the printf family for K.  */
+static int
+vec_eng_result (const vec_out_t *k)
+{
+  if (k->error)
+    return -1;
+  if (k->total > INT_MAX)
+    {
+      errno = EOVERFLOW;
+      return -1;
+    }
+  return (int) k->total;
+}
+
+int
+vecpf_vsnprintf (char *buf, size_t size, const char *fmt, va_list ap)
+{
+  vec_out_t k;
+  va_list aq;
+
+  vec_out_init (&k, buf, size, NULL);
+  va_copy (aq, ap);
+  vec_eng_run (&k, fmt, &aq);
+  va_end (aq);
+
+  if (size > 0)
+    buf[k.pos] = '\0';
+  return vec_eng_result (&k);
+}
+
+int
+vecpf_snprintf (char *buf, size_t size, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, fmt);
+  n = vecpf_vsnprintf (buf, size, fmt, ap);
+  va_end (ap);
+  return n;
+}
+
+int
+vecpf_vfprintf (FILE *fp, const char *fmt, va_list ap)
+{
+  char buf[VEC_ENG_STREAM_BUF];
+  vec_out_t k;
+  va_list aq;
+
+  vec_out_init (&k, buf, sizeof (buf), fp);
+
+  /* One lock for the whole call, as vfprintf takes it.  */
+  flockfile (fp);
+  va_copy (aq, ap);
+  vec_eng_run (&k, fmt, &aq);
+  va_end (aq);
+  vec_out_flush (&k);
+  funlockfile (fp);
+
+  return vec_eng_result (&k);
+}
+
+int
+vecpf_fprintf (FILE *fp, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, fmt);
+  n = vecpf_vfprintf (fp, fmt, ap);
+  va_end (ap);
+  return n;
+}
+
+int
+vecpf_vprintf (const char *fmt, va_list ap)
+{
+  return vecpf_vfprintf (stdout, fmt, ap);
+}
+
+int
+vecpf_printf (const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, fmt);
+  n = vecpf_vfprintf (stdout, fmt, ap);
+  va_end (ap);
+  return n;
+}
+
+/* Compiled formats.
+
+   vecpf_compile parses a format once into a plan: a copy of the format,
+   and a step for every conversion in it with the literal text before the
+   conversion and its parsed specification.  Running a plan is
+   vec_eng_run without the parsing.  The types of positional arguments
+   are collected when the plan is compiled too, and its worst case output
+   is summed up from the conversions.  Nothing writes to a plan after
+   vecpf_compile returns it, so any number of threads can run one at
+   once.  */
+
+/* The literal text before a conversion, as an offset into the plan's copy
+   of the format, and the conversion.  A step whose type is
+   VEC_ARG_INVALID has only the text.  */
+typedef struct
+{
+  size_t text;
+  size_t len;
+  vec_spec_t s;
+} vec_step_t;
+
+struct vecpf_plan
+{
+  char *fmt;			/* The copy of the format.  */
+  unsigned char *types;		/* Of the positional arguments.  */
+  int nargs;			/* 0 for sequential arguments.  */
+  size_t maxlen;
+  size_t nsteps;
+  vec_step_t steps[];
+};
+
+/* Positional arguments up to this many are fetched onto the stack.  */
+#define VEC_PLAN_LOCAL_ARGS  16
+
+/* The most the conversion S outputs, or SIZE_MAX if nothing in S bounds
+   it: a string without a precision, a '*' width or precision, long
+   double, or digit groups in whatever the locale turns out to be.  */
+static size_t
+vec_plan_spec_maxlen (const vec_spec_t *s)
+{
+  int c = s->conv.spec;
+  int width = s->conv.width;
+  int prec = s->conv.prec;
+  int size;
+
+  /* Keeps the sums below in range.  */
+  if (s->width_arg >= 0 || s->prec_arg >= 0 || s->conv.group
+      || width > INT_MAX / 256 || prec > INT_MAX / 256)
+    return SIZE_MAX;
+
+  switch (s->type)
+    {
+    case VEC_ARG_VEC:
+    case VEC_ARG_VEC256:
+    case VEC_ARG_VEC512:
+      return VECPF_FORMAT_MAXLEN (s->vmod, c, width, prec) - 1;
+    case VEC_ARG_LDOUBLE:
+      return SIZE_MAX;
+    case VEC_ARG_DOUBLE:
+      return VECPF_LANE_MAXLEN (8, c, width, prec);
+    case VEC_ARG_WINT:
+      return width > MB_LEN_MAX ? width : MB_LEN_MAX;
+    case VEC_ARG_NONE:
+    case VEC_ARG_PTR:
+      if (c == 'n')
+	return 0;
+      if (c == 'p')
+	/* One more for a '+' or ' ' before the "0x".  */
+	return VECPF_LANE_MAXLEN ((int) sizeof (void *), 'x', width, prec) + 1;
+      /* s, S and m.  */
+      if (prec < 0)
+	return SIZE_MAX;
+      return width > prec ? width : prec;
+    }
+
+  if (c == 'c')
+    return width > 1 ? width : 1;
+  size = s->len == VEC_LEN_HH ? 1 : s->len == VEC_LEN_H ? 2
+    : s->len == VEC_LEN_NONE ? 4 : 8;
+  return VECPF_LANE_MAXLEN (size, c, width, prec);
+}
+
+vecpf_plan_t *
+vecpf_compile (const char *fmt)
+{
+  size_t len = strlen (fmt);
+  size_t npct = 0;
+  size_t i, maxlen;
+  vecpf_plan_t *plan;
+  vec_step_t *step;
+  const char *p;
+  int positional = 0;
+
+  /* A step for every '%' at most, and one for the text after the last.  */
+  for (p = fmt; *(p = vec_eng_find (p)) != '\0'; p++)
+    npct++;
+  plan = malloc (sizeof (*plan) + (npct + 1) * sizeof (plan->steps[0])
+		 + len + 1);
+  if (plan == NULL)
+    return NULL;
+  plan->fmt = (char *) &plan->steps[npct + 1];
+  memcpy (plan->fmt, fmt, len + 1);
+  plan->types = NULL;
+  plan->nargs = 0;
+
+  step = plan->steps;
+  step->text = 0;
+  for (p = plan->fmt;;)
+    {
+      const char *start = plan->fmt + step->text;
+      const char *pct = vec_eng_find (p);
+
+      step->len = pct - start;
+      if (*pct == '\0')
+	{
+	  step->s.type = VEC_ARG_INVALID;
+	  break;
+	}
+      p = vec_eng_parse (pct + 1, &step->s);
+      if (step->s.type == VEC_ARG_INVALID)
+	/* Printed as it stands, so it is part of the text.  */
+	continue;
+      if (step->s.conv.spec == '%')
+	{
+	  /* The text up to the first '%' of the two.  */
+	  step->len = pct + 1 - start;
+	  step->s.type = VEC_ARG_INVALID;
+	}
+      else if (step->s.arg > 0)
+	positional = 1;
+      step++;
+      step->text = p - plan->fmt;
+    }
+  plan->nsteps = step - plan->steps + 1;
+
+  if (positional
+      && vec_eng_arg_types (plan->fmt, &plan->types, &plan->nargs) < 0)
+    {
+      free (plan);
+      return NULL;
+    }
+
+  /* The null byte and the text, then the conversions.  */
+  maxlen = 1;
+  for (i = 0; i < plan->nsteps; i++)
+    {
+      size_t n = plan->steps[i].len;
+
+      if (plan->steps[i].s.type != VEC_ARG_INVALID)
+	{
+	  size_t conv = vec_plan_spec_maxlen (&plan->steps[i].s);
+
+	  n = conv > SIZE_MAX - n ? SIZE_MAX : n + conv;
+	}
+      maxlen = n > SIZE_MAX - maxlen ? SIZE_MAX : maxlen + n;
+    }
+  plan->maxlen = maxlen;
+
+  return plan;
+}
+
+void
+vecpf_plan_free (vecpf_plan_t *plan)
+{
+  if (plan == NULL)
+    return;
+  free (plan->types);
+  free (plan);
+}
+
+size_t
+vecpf_plan_maxlen (const vecpf_plan_t *plan)
+{
+  return plan->maxlen;
+}
+
+static void
+vec_plan_run (vec_out_t *k, const vecpf_plan_t *plan, va_list *ap)
+{
+  vec_arg_t local[VEC_PLAN_LOCAL_ARGS];
+  vec_arg_t *args = NULL;
+  size_t i;
+  int j;
+
+  if (plan->nargs > 0)
+    {
+      if (plan->nargs <= VEC_PLAN_LOCAL_ARGS)
+	args = local;
+      else if ((args = malloc (plan->nargs * sizeof (*args))) == NULL)
+	{
+	  k->error = 1;
+	  return;
+	}
+      for (j = 0; j < plan->nargs; j++)
+	vec_eng_fetch (plan->types[j], ap, &args[j]);
+    }
+
+  for (i = 0; i < plan->nsteps; i++)
+    {
+      const vec_step_t *step = &plan->steps[i];
+      const vec_spec_t *s = &step->s;
+      vec_spec_t star;
+      vec_arg_t a;
+
+      if (step->len > 0)
+	vec_out_put (k, plan->fmt + step->text, step->len);
+      if (s->type == VEC_ARG_INVALID)
+	continue;
+
+      if (args != NULL)
+	{
+	  if (s->width_arg > 0 || s->prec_arg > 0)
+	    {
+	      star = *s;
+	      vec_eng_star (&star,
+			    s->width_arg > 0 ? (int) args[s->width_arg - 1].ll
+			    : 0,
+			    s->prec_arg > 0 ? (int) args[s->prec_arg - 1].ll
+			    : 0);
+	      s = &star;
+	    }
+	  vec_eng_convert (k, s, s->arg > 0 ? &args[s->arg - 1] : NULL);
+	  continue;
+	}
+
+      if (s->width_arg >= 0 || s->prec_arg >= 0)
+	{
+	  int width = 0, prec = 0;
+
+	  if (s->width_arg >= 0)
+	    width = va_arg (*ap, int);
+	  if (s->prec_arg >= 0)
+	    prec = va_arg (*ap, int);
+	  star = *s;
+	  vec_eng_star (&star, width, prec);
+	  s = &star;
+	}
+      vec_eng_fetch (s->type, ap, &a);
+      vec_eng_convert (k, s, &a);
+    }
+
+  if (args != local)
+    free (args);
+}
+
+int
+vecpf_vsprint (const vecpf_plan_t *plan, char *buf, size_t size,
+	       va_list ap)
+{
+  vec_out_t k;
+  va_list aq;
+
+  vec_out_init (&k, buf, size, NULL);
+  va_copy (aq, ap);
+  vec_plan_run (&k, plan, &aq);
+  va_end (aq);
+
+  if (size > 0)
+    buf[k.pos] = '\0';
+  return vec_eng_result (&k);
+}
+
+int
+vecpf_sprint (const vecpf_plan_t *plan, char *buf, size_t size, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, size);
+  n = vecpf_vsprint (plan, buf, size, ap);
+  va_end (ap);
+  return n;
+}
+
+int
+vecpf_vprint (const vecpf_plan_t *plan, FILE *fp, va_list ap)
+{
+  char buf[VEC_ENG_STREAM_BUF];
+  vec_out_t k;
+  va_list aq;
+
+  vec_out_init (&k, buf, sizeof (buf), fp);
+
+  flockfile (fp);
+  va_copy (aq, ap);
+  vec_plan_run (&k, plan, &aq);
+  va_end (aq);
+  vec_out_flush (&k);
+  funlockfile (fp);
+
+  return vec_eng_result (&k);
+}
+
+int
+vecpf_print (const vecpf_plan_t *plan, FILE *fp, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, fp);
+  n = vecpf_vprint (plan, fp, ap);
+  va_end (ap);
+  return n;
+}
@@ -0,0 +1,737 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+#include <langinfo.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "vecpf_priv.h"
+
+/* Floating point lane kernels for the f, F, e, E, g and G conversions.
+
+   Every finite double is m * 2^e2 for integers m and e2, so its decimal
+   expansion is finite and can be computed exactly: for e2 >= 0 it is the
+   integer m << e2, and for e2 < 0 it is m * 5^-e2 with the decimal point
+   moved -e2 places to the left.  We compute those digits exactly, round
+   them once at the requested position (round half to even, as glibc does
+   in the default rounding mode), and lay them out.  The result is the
+   correctly rounded output glibc produces, at any precision.
+
+   The digits are kept as a string D of N digits plus a decimal exponent
+   DEXP such that the value is 0.D * 10^DEXP.  Zero is N == 0.
+
+   The common cases never touch the big integer code: zero, integral values
+   below 2^64, and values whose m * 5^-e2 fits in 128 bits (which covers
+   most single precision lanes) are converted with native integers.  */
+
+/* Largest number of significant decimal digits a double can expand to is
+   767, for the largest subnormal.  */
+#define FP_DIGITS_MAXLEN 800
+
+/* Big integers are little endian arrays of base 10^9 limbs.  2^1024 needs
+   35 limbs and 2^53 * 5^1074 needs 86.  */
+#define BIG_BASE  1000000000U
+#define BIG_LIMBS 90
+
+typedef struct
+{
+  int n;
+  uint32_t limb[BIG_LIMBS];
+} bigint_t;
+
+typedef struct
+{
+  char d[FP_DIGITS_MAXLEN];
+  int n;
+  int dexp;
+} fp_digits_t;
+
+static void
+big_set_u64 (bigint_t *b, uint64_t v)
+{
+  b->n = 0;
+  do
+    {
+      b->limb[b->n++] = v % BIG_BASE;
+      v /= BIG_BASE;
+    }
+  while (v != 0);
+}
+
+static void
+big_mul_small (bigint_t *b, uint32_t m)
+{
+  uint64_t carry = 0;
+  int i;
+
+  for (i = 0; i < b->n; i++)
+    {
+      uint64_t t = (uint64_t) b->limb[i] * m + carry;
+      b->limb[i] = t % BIG_BASE;
+      carry = t / BIG_BASE;
+    }
+  while (carry != 0)
+    {
+      b->limb[b->n++] = carry % BIG_BASE;
+      carry /= BIG_BASE;
+    }
+}
+
+static void
+big_mul_pow2 (bigint_t *b, int k)
+{
+  for (; k >= 29; k -= 29)
+    big_mul_small (b, 1U << 29);
+  if (k > 0)
+    big_mul_small (b, 1U << k);
+}
+
+static void
+big_mul_pow5 (bigint_t *b, int k)
+{
+  static const uint32_t pow5[13] =
+    { 1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125, 9765625,
+      48828125, 244140625 };
+
+  for (; k >= 13; k -= 13)
+    big_mul_small (b, 1220703125U);	/* 5^13 */
+  if (k > 0)
+    big_mul_small (b, pow5[k]);
+}
+
+/* Append the decimal digits of B to OUT, returning the count.  */
+static int
+big_to_digits (const bigint_t *b, char *out)
+{
+  char tmp[9];
+  int i, j, len = 0;
+  uint32_t v = b->limb[b->n - 1];
+
+  j = 9;
+  do
+    {
+      tmp[--j] = '0' + v % 10;
+      v /= 10;
+    }
+  while (v != 0);
+  memcpy (out, tmp + j, 9 - j);
+  len = 9 - j;
+
+  for (i = b->n - 2; i >= 0; i--)
+    {
+      v = b->limb[i];
+      for (j = 8; j >= 0; j--)
+	{
+	  out[len + j] = '0' + v % 10;
+	  v /= 10;
+	}
+      len += 9;
+    }
+  return len;
+}
+
+static int
+u64_to_digits (uint64_t v, char *out)
+{
+  char tmp[20];
+  int j = 20;
+
+  do
+    {
+      tmp[--j] = '0' + v % 10;
+      v /= 10;
+    }
+  while (v != 0);
+  memcpy (out, tmp + j, 20 - j);
+  return 20 - j;
+}
+
+static int
+u128_to_digits (unsigned __int128 v, char *out)
+{
+  char tmp[40];
+  int j = 40;
+
+  /* Peel off 19 digits at a time so the inner loop stays in 64 bits.  */
+  while (v >> 64 != 0)
+    {
+      uint64_t lo = v % 10000000000000000000ULL;
+      int k;
+      v /= 10000000000000000000ULL;
+      for (k = 0; k < 19; k++)
+	{
+	  tmp[--j] = '0' + lo % 10;
+	  lo /= 10;
+	}
+    }
+  {
+    uint64_t hi = (uint64_t) v;
+    do
+      {
+	tmp[--j] = '0' + hi % 10;
+	hi /= 10;
+      }
+    while (hi != 0);
+  }
+  memcpy (out, tmp + j, 40 - j);
+  return 40 - j;
+}
+
+/* Exact decimal expansion of the finite, nonzero, positive X.  */
+static void
+fp_exact_digits (double x, fp_digits_t *fd)
+{
+  uint64_t bits, m;
+  int e2, biased;
+
+  memcpy (&bits, &x, sizeof (bits));
+  biased = (bits >> 52) & 0x7ff;
+  m = bits & ((1ULL << 52) - 1);
+  if (biased == 0)
+    e2 = -1074;
+  else
+    {
+      m |= 1ULL << 52;
+      e2 = biased - 1075;
+    }
+
+  /* Fewer powers of five to multiply by if m is made odd first.  */
+  while ((m & 1) == 0 && e2 < 0)
+    {
+      m >>= 1;
+      e2++;
+    }
+
+  if (e2 >= 0)
+    {
+      if (e2 < 11)
+	fd->n = u64_to_digits (m << e2, fd->d);
+      else
+	{
+	  bigint_t b;
+	  big_set_u64 (&b, m);
+	  big_mul_pow2 (&b, e2);
+	  fd->n = big_to_digits (&b, fd->d);
+	}
+      fd->dexp = fd->n;
+    }
+  else
+    {
+      int k = -e2;
+
+      /* 5^55 > 2^127, so anything below that with a small enough m is
+	 done in one 128 bit multiply.  */
+      if (k <= 54)
+	{
+	  unsigned __int128 p5 = 1;
+	  int i;
+	  for (i = 0; i < k; i++)
+	    p5 *= 5;
+	  if (m <= ~(unsigned __int128) 0 / p5)
+	    {
+	      fd->n = u128_to_digits (p5 * m, fd->d);
+	      fd->dexp = fd->n - k;
+	      return;
+	    }
+	}
+
+      {
+	bigint_t b;
+	big_set_u64 (&b, m);
+	big_mul_pow5 (&b, k);
+	fd->n = big_to_digits (&b, fd->d);
+	fd->dexp = fd->n - k;
+      }
+    }
+}
+
+/* Powers of ten and five that fit in 64 bits.  */
+static const uint64_t pow10_u64[20] =
+  { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL };
+
+#define FP_POW5_MAX 27
+
+static const uint64_t pow5_u64[FP_POW5_MAX + 1] =
+  { 1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL,
+    390625ULL, 1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL,
+    1220703125ULL, 6103515625ULL, 30517578125ULL, 152587890625ULL,
+    762939453125ULL, 3814697265625ULL, 19073486328125ULL,
+    95367431640625ULL, 476837158203125ULL, 2384185791015625ULL,
+    11920928955078125ULL, 59604644775390625ULL, 298023223876953125ULL,
+    1490116119384765625ULL, 7450580596923828125ULL };
+
+static inline int
+u128_bits (unsigned __int128 v)
+{
+  uint64_t hi = v >> 64;
+
+  if (hi != 0)
+    return 128 - __builtin_clzll (hi);
+  return (uint64_t) v == 0 ? 0 : 64 - __builtin_clzll ((uint64_t) v);
+}
+
+/* Set *Q to M * 2^E2 * 10^S rounded to an integer, half to even.  Returns
+   zero instead if that cannot be done exactly in 128 bit arithmetic or
+   the result would not fit in 64 bits.  */
+static int
+fp_scaled (uint64_t m, int e2, int s, uint64_t *q)
+{
+  unsigned __int128 num = m, den = 1, qq, rem;
+  int t = e2 + s;
+
+  if (s > FP_POW5_MAX || s < -FP_POW5_MAX)
+    return 0;
+  if (s >= 0)
+    num *= pow5_u64[s];
+  else
+    den = pow5_u64[-s];
+
+  if (t >= 0)
+    {
+      if (u128_bits (num) + t > 126)
+	return 0;
+      num <<= t;
+    }
+  else
+    {
+      if (u128_bits (den) - t > 126)
+	return 0;
+      den <<= -t;
+    }
+
+  if (den == 1)
+    {
+      qq = num;
+      rem = 0;
+    }
+  else if (s >= 0)
+    {
+      /* DEN is a power of two.  */
+      qq = num >> -t;
+      rem = num & (den - 1);
+    }
+  else
+    {
+      qq = num / den;
+      rem = num % den;
+    }
+
+  if (rem * 2 > den || (rem * 2 == den && (qq & 1)))
+    qq++;
+  if (qq > pow10_u64[19])
+    return 0;
+  *q = qq;
+  return 1;
+}
+
+/* The common case of __vecpf_fmt_fp: round the finite, nonzero, positive
+   X to PLACES digits after the decimal point if FIXED, or else to PLACES
+   significant digits, without expanding it in full first.  The result is
+   what fp_exact_digits followed by fp_round would give.  Returns zero if
+   X is out of range for it.  */
+static int
+fp_fast_digits (double x, int places, int fixed, fp_digits_t *fd)
+{
+  uint64_t bits, m, q;
+  int e2, s;
+
+  memcpy (&bits, &x, sizeof (bits));
+  if (((bits >> 52) & 0x7ff) == 0)
+    return 0;
+  m = (bits & ((1ULL << 52) - 1)) | (1ULL << 52);
+  e2 = (int) ((bits >> 52) & 0x7ff) - 1075;
+
+  if (fixed)
+    {
+      if (places > 17 || !fp_scaled (m, e2, places, &q))
+	return 0;
+      s = places;
+    }
+  else
+    {
+      /* floor (log10 (2) * B) for the position B of the leading bit is
+	 the decimal exponent of X or one less.  Try the smaller first; a
+	 result with one digit too many means it was the larger.  Rounding
+	 up to 10^PLACES gives the same answer either way.  */
+      int b = e2 + 52;
+      int x10 = (b * 78913) >> 18;
+
+      if (places > 17)
+	return 0;
+      s = places - 1 - x10;
+      if (!fp_scaled (m, e2, s, &q))
+	return 0;
+      if (q >= pow10_u64[places])
+	{
+	  s--;
+	  if (!fp_scaled (m, e2, s, &q))
+	    return 0;
+	}
+      else if (q < pow10_u64[places - 1])
+	return 0;
+    }
+
+  if (q == 0)
+    {
+      fd->n = 0;
+      fd->dexp = 1;
+      return 1;
+    }
+  fd->n = u64_to_digits (q, fd->d);
+  fd->dexp = fd->n - s;
+  return 1;
+}
+
+/* Whether FD is exactly a power of ten.  */
+static int
+fp_is_pow10 (const fp_digits_t *fd)
+{
+  int i;
+
+  if (fd->n == 0 || fd->d[0] != '1')
+    return 0;
+  for (i = 1; i < fd->n; i++)
+    if (fd->d[i] != '0')
+      return 0;
+  return 1;
+}
+
+/* Round FD to KEEP significant digits, half to even.  KEEP may be zero or
+   negative, in which case the result is either zero or a single unit at
+   the rounding position.  */
+static void
+fp_round (fp_digits_t *fd, int keep)
+{
+  int up, i;
+
+  if (keep >= fd->n)
+    return;
+
+  if (keep < 0)
+    {
+      fd->n = 0;
+      return;
+    }
+
+  if (fd->d[keep] > '5')
+    up = 1;
+  else if (fd->d[keep] < '5')
+    up = 0;
+  else
+    {
+      up = 0;
+      for (i = keep + 1; i < fd->n; i++)
+	if (fd->d[i] != '0')
+	  {
+	    up = 1;
+	    break;
+	  }
+      /* An exact tie goes to the even neighbour.  */
+      if (!up && keep > 0)
+	up = (fd->d[keep - 1] - '0') & 1;
+    }
+
+  fd->n = keep;
+  if (!up)
+    return;
+
+  for (i = keep - 1; i >= 0; i--)
+    {
+      if (fd->d[i] != '9')
+	{
+	  fd->d[i]++;
+	  return;
+	}
+      fd->d[i] = '0';
+    }
+
+  /* Carried out of the leading digit: the value is now 10^DEXP.  */
+  fd->d[0] = '1';
+  fd->n = keep > 0 ? keep : 1;
+  fd->dexp++;
+}
+
+/* Digit I of the expansion, counting from the most significant.  */
+static inline char
+fp_digit (const fp_digits_t *fd, int i)
+{
+  return (i >= 0 && i < fd->n) ? fd->d[i] : '0';
+}
+
+/* Lay out FD as [integer].[PREC digits].  FD must already be rounded.  */
+static char *
+emit_fixed (char *p, const fp_digits_t *fd, int prec, int alt)
+{
+  int i;
+
+  if (fd->dexp <= 0)
+    *p++ = '0';
+  else
+    for (i = 0; i < fd->dexp; i++)
+      *p++ = fp_digit (fd, i);
+
+  if (prec > 0 || alt)
+    *p++ = '.';
+
+  for (i = 0; i < prec; i++)
+    *p++ = fp_digit (fd, fd->dexp + i);
+
+  return p;
+}
+
+/* Lay out FD as d.[PREC digits]e+XX.  FD must already be rounded.  */
+static char *
+emit_exp (char *p, const fp_digits_t *fd, int prec, int alt, int upper)
+{
+  int i;
+  int x = fd->n == 0 ? 0 : fd->dexp - 1;
+
+  *p++ = fp_digit (fd, 0);
+  if (prec > 0 || alt)
+    *p++ = '.';
+  for (i = 1; i <= prec; i++)
+    *p++ = fp_digit (fd, i);
+
+  *p++ = upper ? 'E' : 'e';
+  if (x < 0)
+    {
+      *p++ = '-';
+      x = -x;
+    }
+  else
+    *p++ = '+';
+  if (x >= 100)
+    {
+      *p++ = '0' + x / 100;
+      x %= 100;
+    }
+  *p++ = '0' + x / 10;
+  *p++ = '0' + x % 10;
+
+  return p;
+}
+
+/* Drop the trailing zeros of the fraction in [START, END), and the decimal
+   point too if nothing is left after it.  Returns the new end.  */
+static char *
+strip_fraction_zeros (char *start, char *end)
+{
+  char *dot = memchr (start, '.', end - start);
+
+  if (dot == NULL)
+    return end;
+  while (end > dot + 1 && end[-1] == '0')
+    end--;
+  if (end == dot + 1)
+    end--;
+  return end;
+}
+
+int attribute_hidden
+__vecpf_fmt_fp (char *out, double val, const vecpf_conv_t *conv)
+{
+  char body[FP_DIGITS_MAXLEN];
+  char *b = body;
+  char sign = 0;
+  int upper = (conv->spec == 'F' || conv->spec == 'E' || conv->spec == 'G');
+  int is_special = 0;
+  int len, fill, nzeros = 0;
+  char *p = out;
+  uint64_t bits;
+
+  memcpy (&bits, &val, sizeof (bits));
+  if (bits >> 63)
+    {
+      sign = '-';
+      val = -val;
+    }
+  else if (conv->showsign)
+    sign = '+';
+  else if (conv->space)
+    sign = ' ';
+
+  if (val != val || val == __builtin_inf ())
+    {
+      memcpy (b, val != val ? (upper ? "NAN" : "nan")
+			    : (upper ? "INF" : "inf"), 3);
+      b += 3;
+      is_special = 1;
+    }
+  else
+    {
+      fp_digits_t fd;
+      int prec = conv->prec;
+
+      if (val == 0)
+	{
+	  fd.n = 0;
+	  fd.dexp = 1;
+	}
+      else if (val < 18446744073709551616.0 && val == (uint64_t) val)
+	{
+	  fd.n = u64_to_digits ((uint64_t) val, fd.d);
+	  fd.dexp = fd.n;
+	}
+      else if (conv->spec == 'f' || conv->spec == 'F')
+	{
+	  if (!fp_fast_digits (val, prec < 0 ? 6 : prec, 1, &fd))
+	    fp_exact_digits (val, &fd);
+	}
+      else if (conv->spec == 'e' || conv->spec == 'E')
+	{
+	  if (!fp_fast_digits (val, prec < 0 ? 7 : prec + 1, 0, &fd))
+	    fp_exact_digits (val, &fd);
+	}
+      else if (conv->spec == 'g' || conv->spec == 'G')
+	{
+	  /* A result of exactly 10^X may have come from rounding up across
+	     a decade, which the style choice below needs to know about, so
+	     leave those to the exact path.  */
+	  if (!fp_fast_digits (val, prec < 0 ? 6 : prec == 0 ? 1 : prec, 0,
+			       &fd)
+	      || fp_is_pow10 (&fd))
+	    fp_exact_digits (val, &fd);
+	}
+      else
+	fp_exact_digits (val, &fd);
+
+      switch (conv->spec)
+	{
+	case 'f':
+	case 'F':
+	  if (prec < 0)
+	    prec = 6;
+	  fp_round (&fd, fd.dexp + prec);
+	  b = emit_fixed (b, &fd, prec, conv->alt);
+	  break;
+
+	case 'e':
+	case 'E':
+	  if (prec < 0)
+	    prec = 6;
+	  fp_round (&fd, prec + 1);
+	  b = emit_exp (b, &fd, prec, conv->alt, upper);
+	  break;
+
+	default:
+	  {
+	    /* 'g' uses the exponent the value has once rounded to PREC
+	       significant digits to pick between the two styles.  */
+	    int x, x0;
+
+	    if (prec < 0)
+	      prec = 6;
+	    else if (prec == 0)
+	      prec = 1;
+	    x0 = fd.n == 0 ? 0 : fd.dexp - 1;
+	    fp_round (&fd, prec);
+	    x = fd.n == 0 ? 0 : fd.dexp - 1;
+	    if (x < prec && x >= -4)
+	      b = emit_fixed (b, &fd, prec - 1 - x, conv->alt);
+	    else if (x0 < prec && x0 >= -4)
+	      /* Rounding carried into a new decade and pushed the value out
+		 of the fixed range.  glibc keeps the fraction length it
+		 chose for the fixed style, which is none, so "%#.2g" of 99.5
+		 is "1.e+02" rather than "1.0e+02".  Match it.  */
+	      b = emit_exp (b, &fd, 0, conv->alt, upper);
+	    else
+	      b = emit_exp (b, &fd, prec - 1, conv->alt, upper);
+	    if (!conv->alt)
+	      {
+		/* Only the mantissa loses its zeros, never the exponent.  */
+		char *e = memchr (body, upper ? 'E' : 'e', b - body);
+		if (e == NULL)
+		  b = strip_fraction_zeros (body, b);
+		else
+		  {
+		    char *m_end = strip_fraction_zeros (body, e);
+		    memmove (m_end, e, b - e);
+		    b = m_end + (b - e);
+		  }
+	      }
+	    break;
+	  }
+	}
+    }
+
+  len = (sign != 0) + (b - body);
+  fill = conv->width - len;
+
+  /* The '0' flag pads between the sign and the digits, but never for
+     inf and nan.  */
+  if (!conv->left && conv->zero && !is_special && fill > 0)
+    {
+      nzeros = fill;
+      fill = 0;
+    }
+
+  if (!conv->left && fill > 0)
+    {
+      memset (p, ' ', fill);
+      p += fill;
+    }
+  if (sign)
+    *p++ = sign;
+  if (nzeros > 0)
+    {
+      memset (p, '0', nzeros);
+      p += nzeros;
+    }
+  memcpy (p, body, b - body);
+  p += b - body;
+  if (conv->left && fill > 0)
+    {
+      memset (p, ' ', fill);
+      p += fill;
+    }
+
+  return p - out;
+}
+
+/* Whether the calling thread rounds to nearest.  A quarter of an ulp of 1
+   is lost both above and below 1 only then; every other mode moves one of
+   the two sums off 1.  This asks the hardware what fegetround would
+   without pulling in libm, which a static link would then need too.  The
+   volatiles keep the sums from being folded at compile time and, with
+   x87 excess precision, round them to double.  */
+static int
+rounds_to_nearest (void)
+{
+  volatile double one = 1.0, tiny = 0x1p-54;
+  volatile double up = one + tiny, down = one - tiny;
+
+  return up == 1.0 && down == 1.0;
+}
+
+int attribute_hidden
+__vecpf_fp_env_is_c (void)
+{
+  const char *radix = nl_langinfo (RADIXCHAR);
+
+  return (rounds_to_nearest ()
+	  && radix != NULL && radix[0] == '.' && radix[1] == '\0');
+}
@@ -0,0 +1,837 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+#include <string.h>
+
+#include "config.h"
+
+/* With kernel variants configured, this file is also built once for each
+   processor level by a vecpf_int_<level>.c wrapper, and every build names
+   its kernels after its level so that vecpf_isa.c can pick one.  */
+
+#if defined HAVE_ISA_VARIANTS && !defined VECPF_ISA
+# define VECPF_ISA base
+#endif
+#include "vecpf_priv.h"
+
+/* Integer lane kernels.
+
+   These reproduce what glibc's vfprintf does for a single d, i, o, u, x, X
+   or c conversion so that a whole vector can be rendered into one buffer
+   without going back through fprintf for every lane.  The rules, in the
+   order they are applied:
+
+     - The digits of the magnitude are generated in the requested base.  A
+       precision of zero with a zero value produces no digits at all.
+     - The digits are zero extended on the left up to the precision.
+     - '#' with 'o' forces the first digit to be a zero; '#' with 'x' or
+       'X' prefixes "0x" or "0X", but only for a nonzero value.
+     - 'd' and 'i' get a sign: '-' when negative, otherwise '+' for the
+       '+' flag, otherwise ' ' for the ' ' flag.  The unsigned conversions
+       never get a sign.
+     - The '0' flag pads with zeros between the sign/prefix and the digits,
+       but only when there is no precision and no '-' flag.
+     - Anything left over up to the field width is padded with spaces,
+       on the right for '-' and on the left otherwise.
+
+   The 'c' conversion is just the character padded to the field width with
+   spaces.  */
+
+static const char lower_digits[] = "0123456789abcdef";
+static const char upper_digits[] = "0123456789ABCDEF";
+
+/* Longest digit string we can generate: a 64 bit value in octal.  */
+#define DIGITS_MAXLEN 22
+
+static inline char *
+pad (char *out, char c, int n)
+{
+  if (n > 0)
+    {
+      memset (out, c, n);
+      out += n;
+    }
+  return out;
+}
+
+/* Lay out one integer field from its digits.  DP/NDIGITS are the digits of
+   the magnitude without leading zeros; NDIGITS is zero for a zero value.
+   SIGN is the sign character or 0.  Applies the precision, the '#' forms,
+   the '0' flag and the field width for the conversion in CONV.  */
+static int
+fmt_int_layout (char *out, const char *dp, int ndigits, char sign,
+		const vecpf_conv_t *conv)
+{
+  const char *prefix = "";
+  int prefix_len = 0;
+  int is_zero = (ndigits == 0);
+  int nzeros, len, fill;
+  char *start = out;
+
+  /* Without an explicit precision a zero value still prints one digit.  */
+  if (ndigits == 0 && conv->prec != 0)
+    dp = "0", ndigits = 1;
+
+  nzeros = conv->prec > ndigits ? conv->prec - ndigits : 0;
+
+  if (conv->alt)
+    {
+      /* "%#o" always starts with a zero, which may come from the
+	 precision; "%#x" prefixes nonzero values only.  */
+      if (conv->spec == 'o')
+	{
+	  if (nzeros == 0 && (ndigits == 0 || *dp != '0'))
+	    nzeros = 1;
+	}
+      else if ((conv->spec == 'x' || conv->spec == 'X') && !is_zero)
+	{
+	  prefix = conv->spec == 'x' ? "0x" : "0X";
+	  prefix_len = 2;
+	}
+    }
+  if (conv->spec == 'p')
+    {
+      prefix = "0x";
+      prefix_len = 2;
+    }
+
+  len = (sign != 0) + prefix_len + nzeros + ndigits;
+  fill = conv->width - len;
+
+  if (!conv->left && conv->zero && conv->prec < 0 && fill > 0)
+    {
+      nzeros += fill;
+      fill = 0;
+    }
+
+  if (!conv->left)
+    out = pad (out, ' ', fill);
+  if (sign)
+    *out++ = sign;
+  memcpy (out, prefix, prefix_len);
+  out += prefix_len;
+  out = pad (out, '0', nzeros);
+  memcpy (out, dp, ndigits);
+  out += ndigits;
+  if (conv->left)
+    out = pad (out, ' ', fill);
+
+  return out - start;
+}
+
+int attribute_hidden
+__vecpf_fmt_int (char *out, unsigned long long mag, int negative,
+		 const vecpf_conv_t *conv)
+{
+  char digits[DIGITS_MAXLEN];
+  char *dp = digits + DIGITS_MAXLEN;
+  char sign = 0;
+
+  if (conv->spec == 'c')
+    {
+      char *start = out;
+      int fill = conv->width - 1;
+      if (!conv->left)
+	out = pad (out, ' ', fill);
+      *out++ = (char) mag;
+      if (conv->left)
+	out = pad (out, ' ', fill);
+      return out - start;
+    }
+
+  switch (conv->spec)
+    {
+    case 'p':
+      /* glibc prints a pointer as "%#x" would, but keeps the '+' and ' '
+	 flags.  */
+      if (conv->showsign)
+	sign = '+';
+      else if (conv->space)
+	sign = ' ';
+      /* Fall through.  */
+    case 'x':
+    case 'X':
+      {
+	const char *tab = conv->spec == 'X' ? upper_digits : lower_digits;
+	while (mag != 0)
+	  {
+	    *--dp = tab[mag & 0xf];
+	    mag >>= 4;
+	  }
+	break;
+      }
+    case 'o':
+      while (mag != 0)
+	{
+	  *--dp = '0' + (mag & 0x7);
+	  mag >>= 3;
+	}
+      break;
+    default:
+      while (mag != 0)
+	{
+	  *--dp = '0' + (mag % 10);
+	  mag /= 10;
+	}
+      if (conv->spec == 'd' || conv->spec == 'i')
+	{
+	  if (negative)
+	    sign = '-';
+	  else if (conv->showsign)
+	    sign = '+';
+	  else if (conv->space)
+	    sign = ' ';
+	}
+      break;
+    }
+
+  return fmt_int_layout (out, dp, digits + DIGITS_MAXLEN - dp, sign, conv);
+}
+
+/* Vector kernels for the o, x and X conversions.
+
+   The hex kernel expands the whole 16 byte register at once: the high and
+   low nibbles of every byte are split into two vectors, one permute
+   interleaves them into 32 digit values in print order (most significant
+   nibble of each lane first, whatever the endianness), and a second
+   permute against "0123456789abcdef" turns the values into characters.
+   On VMX both permutes are a single vperm.
+
+   The octal kernel cannot work on nibbles since octal digits straddle
+   byte boundaries, so it shifts all lanes of the register right by three
+   bits per digit position instead, one vector operation per digit.
+
+   Either way the result is a fixed width digit string per lane, from
+   which the leading zeros are dropped before it goes through
+   fmt_int_layout, so every flag combination is handled the same way as
+   in the scalar path.  */
+
+typedef unsigned short v8u16_t __attribute__ ((vector_size (16)));
+typedef unsigned int v4u32_t __attribute__ ((vector_size (16)));
+typedef unsigned long long v2u64_t __attribute__ ((vector_size (16)));
+
+/* Permute control for the nibble interleave, indexed by log2 of the lane
+   size.  Elements 0-15 select from the high nibbles and 16-31 from the low
+   nibbles of the corresponding byte.  */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static const v16u8_t hex_perm[4][2] =
+{
+  {{ 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23 },
+   { 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31 }},
+  {{ 1, 17, 0, 16, 3, 19, 2, 18, 5, 21, 4, 20, 7, 23, 6, 22 },
+   { 9, 25, 8, 24, 11, 27, 10, 26, 13, 29, 12, 28, 15, 31, 14, 30 }},
+  {{ 3, 19, 2, 18, 1, 17, 0, 16, 7, 23, 6, 22, 5, 21, 4, 20 },
+   { 11, 27, 10, 26, 9, 25, 8, 24, 15, 31, 14, 30, 13, 29, 12, 28 }},
+  {{ 7, 23, 6, 22, 5, 21, 4, 20, 3, 19, 2, 18, 1, 17, 0, 16 },
+   { 15, 31, 14, 30, 13, 29, 12, 28, 11, 27, 10, 26, 9, 25, 8, 24 }},
+};
+#else
+/* Big endian lanes are already most significant byte first.  */
+static const v16u8_t hex_perm_be[2] =
+{
+  { 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23 },
+  { 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31 },
+};
+#endif
+
+static inline int
+log2_size (int element_size)
+{
+  return element_size == 1 ? 0 : element_size == 2 ? 1
+	 : element_size == 4 ? 2 : 3;
+}
+
+/* Expand the 16 bytes at V into 32 hex digits in print order.  */
+static void
+hex_expand (char *digits, const void *v, int element_size, int upper)
+{
+  v16u8_t bytes, hi, lo, d0, d1;
+  v16u8_t tab;
+
+  memcpy (&bytes, v, sizeof (bytes));
+  memcpy (&tab, upper ? upper_digits : lower_digits, sizeof (tab));
+
+  hi = bytes >> 4;
+  lo = bytes & 0xf;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  d0 = __builtin_shuffle (hi, lo, hex_perm[log2_size (element_size)][0]);
+  d1 = __builtin_shuffle (hi, lo, hex_perm[log2_size (element_size)][1]);
+#else
+  (void) element_size;
+  d0 = __builtin_shuffle (hi, lo, hex_perm_be[0]);
+  d1 = __builtin_shuffle (hi, lo, hex_perm_be[1]);
+#endif
+
+  d0 = __builtin_shuffle (tab, d0);
+  d1 = __builtin_shuffle (tab, d1);
+
+  memcpy (digits, &d0, 16);
+  memcpy (digits + 16, &d1, 16);
+}
+
+/* Digits per lane in octal, indexed by log2 of the lane size.  */
+static const int oct_lane_digits[4] = { 3, 6, 11, 22 };
+
+/* Expand the lanes of the 16 bytes at V into octal digits in print order,
+   oct_lane_digits[] per lane.  */
+static void
+oct_expand (char *digits, const void *v, int element_size)
+{
+  int ndig = oct_lane_digits[log2_size (element_size)];
+  int lanes = 16 / element_size;
+  int k, l;
+
+#define OCT_EXPAND(vtype)						\
+  {									\
+    vtype x, d;								\
+    memcpy (&x, v, sizeof (x));						\
+    for (k = 0; k < ndig; k++)						\
+      {									\
+	d = (x & 7) + '0';						\
+	x >>= 3;							\
+	for (l = 0; l < lanes; l++)					\
+	  digits[l * ndig + ndig - 1 - k] = d[l];			\
+      }									\
+  }
+
+  switch (element_size)
+    {
+    case 1:
+      OCT_EXPAND (v16u8_t);
+      break;
+    case 2:
+      OCT_EXPAND (v8u16_t);
+      break;
+    case 4:
+      OCT_EXPAND (v4u32_t);
+      break;
+    default:
+      OCT_EXPAND (v2u64_t);
+      break;
+    }
+
+#undef OCT_EXPAND
+}
+
+int attribute_hidden
+__vecpf_render_radix (char *out, const void *v, int element_size,
+		      int nlanes, const vecpf_conv_t *conv)
+{
+  char digits[3 * VEC_BYTES_MAX];
+  const unsigned char *src = v;
+  char *p = out;
+  int quad = (element_size == 16);
+  int size = quad ? 8 : element_size;
+  int lanes = quad ? 2 * nlanes : nlanes;
+  int per_block = 16 / size;
+  int ndig, b, i;
+
+  /* Every sixteen bytes are expanded in one go, so the digits of a wider
+     vector are all in place before any lane is laid out.  */
+  if (conv->spec == 'o')
+    ndig = oct_lane_digits[log2_size (size)];
+  else
+    ndig = 2 * size;
+  for (b = 0; b * per_block < lanes; b++)
+    {
+      if (conv->spec == 'o')
+	oct_expand (digits + b * per_block * ndig, src + 16 * b, size);
+      else
+	hex_expand (digits + b * per_block * ndig, src + 16 * b, size,
+		    conv->spec == 'X');
+    }
+
+  for (i = 0; i < lanes; i++)
+    {
+      /* A quadword is its two doublewords printed back to back, most
+	 significant first.  */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      int lane = quad ? i ^ 1 : i;
+#else
+      int lane = i;
+#endif
+      const char *dp = digits + lane * ndig;
+      int n = ndig;
+
+      while (n > 0 && *dp == '0')
+	dp++, n--;
+
+      if (i > 0 && (!quad || i % 2 == 0))
+	*p++ = ' ';
+      p += fmt_int_layout (p, dp, n, 0, conv);
+    }
+
+  return p - out;
+}
+
+/* Vector kernels for the d, i and u conversions.
+
+   Byte lanes are looked up in a table of all 256 values pre-rendered.
+
+   Wider lanes are converted four 32 bit lanes at a time.  Each lane is cut
+   into groups of four decimal digits with a reciprocal multiply instead of
+   a divide, x / 10000 == (x * 0xd1b71759) >> 45 for any 32 bit x, and
+   each group into two digit pairs with (g * 5243) >> 19 == g / 100 for
+   g < 10000.  The pairs are then copied out of a 200 byte "00" to "99"
+   table.  Halfwords are widened to words first; doublewords are cut into
+   groups of eight digits and those are fed through the word kernel.  */
+
+typedef signed char v16s8_t __attribute__ ((vector_size (16)));
+typedef signed short v8s16_t __attribute__ ((vector_size (16)));
+typedef signed int v4s32_t __attribute__ ((vector_size (16)));
+typedef unsigned long long v4u64_t __attribute__ ((vector_size (32)));
+
+typedef struct
+{
+  char d[3];		/* Right aligned digits.  */
+  char len;
+} byte_dec_t;
+
+#define BD(n)  {{ '0' + (n) / 100, '0' + (n) / 10 % 10, '0' + (n) % 10 },  \
+		(n) >= 100 ? 3 : (n) >= 10 ? 2 : 1 }
+#define BD4(n)  BD (n), BD ((n) + 1), BD ((n) + 2), BD ((n) + 3)
+#define BD16(n)  BD4 (n), BD4 ((n) + 4), BD4 ((n) + 8), BD4 ((n) + 12)
+#define BD64(n)  BD16 (n), BD16 ((n) + 16), BD16 ((n) + 32), BD16 ((n) + 48)
+
+static const byte_dec_t byte_dec[256] =
+{
+  BD64 (0), BD64 (64), BD64 (128), BD64 (192)
+};
+
+#undef BD64
+#undef BD16
+#undef BD4
+#undef BD
+
+static const char digit_pairs[201] =
+  "00010203040506070809101112131415161718192021222324"
+  "25262728293031323334353637383940414243444546474849"
+  "50515253545556575859606162636465666768697071727374"
+  "75767778798081828384858687888990919293949596979899";
+
+/* Quotient and remainder by 10000 of four 32 bit lanes.  */
+static inline v4u32_t
+div10000 (v4u32_t x, v4u32_t *rem)
+{
+  v4u64_t wide = __builtin_convertvector (x, v4u64_t);
+  v4u32_t q = __builtin_convertvector ((wide * 0xd1b71759ULL) >> 45, v4u32_t);
+  *rem = x - q * 10000;
+  return q;
+}
+
+/* Write the four digits of each lane of G (all below 10000) to
+   OUT + lane * STRIDE.  */
+static inline void
+put_groups (char *out, int stride, v4u32_t g)
+{
+  v4u32_t hi = (g * 5243) >> 19;
+  v4u32_t lo = g - hi * 100;
+  int l;
+
+  for (l = 0; l < 4; l++)
+    {
+      memcpy (out + l * stride, digit_pairs + 2 * hi[l], 2);
+      memcpy (out + l * stride + 2, digit_pairs + 2 * lo[l], 2);
+    }
+}
+
+/* Ten digits per lane for four 32 bit lanes, at OUT + lane * STRIDE.  */
+static void
+dec_expand_u32 (char *out, int stride, v4u32_t x)
+{
+  v4u32_t r0, r1, q;
+  int l;
+
+  q = div10000 (div10000 (x, &r0), &r1);
+  for (l = 0; l < 4; l++)
+    memcpy (out + l * stride, digit_pairs + 2 * q[l], 2);
+  put_groups (out + 2, stride, r1);
+  put_groups (out + 6, stride, r0);
+}
+
+/* Digits per lane the word and doubleword expansions produce.  */
+#define DEC_U32_DIGITS 10
+#define DEC_U64_DIGITS 20
+
+static inline char
+dec_sign (int negative, const vecpf_conv_t *conv)
+{
+  if (conv->spec != 'd' && conv->spec != 'i')
+    return 0;
+  return negative ? '-' : conv->showsign ? '+' : conv->space ? ' ' : 0;
+}
+
+int attribute_hidden
+__vecpf_render_dec (char *out, const void *v, int element_size,
+		    int nlanes, const vecpf_conv_t *conv)
+{
+  char digits[VEC_BYTES_MAX / 2 * DEC_U32_DIGITS];
+  char neg[VEC_BYTES_MAX];
+  const unsigned char *src = v;
+  char *p = out;
+  int is_signed = (conv->spec == 'd' || conv->spec == 'i');
+  int quad = (element_size == 16);
+  int lanes = quad ? 2 * nlanes : nlanes;
+  int ndig, b, i;
+
+  /* The digits of every sixteen bytes are expanded in one go, and the
+     lanes laid out once they all are.  */
+  switch (element_size)
+    {
+    case 1:
+      for (b = 0; 16 * b < nlanes; b++)
+	{
+	  v16u8_t x, m = { 0 };
+	  memcpy (&x, src + 16 * b, sizeof (x));
+	  if (is_signed)
+	    {
+	      m = (v16u8_t) ((v16s8_t) x < 0);
+	      x = (x ^ m) - m;
+	    }
+	  for (i = 0; i < 16 && 16 * b + i < nlanes; i++)
+	    {
+	      const byte_dec_t *bd = &byte_dec[x[i]];
+	      if (b > 0 || i > 0)
+		*p++ = ' ';
+	      p += fmt_int_layout (p, bd->d + 3 - bd->len,
+				   x[i] == 0 ? 0 : bd->len,
+				   dec_sign (m[i] != 0, conv), conv);
+	    }
+	}
+      return p - out;
+
+    case 2:
+      for (b = 0; 8 * b < nlanes; b++)
+	{
+	  v8u16_t x, m = { 0 };
+	  v4u32_t w;
+	  int h;
+	  memcpy (&x, src + 16 * b, sizeof (x));
+	  if (is_signed)
+	    {
+	      m = (v8u16_t) ((v8s16_t) x < 0);
+	      x = (x ^ m) - m;
+	    }
+	  for (h = 0; h < 2; h++)
+	    {
+	      w = (v4u32_t) { x[4 * h], x[4 * h + 1], x[4 * h + 2],
+			      x[4 * h + 3] };
+	      dec_expand_u32 (digits + (8 * b + 4 * h) * DEC_U32_DIGITS,
+			      DEC_U32_DIGITS, w);
+	    }
+	  for (i = 0; i < 8; i++)
+	    neg[8 * b + i] = m[i] != 0;
+	}
+      ndig = DEC_U32_DIGITS;
+      break;
+
+    case 4:
+      for (b = 0; 4 * b < nlanes; b++)
+	{
+	  v4u32_t x, m = { 0 };
+	  memcpy (&x, src + 16 * b, sizeof (x));
+	  if (is_signed)
+	    {
+	      m = (v4u32_t) ((v4s32_t) x < 0);
+	      x = (x ^ m) - m;
+	    }
+	  dec_expand_u32 (digits + 4 * b * DEC_U32_DIGITS, DEC_U32_DIGITS, x);
+	  for (i = 0; i < 4; i++)
+	    neg[4 * b + i] = m[i] != 0;
+	}
+      ndig = DEC_U32_DIGITS;
+      break;
+
+    default:
+      /* Cut both doublewords into a top group below 1845 and two groups
+	 of eight digits.  The four eight digit groups are one vector for
+	 the word kernel's divide, giving the remaining four digit groups
+	 in the order hi8 / 10000, hi8 % 10000, lo8 / 10000, lo8 % 10000
+	 per lane.  */
+      for (b = 0; 2 * b < lanes; b++)
+	{
+	  v2u64_t x;
+	  v4u32_t q, r, qh, ql, rh, rl;
+	  unsigned long long mag[2];
+	  char *ng = neg + 2 * b;
+	  memcpy (&x, src + 16 * b, sizeof (x));
+	  for (i = 0; i < 2; i++)
+	    {
+	      ng[i] = is_signed && (long long) x[i] < 0;
+	      mag[i] = ng[i] ? -x[i] : x[i];
+	    }
+	  q = (v4u32_t) { mag[0] / 100000000 % 100000000, mag[0] % 100000000,
+			  mag[1] / 100000000 % 100000000,
+			  mag[1] % 100000000 };
+	  q = div10000 (q, &r);
+	  qh = (q * 5243) >> 19;
+	  ql = q - qh * 100;
+	  rh = (r * 5243) >> 19;
+	  rl = r - rh * 100;
+	  for (i = 0; i < 2; i++)
+	    {
+	      char *d = digits + (2 * b + i) * DEC_U64_DIGITS;
+	      unsigned int top = mag[i] / 10000000000000000ULL;
+	      int g;
+	      memcpy (d, digit_pairs + 2 * (top / 100), 2);
+	      memcpy (d + 2, digit_pairs + 2 * (top % 100), 2);
+	      for (g = 0; g < 2; g++)
+		{
+		  memcpy (d + 4 + 8 * g, digit_pairs + 2 * qh[2 * i + g], 2);
+		  memcpy (d + 6 + 8 * g, digit_pairs + 2 * ql[2 * i + g], 2);
+		  memcpy (d + 8 + 8 * g, digit_pairs + 2 * rh[2 * i + g], 2);
+		  memcpy (d + 10 + 8 * g, digit_pairs + 2 * rl[2 * i + g], 2);
+		}
+	    }
+	}
+      ndig = DEC_U64_DIGITS;
+      break;
+    }
+
+  for (i = 0; i < lanes; i++)
+    {
+      /* A quadword is its two doublewords printed back to back, most
+	 significant first.  */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      int lane = quad ? i ^ 1 : i;
+#else
+      int lane = i;
+#endif
+      const char *dp = digits + lane * ndig;
+      int n = ndig;
+
+      while (n > 0 && *dp == '0')
+	dp++, n--;
+
+      if (i > 0 && (!quad || i % 2 == 0))
+	*p++ = ' ';
+      p += fmt_int_layout (p, dp, n, dec_sign (neg[lane], conv), conv);
+    }
+
+  return p - out;
+}
+
+/* Output length of the integer kernels.
+
+   The length of a field only depends on how many digits its magnitude
+   has, so the lanes are measured instead of rendered.  Lanes of up to 32
+   bits are widened to words and measured four at a time: a lane has as
+   many digits as there are powers of the base that it is at least, and
+   each power is one vector compare for all four lanes.  A lane of SIZE
+   bytes needs VECPF_INT_DIGITS (SIZE, SPEC) of them, the same count
+   vecpf.h bounds its output with.  Doublewords take their bit length
+   from count leading zeros instead, which gives the octal and hex digits
+   directly and the decimal ones to within one: bits * 1233 >> 12 is
+   bits * log10 (2) rounded down, and one compare against the table of
+   powers of ten settles the rest.  */
+
+static const unsigned int len_steps_dec[10] =
+{
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+  1000000000
+};
+
+static const unsigned int len_steps_hex[8] =
+{
+  0x1, 0x10, 0x100, 0x1000, 0x10000, 0x100000, 0x1000000, 0x10000000
+};
+
+static const unsigned int len_steps_oct[11] =
+{
+  01, 010, 0100, 01000, 010000, 0100000, 01000000, 010000000, 0100000000,
+  01000000000, 010000000000
+};
+
+static const unsigned long long len_pow10[20] =
+{
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/* Digits of four word magnitudes: how many of the first N of STEPS each
+   lane is at least.  0 for a zero lane.  */
+static inline v4u32_t
+len_digits_u32 (v4u32_t x, const unsigned int *steps, int n)
+{
+  v4u32_t d = { 0 };
+  int k;
+
+  for (k = 0; k < n; k++)
+    {
+      unsigned int s = steps[k];
+      d -= (v4u32_t) (x >= (v4u32_t) { s, s, s, s });
+    }
+  return d;
+}
+
+static inline int
+len_digits_u64 (unsigned long long x, int spec)
+{
+  int bits = x != 0 ? 64 - __builtin_clzll (x) : 0;
+  int t;
+
+  if (spec == 'x' || spec == 'X')
+    return (bits + 3) / 4;
+  if (spec == 'o')
+    return (bits + 2) / 3;
+  t = (bits * 1233) >> 12;
+  return x != 0 ? t + (x >= len_pow10[t]) : 0;
+}
+
+/* Length of the field fmt_int_layout makes of NDIGITS digits.  */
+static inline int
+len_field (int ndigits, int negative, const vecpf_conv_t *conv)
+{
+  int len = ndigits;
+
+  if (ndigits == 0 && conv->prec != 0)
+    len = 1;
+  if (conv->prec > len)
+    len = conv->prec;
+  else if (conv->alt && conv->spec == 'o'
+	   && (ndigits != 0 || conv->prec == 0))
+    len++;
+  if (conv->alt && (conv->spec == 'x' || conv->spec == 'X') && ndigits != 0)
+    len += 2;
+  if (dec_sign (negative, conv))
+    len++;
+  return len > conv->width ? len : conv->width;
+}
+
+int attribute_hidden
+__vecpf_length_int (const void *v, int element_size, int nlanes,
+		    const vecpf_conv_t *conv)
+{
+  int is_signed = (conv->spec == 'd' || conv->spec == 'i');
+  const unsigned char *src = v;
+  unsigned char digits[VEC_BYTES_MAX];
+  char neg[VEC_BYTES_MAX];
+  int len, b, i;
+
+  if (conv->spec == 'c')
+    return nlanes * (conv->width > 1 ? conv->width : 1);
+
+  if (element_size >= 8)
+    {
+      int lanes = element_size == 16 ? 2 * nlanes : nlanes;
+      unsigned long long x[VEC_BYTES_MAX / 8];
+      memcpy (x, v, lanes * sizeof (x[0]));
+      for (i = 0; i < lanes; i++)
+	{
+	  neg[i] = is_signed && (long long) x[i] < 0;
+	  digits[i] = len_digits_u64 (neg[i] ? -x[i] : x[i], conv->spec);
+	}
+      /* The two halves of a quadword are fields of their own, with no
+	 separator between them.  */
+      if (element_size == 16)
+	{
+	  len = nlanes - 1;
+	  for (i = 0; i < lanes; i++)
+	    len += len_field (digits[i], neg[i], conv);
+	  return len;
+	}
+    }
+  else
+    {
+      unsigned int mag[VEC_BYTES_MAX] __attribute__ ((aligned (16)));
+      int per_block = 16 / element_size;
+      const unsigned int *steps;
+      int nsteps;
+
+      for (b = 0; b * per_block < nlanes; b++)
+	{
+	  unsigned int *mg = mag + b * per_block;
+	  char *ng = neg + b * per_block;
+
+	  switch (element_size)
+	    {
+	    case 1:
+	      {
+		v16u8_t x, m = { 0 };
+		memcpy (&x, src + 16 * b, sizeof (x));
+		if (is_signed)
+		  {
+		    m = (v16u8_t) ((v16s8_t) x < 0);
+		    x = (x ^ m) - m;
+		  }
+		for (i = 0; i < 16; i++)
+		  mg[i] = x[i], ng[i] = m[i] != 0;
+		break;
+	      }
+	    case 2:
+	      {
+		v8u16_t x, m = { 0 };
+		memcpy (&x, src + 16 * b, sizeof (x));
+		if (is_signed)
+		  {
+		    m = (v8u16_t) ((v8s16_t) x < 0);
+		    x = (x ^ m) - m;
+		  }
+		for (i = 0; i < 8; i++)
+		  mg[i] = x[i], ng[i] = m[i] != 0;
+		break;
+	      }
+	    default:
+	      {
+		v4u32_t x, m = { 0 };
+		memcpy (&x, src + 16 * b, sizeof (x));
+		if (is_signed)
+		  {
+		    m = (v4u32_t) ((v4s32_t) x < 0);
+		    x = (x ^ m) - m;
+		  }
+		memcpy (mg, &x, sizeof (x));
+		for (i = 0; i < 4; i++)
+		  ng[i] = m[i] != 0;
+		break;
+	      }
+	    }
+	}
+
+      if (conv->spec == 'x' || conv->spec == 'X')
+	steps = len_steps_hex, nsteps = 2 * element_size;
+      else if (conv->spec == 'o')
+	steps = len_steps_oct, nsteps = (8 * element_size + 2) / 3;
+      else
+	steps = len_steps_dec, nsteps = element_size == 1 ? 3
+					: element_size == 2 ? 5 : 10;
+
+      for (i = 0; i < nlanes; i += 4)
+	{
+	  v4u32_t w, d;
+	  int k;
+	  memcpy (&w, mag + i, sizeof (w));
+	  d = len_digits_u32 (w, steps, nsteps);
+	  for (k = 0; k < 4; k++)
+	    digits[i + k] = d[k];
+	}
+    }
+
+  /* Every lane but the last is followed by a space.  */
+  len = nlanes - 1;
+  for (i = 0; i < nlanes; i++)
+    len += len_field (digits[i], neg[i], conv);
+  return len;
+}
@@ -0,0 +1,32 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+/* The lane kernels of vecpf_int.c built for POWER10.  The level is set with a
+   pragma rather than on the command line so that -mcpu in CFLAGS can't
+   override it.  */
+
+#include "config.h"
+
+#ifdef HAVE_ISA_POWER10
+# pragma GCC target ("cpu=power10")
+# define VECPF_ISA power10
+# include "vecpf_int.c"
+#endif
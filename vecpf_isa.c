@@ -0,0 +1,287 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+#include <stddef.h>
+
+#include "config.h"
+#include "vecpf.h"
+#include "vecpf_priv.h"
+
+/* Processor level dispatch for the integer lane kernels.
+
+   vecpf_int.c is built for the processor CFLAGS targets and again for
+   each newer level configure found the compiler can target.  Each
+   kernel's plain name is a GNU ifunc whose resolver runs when the
+   library is loaded and returns the build for the newest level the
+   processor has, so a call costs the same as it would without the
+   variants.
+
+   The environment variable VECPF_ISA names a level to use instead, for
+   testing one build on a processor that could run a newer one.  A level
+   the processor lacks, or that wasn't built, is ignored.  The resolvers
+   run before libc has set up environ, so they read the environment
+   themselves.  Nothing they call may be an ifunc either: in a static
+   program those are resolved in the same pass as ours.  They also run
+   before a sanitizer's runtime has mapped its shadow memory and, in a
+   static program, before the thread pointer the stack protector reads
+   its canary through is set, so none of them is instrumented.  */
+
+enum
+{
+  VEC_ISA_BASE,
+  VEC_ISA_POWER8,
+  VEC_ISA_POWER9,
+  VEC_ISA_POWER10,
+  VEC_ISA_X86_64_V3,
+  VEC_ISA_X86_64_V4,
+  VEC_ISA_LEVELS
+};
+
+#ifdef HAVE_ISA_VARIANTS
+
+# include <unistd.h>
+# if defined __powerpc__ || defined __powerpc64__
+#  include <sys/auxv.h>
+# endif
+
+static const char *const vec_isa_names[VEC_ISA_LEVELS] =
+{
+  "baseline", "power8", "power9", "power10", "x86-64-v3", "x86-64-v4"
+};
+
+/* Set by ld.so or, in a static program, libc's startup code to the stack
+   the kernel started the program with: argc, then argv and envp, each
+   ending in a null pointer.  */
+
+extern void *__libc_stack_end;
+
+/* Marks what runs in a resolver: left alone by AddressSanitizer, and by
+   the stack protector where a compiler can turn it off for a function.  */
+
+# ifdef __has_attribute
+#  if __has_attribute (__no_stack_protector__)
+#   define VEC_ISA_EARLY \
+  __attribute__ ((__no_sanitize_address__, __no_stack_protector__))
+#  endif
+# endif
+# ifndef VEC_ISA_EARLY
+#  define VEC_ISA_EARLY  __attribute__ ((__no_sanitize_address__))
+# endif
+
+/* The level every resolver returns, -1 until the first one has run.  */
+
+static int vec_isa = -1;
+
+/* Whether the processor runs code built for ISA.  */
+
+VEC_ISA_EARLY
+static int
+vec_isa_runs (int isa)
+{
+  switch (isa)
+    {
+# ifdef HAVE_ISA_POWER8
+    case VEC_ISA_POWER8:
+      return (getauxval (AT_HWCAP2) & PPC_FEATURE2_ARCH_2_07) != 0;
+# endif
+# ifdef HAVE_ISA_POWER9
+    case VEC_ISA_POWER9:
+      return (getauxval (AT_HWCAP2) & PPC_FEATURE2_ARCH_3_00) != 0;
+# endif
+# ifdef HAVE_ISA_POWER10
+    case VEC_ISA_POWER10:
+      return (getauxval (AT_HWCAP2) & PPC_FEATURE2_ARCH_3_1) != 0;
+# endif
+# ifdef HAVE_ISA_X86_64_V3
+    case VEC_ISA_X86_64_V3:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("x86-64-v3");
+# endif
+# ifdef HAVE_ISA_X86_64_V4
+    case VEC_ISA_X86_64_V4:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("x86-64-v4");
+# endif
+    case VEC_ISA_BASE:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+/* The value of VECPF_ISA, or NULL if it isn't set.  */
+
+VEC_ISA_EARLY
+static const char *
+vec_isa_env (void)
+{
+  static const char name[] = "VECPF_ISA=";
+  char **ep = environ;
+  size_t i;
+
+  if (ep == NULL)
+    {
+      long *sp = __libc_stack_end;
+
+      if (sp == NULL || sp[0] < 0)
+	return NULL;
+      ep = (char **) (sp + 1) + sp[0] + 1;
+    }
+  for (; *ep != NULL; ep++)
+    {
+      for (i = 0; name[i] != '\0' && (*ep)[i] == name[i]; i++)
+	;
+      if (name[i] == '\0')
+	return *ep + i;
+    }
+  return NULL;
+}
+
+VEC_ISA_EARLY
+static int
+vec_isa_streq (const char *a, const char *b)
+{
+  while (*a != '\0' && *a == *b)
+    a++, b++;
+  return *a == *b;
+}
+
+VEC_ISA_EARLY
+static int
+vec_isa_select (void)
+{
+  const char *want;
+  int isa;
+
+  if (vec_isa >= 0)
+    return vec_isa;
+
+  vec_isa = VEC_ISA_BASE;
+  for (isa = VEC_ISA_LEVELS - 1; isa > VEC_ISA_BASE; isa--)
+    if (vec_isa_runs (isa))
+      {
+	vec_isa = isa;
+	break;
+      }
+
+  want = vec_isa_env ();
+  if (want != NULL)
+    for (isa = VEC_ISA_BASE; isa < VEC_ISA_LEVELS; isa++)
+      if (vec_isa_streq (want, vec_isa_names[isa]) && vec_isa_runs (isa))
+	vec_isa = isa;
+
+  return vec_isa;
+}
+
+/* One resolver per kernel.  VEC_ISA_CASE_<level> (NAME) is a case of the
+   resolver's switch for each level that was built.  */
+
+# define VEC_ISA_DECLARE(isa)						\
+  extern __typeof (__vecpf_fmt_int) __vecpf_fmt_int_##isa		\
+    attribute_hidden;							\
+  extern __typeof (__vecpf_render_radix) __vecpf_render_radix_##isa	\
+    attribute_hidden;							\
+  extern __typeof (__vecpf_render_dec) __vecpf_render_dec_##isa		\
+    attribute_hidden;							\
+  extern __typeof (__vecpf_length_int) __vecpf_length_int_##isa		\
+    attribute_hidden
+
+VEC_ISA_DECLARE (base);
+
+# ifdef HAVE_ISA_POWER8
+VEC_ISA_DECLARE (power8);
+#  define VEC_ISA_CASE_POWER8(name) \
+  case VEC_ISA_POWER8: return name##_power8;
+# else
+#  define VEC_ISA_CASE_POWER8(name)
+# endif
+# ifdef HAVE_ISA_POWER9
+VEC_ISA_DECLARE (power9);
+#  define VEC_ISA_CASE_POWER9(name) \
+  case VEC_ISA_POWER9: return name##_power9;
+# else
+#  define VEC_ISA_CASE_POWER9(name)
+# endif
+# ifdef HAVE_ISA_POWER10
+VEC_ISA_DECLARE (power10);
+#  define VEC_ISA_CASE_POWER10(name) \
+  case VEC_ISA_POWER10: return name##_power10;
+# else
+#  define VEC_ISA_CASE_POWER10(name)
+# endif
+# ifdef HAVE_ISA_X86_64_V3
+VEC_ISA_DECLARE (x86_64_v3);
+#  define VEC_ISA_CASE_X86_64_V3(name) \
+  case VEC_ISA_X86_64_V3: return name##_x86_64_v3;
+# else
+#  define VEC_ISA_CASE_X86_64_V3(name)
+# endif
+# ifdef HAVE_ISA_X86_64_V4
+VEC_ISA_DECLARE (x86_64_v4);
+#  define VEC_ISA_CASE_X86_64_V4(name) \
+  case VEC_ISA_X86_64_V4: return name##_x86_64_v4;
+# else
+#  define VEC_ISA_CASE_X86_64_V4(name)
+# endif
+
+# define VEC_ISA_RESOLVE(name)						\
+  VEC_ISA_EARLY								\
+  static __typeof (name) *						\
+  name##_resolve (void)							\
+  {									\
+    switch (vec_isa_select ())						\
+      {									\
+      VEC_ISA_CASE_POWER8 (name)					\
+      VEC_ISA_CASE_POWER9 (name)					\
+      VEC_ISA_CASE_POWER10 (name)					\
+      VEC_ISA_CASE_X86_64_V3 (name)					\
+      VEC_ISA_CASE_X86_64_V4 (name)					\
+      default:								\
+	return name##_base;						\
+      }									\
+  }									\
+  __typeof (name) name __attribute__ ((ifunc (#name "_resolve")))
+
+VEC_ISA_RESOLVE (__vecpf_fmt_int);
+VEC_ISA_RESOLVE (__vecpf_render_radix);
+VEC_ISA_RESOLVE (__vecpf_render_dec);
+VEC_ISA_RESOLVE (__vecpf_length_int);
+
+const char *
+vecpf_isa (void)
+{
+  return vec_isa_names[vec_isa_select ()];
+}
+
+#else
+
+const char *
+vecpf_isa (void)
+{
+# ifdef VECPF_HWCAPS
+  /* A glibc-hwcaps build: all of it is built for the level.  */
+  return VECPF_HWCAPS;
+# else
+  return "baseline";
+# endif
+}
+
+#endif
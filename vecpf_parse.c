@@ -0,0 +1,595 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+#include <errno.h>
+#include <langinfo.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "vecpf.h"
+#include "vecpf_priv.h"
+
+/* Parsing.
+
+   The inverse of the printf hooks: text in the layout a vector conversion
+   prints is read back into vectors.  Integer lanes never go through
+   strtol.  The text is loaded sixteen bytes at a time and classified with
+   vector compares into one bit per byte for digits and one for
+   separators, so every lane lying wholly inside the sixteen bytes is
+   found with a count of trailing zeros or ones, without a byte loop.  Its
+   digits are then read as the last eight or sixteen bytes ending at the
+   lane, the bytes before the first digit cleared, and folded into their
+   value eight at a time in three multiplies per group of eight: pairs of
+   digits, pairs of pairs and pairs of those, all within a 64 bit word.
+
+   Decimal floating point lanes are read the same way into a mantissa and
+   a power of ten.  When both are small enough to be exact in the lane's
+   type, the value is a single multiply or divide and so correctly
+   rounded; anything else, and "inf", "nan" and the hex forms of 'a', is
+   left to strtod or strtof.
+
+   Nothing outside the string is read: the loads stop at its null byte,
+   and the bytes in front of a lane come from a copy behind zeros when
+   they would start before the string does.  */
+
+/* Decimal digits that always fit in a 64 bit mantissa.  */
+#define PARSE_FP_DIGITS  19
+
+static const unsigned long long parse_pow8[17] =
+{
+  1ULL << 0, 1ULL << 3, 1ULL << 6, 1ULL << 9, 1ULL << 12, 1ULL << 15,
+  1ULL << 18, 1ULL << 21, 1ULL << 24, 1ULL << 27, 1ULL << 30, 1ULL << 33,
+  1ULL << 36, 1ULL << 39, 1ULL << 42, 1ULL << 45, 1ULL << 48
+};
+
+static const unsigned long long parse_pow10[17] =
+{
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL
+};
+
+/* 16^16 doesn't fit; it is never needed, since a value already holding a
+   digit can take at most 15 more.  */
+static const unsigned long long parse_pow16[17] =
+{
+  1ULL << 0, 1ULL << 4, 1ULL << 8, 1ULL << 12, 1ULL << 16, 1ULL << 20,
+  1ULL << 24, 1ULL << 28, 1ULL << 32, 1ULL << 36, 1ULL << 40, 1ULL << 44,
+  1ULL << 48, 1ULL << 52, 1ULL << 56, 1ULL << 60, 0
+};
+
+static const double parse_exact_double[23] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+  1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const float parse_exact_float[11] =
+{
+  1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+/* The bytes of C that are digits in BASE.  */
+static inline unsigned int
+parse_digit_bits (v16u8_t c, unsigned char base)
+{
+  unsigned char ndec = base < 10 ? base : 10;
+  v16u8_t m = (v16u8_t) ((v16u8_t) (c - '0') < ndec);
+
+  if (base == 16)
+    m |= (v16u8_t) ((v16u8_t) ((c | 0x20) - 'a') < 6);
+  return vec_bits16 (m);
+}
+
+/* The bytes of C that separate lanes: white space, or one of the
+   separator characters of the AltiVec PIM.  */
+static inline unsigned int
+parse_sep_bits (v16u8_t c)
+{
+  v16u8_t m = (v16u8_t) (c == ' ') | (v16u8_t) ((v16u8_t) (c - '\t') < 5)
+	      | (v16u8_t) (c == ',') | (v16u8_t) (c == ';')
+	      | (v16u8_t) (c == ':') | (v16u8_t) (c == '_');
+  return vec_bits16 (m);
+}
+
+/* The length of the run of set bits in BITS from bit POS on.  */
+static inline int
+parse_run (unsigned int bits, int pos)
+{
+  return __builtin_ctz (~(bits >> pos));
+}
+
+/* The value in BASE of the eight digits in W, the first of them the most
+   significant and in the low byte.  Zero bytes count as zero digits.  */
+static inline unsigned long long
+parse_fold8 (unsigned long long w, unsigned int base)
+{
+  w = (w & 0x0f0f0f0f0f0f0f0fULL) + ((w >> 6) & 0x0101010101010101ULL) * 9;
+  w = (w * base + (w >> 8)) & 0x00ff00ff00ff00ffULL;
+  w = (w * (base * base) + (w >> 16)) & 0x0000ffff0000ffffULL;
+  return (w * (base * base * base * base) + (w >> 32)) & 0xffffffffULL;
+}
+
+/* Where the sixteen bytes C loaded from S can be read back from with up
+   to sixteen bytes in front of them: S itself, if those are all in the
+   string, which starts at START; otherwise BUF, with C copied in behind
+   sixteen zeros.  */
+static inline const char *
+parse_text (const char *s, const char *start, v16u8_t c, unsigned char *buf)
+{
+  if (s - start >= 16)
+    return s;
+  memset (buf, 0, 16);
+  memcpy (buf + 16, &c, sizeof (c));
+  return (const char *) buf + 16;
+}
+
+/* The value in BASE of the N digits, from 1 to 16, that end at END.  */
+static inline unsigned long long
+parse_fold (const char *end, int n, unsigned int base,
+	    const unsigned long long *pow)
+{
+  unsigned long long hi, lo;
+
+  /* Clear whatever comes before the digits.  */
+  memcpy (&lo, end - 8, sizeof (lo));
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  lo = __builtin_bswap64 (lo);
+#endif
+  if (n <= 8)
+    return parse_fold8 (n < 8 ? lo & (~0ULL << (8 * (8 - n))) : lo, base);
+
+  memcpy (&hi, end - 16, sizeof (hi));
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  hi = __builtin_bswap64 (hi);
+#endif
+  if (n < 16)
+    hi &= ~0ULL << (8 * (16 - n));
+  return parse_fold8 (hi, base) * pow[8] + parse_fold8 (lo, base);
+}
+
+/* Append the run of digits in BASE at *SP, in the string that starts at
+   START, to *VAL, which holds *NDIG digits so far, and advance *SP past
+   them.  Returns -1 if that would make more than MAXDIG digits or
+   overflow 64 bits.  */
+static int
+parse_digits (const char **sp, const char *start, unsigned int base,
+	      unsigned long long *val, int *ndig, int maxdig)
+{
+  const unsigned long long *pow = base == 10 ? parse_pow10
+				  : base == 16 ? parse_pow16 : parse_pow8;
+  const char *s = *sp;
+  unsigned long long v = *val;
+  int nd = *ndig;
+  int n;
+
+  do
+    {
+      v16u8_t c = vec_load16 (s);
+      unsigned char buf[32];
+      unsigned long long x;
+
+      n = parse_run (parse_digit_bits (c, base), 0);
+      if (n == 0)
+	break;
+      if (nd + n > maxdig)
+	return -1;
+      x = parse_fold (parse_text (s, start, c, buf) + n, n, base, pow);
+      if (v != 0)
+	{
+	  if (v > (~0ULL - x) / pow[n])
+	    return -1;
+	  x += v * pow[n];
+	}
+      v = x;
+      nd += n;
+      s += n;
+    }
+  while (n == 16);
+
+  *sp = s;
+  *val = v;
+  *ndig = nd;
+  return 0;
+}
+
+static inline int
+parse_is_digit (char c)
+{
+  return (unsigned char) (c - '0') < 10;
+}
+
+/* What separates lanes: white space, or one of the separator characters
+   of the AltiVec PIM.  */
+static inline const char *
+parse_skip (const char *p)
+{
+  while (*p == ' ' || (unsigned char) (*p - '\t') < 5
+	 || *p == ',' || *p == ';' || *p == ':' || *p == '_')
+    p++;
+  return p;
+}
+
+/* A conversion resolved for parsing, and the string it parses.  */
+typedef struct
+{
+  int conv;
+  int size;		/* Bytes in a lane.  */
+  int lanes;		/* Lanes in a vector.  */
+  int is_fp;
+  int is_signed;
+  int radix_dot;	/* The locale's radix is '.'.  */
+  unsigned int base;	/* Of an integer conversion.  */
+  const char *start;	/* The string, which nothing before is read.  */
+  unsigned long long max;	/* Largest positive lane.  */
+  const unsigned long long *pow;	/* Powers of BASE.  */
+} parse_spec_t;
+
+static int
+parse_setup (parse_spec_t *ps, int spec, const char *str)
+{
+  const char *radix = nl_langinfo (RADIXCHAR);
+  int type = __vecpf_spec_type (spec, &ps->size, &ps->lanes);
+
+  /* The two halves of a quadword are printed without a separator, so
+     they can't be told apart.  */
+  if (type < 0 || ps->size == 16)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  ps->conv = spec & 0xff;
+  ps->is_fp = (type == VDT_float || type == VDT_double);
+  ps->is_signed = (ps->conv == 'd' || ps->conv == 'i');
+  ps->radix_dot = (radix != NULL && radix[0] == '.' && radix[1] == '\0');
+  ps->base = ps->conv == 'o' ? 8
+	     : ps->conv == 'x' || ps->conv == 'X' ? 16 : 10;
+  ps->start = str;
+  ps->pow = ps->base == 10 ? parse_pow10
+	    : ps->base == 16 ? parse_pow16 : parse_pow8;
+  ps->max = ps->size == 8 ? ~0ULL : (1ULL << (8 * ps->size)) - 1;
+  if (ps->is_signed)
+    ps->max >>= 1;
+  return 0;
+}
+
+static void
+parse_store (void *dst, unsigned long long x, int size)
+{
+  switch (size)
+    {
+    case 1:
+      {
+	unsigned char t = x;
+	memcpy (dst, &t, sizeof (t));
+	break;
+      }
+    case 2:
+      {
+	unsigned short t = x;
+	memcpy (dst, &t, sizeof (t));
+	break;
+      }
+    case 4:
+      {
+	unsigned int t = x;
+	memcpy (dst, &t, sizeof (t));
+	break;
+      }
+    default:
+      memcpy (dst, &x, sizeof (x));
+      break;
+    }
+}
+
+static const char *
+parse_int_lane (const parse_spec_t *ps, const char *s, void *dst, int *err)
+{
+  unsigned int base = ps->base;
+  int maxdig = base == 8 ? 22 : base == 16 ? 16 : 20;
+  unsigned long long v = 0;
+  const char *p = s, *digits;
+  int neg = 0, nd = 0;
+
+  if (ps->is_signed && (*p == '-' || *p == '+'))
+    neg = (*p++ == '-');
+  /* The prefix '#' adds to nonzero hex values.  */
+  if (base == 16 && p[0] == '0' && (p[1] | 0x20) == 'x'
+      && (parse_digit_bits (vec_load16 (p + 2), 16) & 1))
+    p += 2;
+
+  digits = p;
+  while (*p == '0')
+    p++;
+  if (parse_digits (&p, ps->start, base, &v, &nd, maxdig) != 0)
+    {
+      *err = ERANGE;
+      return NULL;
+    }
+  if (p == digits)
+    {
+      *err = EINVAL;
+      return NULL;
+    }
+
+  if (v > ps->max + neg)
+    {
+      *err = ERANGE;
+      return NULL;
+    }
+
+  parse_store (dst, neg ? -v : v, ps->size);
+  return p;
+}
+
+/* Parse the integer lanes that lie wholly within the sixteen bytes at
+   *SP, up to NELEM of them, into DST, and advance *SP past the last one.
+   The bytes are classified once for all of them.  Returns the number of
+   lanes parsed, which is 0 if the next one is for parse_int_lane: it
+   runs past the sixteen bytes, starts with '+' or "0x", is out of range,
+   or isn't a lane at all.  */
+static size_t
+parse_int_chunk (const parse_spec_t *ps, const char **sp, unsigned char *dst,
+		 size_t nelem)
+{
+  v16u8_t c = vec_load16 (*sp);
+  unsigned char buf[32];
+  const char *text = parse_text (*sp, ps->start, c, buf);
+  unsigned int digits = parse_digit_bits (c, ps->base);
+  unsigned int seps = parse_sep_bits (c);
+  unsigned int minus = ps->is_signed ? vec_bits16 ((v16u8_t) (c == '-')) : 0;
+  int pos = 0, end = 0;
+  size_t i;
+
+  for (i = 0; i < nelem; i++)
+    {
+      unsigned long long v;
+      int neg, start, n;
+
+      pos += parse_run (seps, pos);
+      if (pos >= 16)
+	break;
+      neg = (minus >> pos) & 1;
+      start = pos + neg;
+      n = parse_run (digits, start);
+      if (n == 0 || start + n >= 16)
+	break;
+      if (ps->base == 16 && n == 1 && text[start] == '0'
+	  && (text[start + 1] | 0x20) == 'x')
+	break;
+      v = parse_fold (text + start + n, n, ps->base, ps->pow);
+      if (v > ps->max + neg)
+	break;
+      parse_store (dst + i * ps->size, neg ? -v : v, ps->size);
+      pos = end = start + n;
+    }
+
+  *sp += end;
+  return i;
+}
+
+static const char *
+parse_fp_lane (const parse_spec_t *ps, const char *s, void *dst, int *err)
+{
+  unsigned long long m = 0;
+  const char *p = s, *digits;
+  int neg = 0, nd = 0, e10 = 0;
+  int saved_errno;
+  char *end;
+
+  if (!ps->radix_dot)
+    goto slow;
+
+  if (*p == '-' || *p == '+')
+    neg = (*p++ == '-');
+  digits = p;
+  while (*p == '0')
+    p++;
+  if (parse_digits (&p, ps->start, 10, &m, &nd, PARSE_FP_DIGITS) != 0)
+    goto slow;
+  if (*p == '.')
+    {
+      const char *frac = ++p;
+      if (m == 0)
+	while (*p == '0')
+	  p++;
+      if (parse_digits (&p, ps->start, 10, &m, &nd, PARSE_FP_DIGITS) != 0)
+	goto slow;
+      e10 -= p - frac;
+    }
+  if (p == digits || (p == digits + 1 && *digits == '.'))
+    goto slow;
+
+  if ((*p | 0x20) == 'e')
+    {
+      const char *q = p + 1;
+      int eneg = 0, e = 0;
+      if (*q == '-' || *q == '+')
+	eneg = (*q++ == '-');
+      if (!parse_is_digit (*q))
+	goto slow;
+      while (parse_is_digit (*q) && e < 10000)
+	e = e * 10 + *q++ - '0';
+      if (parse_is_digit (*q))
+	goto slow;
+      e10 += eneg ? -e : e;
+      p = q;
+    }
+
+  /* Anything that could carry on the number is left to strtod.  */
+  if (*p == '.' || parse_is_digit (*p)
+      || (unsigned char) ((*p | 0x20) - 'a') < 26)
+    goto slow;
+
+  if (m > (ps->size == 4 ? 1ULL << 24 : 1ULL << 53))
+    while (m % 10 == 0)
+      m /= 10, e10++;
+
+  if (ps->size == 4)
+    {
+      if (m <= 1ULL << 24 && e10 >= -10 && e10 <= 10)
+	{
+	  float f = (float) m;
+	  f = e10 < 0 ? f / parse_exact_float[-e10]
+		      : f * parse_exact_float[e10];
+	  if (neg)
+	    f = -f;
+	  memcpy (dst, &f, sizeof (f));
+	  return p;
+	}
+    }
+  else if (m <= 1ULL << 53 && e10 >= -22 && e10 <= 22)
+    {
+      double d = (double) m;
+      d = e10 < 0 ? d / parse_exact_double[-e10]
+		  : d * parse_exact_double[e10];
+      if (neg)
+	d = -d;
+      memcpy (dst, &d, sizeof (d));
+      return p;
+    }
+
+ slow:
+  /* Values the library prints are always in range, so an ERANGE from
+     strtod for a subnormal one isn't an error here.  */
+  saved_errno = errno;
+  if (ps->size == 4)
+    {
+      float f = strtof (s, &end);
+      memcpy (dst, &f, sizeof (f));
+    }
+  else
+    {
+      double d = strtod (s, &end);
+      memcpy (dst, &d, sizeof (d));
+    }
+  errno = saved_errno;
+
+  if (end == s)
+    {
+      *err = EINVAL;
+      return NULL;
+    }
+  return end;
+}
+
+/* Parse up to NELEM lanes of PS at STR into BASE.  Stops at the first
+   thing that isn't a lane and returns the number of lanes stored, with
+   *ENDP set past the last of them.  Returns -1 with errno set to ERANGE
+   if a lane doesn't fit in its type.  */
+static ssize_t
+parse_lanes (const parse_spec_t *ps, const char *str, unsigned char *base,
+	     size_t nelem, const char **endp)
+{
+  const char *p = str;
+  size_t i;
+
+  for (i = 0; i < nelem; i++)
+    {
+      const char *q = p;
+      int err = 0;
+
+      if (!ps->is_fp && ps->conv != 'c')
+	{
+	  size_t n = parse_int_chunk (ps, &p, base + i * ps->size, nelem - i);
+	  if (n > 0)
+	    {
+	      i += n - 1;
+	      continue;
+	    }
+	}
+
+      /* Characters have no separator within a vector, and may be spaces
+	 themselves.  */
+      if (ps->conv != 'c')
+	q = parse_skip (q);
+      else if (i > 0 && i % ps->lanes == 0)
+	q = parse_skip (q);
+
+      if (ps->conv == 'c')
+	{
+	  if (*q == '\0')
+	    break;
+	  base[i] = *q++;
+	}
+      else
+	{
+	  q = ps->is_fp ? parse_fp_lane (ps, q, base + i * ps->size, &err)
+			: parse_int_lane (ps, q, base + i * ps->size, &err);
+	  if (q == NULL)
+	    {
+	      *endp = p;
+	      if (err != ERANGE)
+		break;
+	      errno = ERANGE;
+	      return -1;
+	    }
+	}
+      p = q;
+    }
+
+  *endp = p;
+  return i;
+}
+
+int
+vecpf_parse (const char *str, int spec, void *vec)
+{
+  parse_spec_t ps;
+  vec_wide_t vp_u;
+  const char *end;
+  ssize_t n;
+
+  if (parse_setup (&ps, spec, str) != 0)
+    return -1;
+
+  n = parse_lanes (&ps, str, vp_u.uc, ps.lanes, &end);
+  if (n < 0)
+    return -1;
+  if (n < ps.lanes)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  memcpy (vec, &vp_u, (size_t) ps.lanes * ps.size);
+  return end - str;
+}
+
+ssize_t
+vecpf_parse_array (const char *str, int spec, void *base, size_t nelem,
+		   const char **endp)
+{
+  parse_spec_t ps;
+  const char *end;
+  ssize_t n;
+
+  if (parse_setup (&ps, spec, str) != 0)
+    return -1;
+
+  n = parse_lanes (&ps, str, base, nelem, &end);
+  if (endp != NULL)
+    *endp = end;
+  return n;
+}
@@ -0,0 +1,199 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "vecpf_priv.h"
+
+/* Worker pool for the parallel array formatters.
+
+   The workers are started the first time a job asks for them and then
+   sleep on a condition variable between jobs.  A job is a number of
+   independent tasks; the caller and the workers taking part claim them
+   one at a time from a shared counter, so a worker that finishes its task
+   early just takes the next one and a slow task never holds up the rest.
+   Only one job runs at a time; a second caller waits for the pool.  */
+
+#define VEC_POOL_MAX  256
+
+static struct
+{
+  pthread_mutex_t run_lock;	/* Held by the caller for a whole job.  */
+  pthread_mutex_t lock;		/* Protects everything below.  */
+  pthread_cond_t work;
+  pthread_cond_t done;
+  int nworkers;			/* Workers started.  */
+  int nwanted;			/* Workers taking part in the job.  */
+  int active;			/* Of those, how many are still in it.  */
+  unsigned long gen;		/* Bumped for every job.  */
+  void (*fn) (void *arg, size_t task);
+  void *arg;
+  size_t ntasks;
+  size_t next;			/* Next task to claim.  */
+} vec_pool =
+{
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+  0, 0, 0, 0, NULL, NULL, 0, 0
+};
+
+static pthread_once_t vec_pool_once = PTHREAD_ONCE_INIT;
+
+/* Claim and run tasks until there are none left.  */
+static void
+vec_pool_drain (void (*fn) (void *, size_t), void *arg, size_t ntasks)
+{
+  size_t task;
+
+  while ((task = __atomic_fetch_add (&vec_pool.next, 1, __ATOMIC_RELAXED))
+	 < ntasks)
+    fn (arg, task);
+}
+
+static void *
+vec_pool_worker (void *p)
+{
+  int id = (int) (size_t) p;
+  /* Workers are only started by a caller setting up a job, with the lock
+     held and before it bumps GEN, so the first GEN a worker sees is that
+     job's, and never 0.  */
+  unsigned long seen = 0;
+
+  pthread_mutex_lock (&vec_pool.lock);
+  for (;;)
+    {
+      void (*fn) (void *, size_t);
+      void *arg;
+      size_t ntasks;
+
+      while (vec_pool.gen == seen)
+	pthread_cond_wait (&vec_pool.work, &vec_pool.lock);
+      seen = vec_pool.gen;
+      if (id >= vec_pool.nwanted)
+	continue;
+      fn = vec_pool.fn;
+      arg = vec_pool.arg;
+      ntasks = vec_pool.ntasks;
+      pthread_mutex_unlock (&vec_pool.lock);
+
+      vec_pool_drain (fn, arg, ntasks);
+
+      pthread_mutex_lock (&vec_pool.lock);
+      if (--vec_pool.active == 0)
+	pthread_cond_signal (&vec_pool.done);
+    }
+
+  return NULL;
+}
+
+/* The workers don't survive a fork; let the child start its own.  */
+static void
+vec_pool_atfork_child (void)
+{
+  pthread_mutex_init (&vec_pool.run_lock, NULL);
+  pthread_mutex_init (&vec_pool.lock, NULL);
+  pthread_cond_init (&vec_pool.work, NULL);
+  pthread_cond_init (&vec_pool.done, NULL);
+  vec_pool.nworkers = 0;
+  vec_pool.active = 0;
+}
+
+static void
+vec_pool_init (void)
+{
+  pthread_atfork (NULL, NULL, vec_pool_atfork_child);
+}
+
+int attribute_hidden
+__vecpf_pool_threads (int nthreads)
+{
+  if (nthreads <= 0)
+    {
+      long n = sysconf (_SC_NPROCESSORS_ONLN);
+      nthreads = n > 0 ? (int) n : 1;
+    }
+  return nthreads < VEC_POOL_MAX ? nthreads : VEC_POOL_MAX;
+}
+
+void attribute_hidden
+__vecpf_pool_run (int nthreads, void (*fn) (void *arg, size_t task),
+		  void *arg, size_t ntasks)
+{
+  int nhelpers;
+
+  nthreads = __vecpf_pool_threads (nthreads);
+  if ((size_t) nthreads > ntasks)
+    nthreads = ntasks;
+  nhelpers = nthreads - 1;
+
+  if (nhelpers <= 0)
+    {
+      size_t task;
+      for (task = 0; task < ntasks; task++)
+	fn (arg, task);
+      return;
+    }
+
+  pthread_once (&vec_pool_once, vec_pool_init);
+  pthread_mutex_lock (&vec_pool.run_lock);
+  pthread_mutex_lock (&vec_pool.lock);
+
+  /* Start whatever workers this job needs that aren't running yet.  If
+     that fails, make do with the ones there are.  */
+  while (vec_pool.nworkers < nhelpers)
+    {
+      pthread_attr_t attr;
+      pthread_t tid;
+      int err;
+
+      pthread_attr_init (&attr);
+      pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+      err = pthread_create (&tid, &attr, vec_pool_worker,
+			    (void *) (size_t) vec_pool.nworkers);
+      pthread_attr_destroy (&attr);
+      if (err != 0)
+	break;
+      vec_pool.nworkers++;
+    }
+  if (nhelpers > vec_pool.nworkers)
+    nhelpers = vec_pool.nworkers;
+
+  vec_pool.fn = fn;
+  vec_pool.arg = arg;
+  vec_pool.ntasks = ntasks;
+  vec_pool.next = 0;
+  vec_pool.nwanted = nhelpers;
+  vec_pool.active = nhelpers;
+  vec_pool.gen++;
+  pthread_cond_broadcast (&vec_pool.work);
+  pthread_mutex_unlock (&vec_pool.lock);
+
+  vec_pool_drain (fn, arg, ntasks);
+
+  pthread_mutex_lock (&vec_pool.lock);
+  while (vec_pool.active > 0)
+    pthread_cond_wait (&vec_pool.done, &vec_pool.lock);
+  pthread_mutex_unlock (&vec_pool.lock);
+  pthread_mutex_unlock (&vec_pool.run_lock);
+}
@@ -0,0 +1,269 @@
+/* This is part of libvecpf, the Vector Printf Library.
+
+   Copyright (c) 2010-2014 IBM Corporation
+   All rights reserved.
+
+   The Vector Printf Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License version
+   2.1.
+
+   The Vector Printf Library is distributed in the hope that it will be
+   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+   General Public License version 2.1 for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   version 2.1 along with the Vector Printf Library; if not, write to the
+   Free Software Foundation, Inc.,59 Temple Place, Suite 330, Boston,
+   MA 02111-1307 USA.
+
+   Please see libvecpf/LICENSE for more information.  */
+
+/* Internal interfaces shared between the libvecpf translation units.  Nothing
+   in here is part of the installed API.  */
+
+#ifndef _VECPF_PRIV_H
+#define _VECPF_PRIV_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define attribute_hidden __attribute__ ((visibility ("hidden")))
+
+typedef unsigned char v16u8_t __attribute__ ((vector_size (16)));
+
+/* Sixteen bytes read in place, whatever their declared type.  */
+
+typedef unsigned char v16u8_alias_t
+  __attribute__ ((vector_size (16), __may_alias__));
+
+/* One bit per byte of the compare result M, byte I in bit I.  The
+   multiply gathers the top bit of each byte of a word into its top byte,
+   as a single vbpermq or pmovmskb would.  */
+
+static inline unsigned int
+vec_bits16 (v16u8_t m)
+{
+  unsigned long long w[2];
+
+  memcpy (w, &m, sizeof (w));
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  w[0] = __builtin_bswap64 (w[0]);
+  w[1] = __builtin_bswap64 (w[1]);
+#endif
+  return ((((w[0] & 0x8080808080808080ULL) * 0x0002040810204081ULL) >> 56)
+	  | ((((w[1] & 0x8080808080808080ULL) * 0x0002040810204081ULL)
+	      >> 56) << 8));
+}
+
+/* The sixteen bytes at P, or as many of them as come before the string's
+   null byte and zeros after that.  They are read as the aligned sixteen
+   bytes that hold P and, only if those have no null byte from P on, the
+   aligned sixteen after them.  An aligned block that holds a byte of the
+   string lies in the string's page and memory tagging granule, so the
+   loads can't fault, but they do see bytes outside the string, which are
+   then dropped; AddressSanitizer would report those, so it is kept out
+   of here.  */
+
+__attribute__ ((__no_sanitize_address__))
+static inline v16u8_t
+vec_load16 (const char *p)
+{
+  static const unsigned char keep[32] =
+  {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+  };
+  unsigned int off = (uintptr_t) p & 15;
+  const v16u8_alias_t *a = (const v16u8_alias_t *) (p - off);
+  v16u8_t w[2], c, m;
+  unsigned int nul;
+
+  w[0] = a[0];
+  nul = vec_bits16 ((v16u8_t) (w[0] == 0)) >> off;
+  if (off == 0)
+    c = w[0];
+  else
+    {
+      if (nul == 0)
+	{
+	  w[1] = a[1];
+	  nul = (vec_bits16 ((v16u8_t) (w[1] == 0)) << (16 - off)) & 0xffff;
+	}
+      else
+	w[1] = (v16u8_t) { 0 };
+      memcpy (&c, (const unsigned char *) w + off, sizeof (c));
+    }
+
+  if (nul != 0)
+    {
+      memcpy (&m, keep + 16 - __builtin_ctz (nul), sizeof (m));
+      c &= m;
+    }
+  return c;
+}
+
+/* Widths and precisions above this are handed back to libc; everything at
+   or below it is rendered by the in-library lane kernels.  */
+
+#define VEC_LANE_WIDTH_MAX  256
+
+/* Worst case for one integer lane: the field width, or the precision plus
+   a sign and a "0x" prefix.  The int128 conversion emits two such fields.  */
+
+#define VEC_INT_LANE_MAXLEN  (2 * (VEC_LANE_WIDTH_MAX + 4))
+
+/* Worst case for one floating point lane: "%f" of DBL_MAX is 309 integer
+   digits, plus a sign, the radix and the precision.  */
+
+#define VEC_FP_LANE_MAXLEN  (1 + 309 + 1 + VEC_LANE_WIDTH_MAX)
+
+/* The widest vector the library prints, in bytes: a 512 bit AVX-512
+   register.  The direct interfaces and the library's own printf family
+   take vectors of 16, 32 and 64 bytes; the printf hooks only the first.  */
+
+#define VEC_BYTES_MAX  64
+
+/* A vector of any of those widths, lanes from the start.  Only as many
+   bytes as the vector has are meaningful.  */
+
+typedef union
+{
+  unsigned long long ull[VEC_BYTES_MAX / 8];
+  signed long long sll[VEC_BYTES_MAX / 8];
+  unsigned int ui[VEC_BYTES_MAX / 4];
+  signed int si[VEC_BYTES_MAX / 4];
+  unsigned short uh[VEC_BYTES_MAX / 2];
+  signed short sh[VEC_BYTES_MAX / 2];
+  unsigned char uc[VEC_BYTES_MAX];
+  signed char sc[VEC_BYTES_MAX];
+  float f[VEC_BYTES_MAX / 4];
+  double d[VEC_BYTES_MAX / 8];
+} vec_wide_t;
+
+/* The wider vectors as va_arg fetches them.  */
+
+typedef unsigned int v8u32_t __attribute__ ((vector_size (32)));
+typedef unsigned int v16u32_t __attribute__ ((vector_size (64)));
+
+/* Size of the buffer a whole vector of BYTES is rendered into before it
+   is written out: a byte lane per byte plus their separators is the worst
+   case for the integer conversions, and a quarter as many
+   VEC_FP_LANE_MAXLEN float lanes fit well within it.  */
+
+#define VEC_OUT_LEN(bytes)  ((bytes) * (VEC_LANE_WIDTH_MAX + 8))
+#define VEC_OUT_MAXLEN  VEC_OUT_LEN (VEC_BYTES_MAX)
+
+/* Everything the lane kernels need to know about one conversion.  This is
+   filled in from the printf_info handed to the printf hooks, but is kept
+   separate from it so the kernels do not depend on printf.h.  */
+
+typedef struct
+{
+  unsigned int alt:1;		/* '#' */
+  unsigned int space:1;		/* ' ' */
+  unsigned int left:1;		/* '-' */
+  unsigned int showsign:1;	/* '+' */
+  unsigned int group:1;		/* '\'' */
+  unsigned int zero:1;		/* '0' */
+  int width;			/* Minimum field width, 0 if not given.  */
+  int prec;			/* Precision, -1 if not given.  */
+  int spec;			/* Conversion character.  */
+} vecpf_conv_t;
+
+/* The integer kernels below are built for more than one processor level
+   when HAVE_ISA_VARIANTS is defined.  vecpf_int.c then defines VECPF_ISA
+   to the level it is being built for, which suffixes the name of every
+   kernel it defines, and vecpf_isa.c defines the plain names as ifuncs
+   that pick one of the builds when the library is loaded.  */
+
+#ifdef VECPF_ISA
+# define VEC_ISA_NAME_1(name, isa)  name##_##isa
+# define VEC_ISA_NAME(name, isa)    VEC_ISA_NAME_1 (name, isa)
+# define __vecpf_fmt_int	VEC_ISA_NAME (__vecpf_fmt_int, VECPF_ISA)
+# define __vecpf_render_radix	VEC_ISA_NAME (__vecpf_render_radix, VECPF_ISA)
+# define __vecpf_render_dec	VEC_ISA_NAME (__vecpf_render_dec, VECPF_ISA)
+# define __vecpf_length_int	VEC_ISA_NAME (__vecpf_length_int, VECPF_ISA)
+#endif
+
+/* Render one integer lane into OUT according to CONV.  MAG is the absolute
+   value of the lane and NEGATIVE is nonzero for a negative signed lane.
+   Returns the number of bytes written; at most VEC_INT_LANE_MAXLEN / 2.  */
+
+extern int __vecpf_fmt_int (char *out, unsigned long long mag, int negative,
+			    const vecpf_conv_t *conv) attribute_hidden;
+
+/* Render the first NLANES lanes of the vector at V for an o, x or X
+   conversion, separated by spaces.  ELEMENT_SIZE is the lane size in
+   bytes; 16 prints the two doublewords of each quadword back to back,
+   most significant first, as the 'vz' modifier does.  NLANES may be up to
+   VEC_BYTES_MAX / ELEMENT_SIZE, and V must hold them rounded up to a
+   multiple of 16 bytes.  Returns the number of bytes written.  */
+
+extern int __vecpf_render_radix (char *out, const void *v, int element_size,
+				 int nlanes,
+				 const vecpf_conv_t *conv) attribute_hidden;
+
+/* Same as __vecpf_render_radix, for a d, i or u conversion.  d and i treat
+   the lanes as signed.  */
+
+extern int __vecpf_render_dec (char *out, const void *v, int element_size,
+			       int nlanes,
+			       const vecpf_conv_t *conv) attribute_hidden;
+
+/* The number of bytes __vecpf_render_radix or __vecpf_render_dec would
+   write for the same arguments, or the 'c' conversion for byte lanes,
+   without rendering anything.  */
+
+extern int __vecpf_length_int (const void *v, int element_size, int nlanes,
+			       const vecpf_conv_t *conv) attribute_hidden;
+
+/* Render one floating point lane into OUT for an f, F, e, E, g or G
+   conversion.  The output is correctly rounded, to nearest with ties to
+   even, and uses '.' as the radix character.  Returns the number of bytes
+   written; at most VEC_FP_LANE_MAXLEN.  */
+
+extern int __vecpf_fmt_fp (char *out, double val,
+			   const vecpf_conv_t *conv) attribute_hidden;
+
+/* Whether __vecpf_fmt_fp prints what libc would right now: it always
+   rounds to nearest and uses '.' for the radix.  */
+
+extern int __vecpf_fp_env_is_c (void) attribute_hidden;
+
+/* Render one floating point lane into OUT for the 'r' conversion: the
+   shortest decimal that reads back as the same value, in the layout of
+   %g.  IS_FLOAT selects single precision, in which case VAL must hold a
+   float.  The width and flags of CONV are honoured and the precision is
+   ignored.  Returns the number of bytes written: the field width, or at
+   most VEC_SHORTEST_LANE_MAXLEN if that is larger.  */
+
+#define VEC_SHORTEST_LANE_MAXLEN  24
+
+extern int __vecpf_fmt_shortest (char *out, double val, int is_float,
+				 const vecpf_conv_t *conv) attribute_hidden;
+
+/* The VDT_ data type of the lanes of the direct formatting conversion
+   SPEC, with their size in bytes in *ELEMENT_SIZE and the number in a
+   vector in *LANES, or -1 if SPEC is not a combination the direct
+   interfaces accept.  */
+
+extern int __vecpf_spec_type (int spec, int *element_size,
+			      int *lanes) attribute_hidden;
+
+/* The number of threads a parallel formatter asked for NTHREADS uses:
+   NTHREADS itself, or the number of online processors if it is 0 or
+   less, capped at the size of the worker pool.  */
+
+extern int __vecpf_pool_threads (int nthreads) attribute_hidden;
+
+/* Run FN (ARG, TASK) for every TASK below NTASKS, spread over the calling
+   thread and up to __vecpf_pool_threads (NTHREADS) - 1 pool workers, and
+   return once all of them are done.  Tasks are handed out in increasing
+   order but may finish in any order.  */
+
+extern void __vecpf_pool_run (int nthreads,
+			      void (*fn) (void *arg, size_t task),
+			      void *arg, size_t ntasks) attribute_hidden;
+
+#endif /* _VECPF_PRIV_H  */